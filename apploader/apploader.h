@@ -1,6 +1,10 @@
 #pragma once
 
 #include "../loader/idaloader.h"
+#include "../loader/be_view.h"
+
+// The apploader is loaded and run at this address
+#define APPLOADER_BASE 0x81200000
 
 typedef struct {
     uint8_t revision[16];
@@ -8,4 +12,18 @@ typedef struct {
     int32_t size;
     int32_t trailerSize;
     int8_t padding[4];
-} apploader_header;
\ No newline at end of file
+} apploader_header;
+
+static_assert(sizeof(apploader_header) == 0x20, "apploader_header layout");
+
+// Big endian view of an apploader_header inside the file
+class apploader_header_view : public be_view
+{
+public:
+    explicit apploader_header_view(const uint8_t *base) : be_view(base) { }
+
+    const uint8_t *revision() const { return data(); }
+    uint32_t entryPoint() const { return field<uint32_t, 0x10>(); }
+    int32_t size() const { return field<int32_t, 0x14>(); }
+    int32_t trailerSize() const { return field<int32_t, 0x18>(); }
+};
\ No newline at end of file
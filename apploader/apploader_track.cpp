@@ -24,19 +24,19 @@ bool apploader_track::read_header()
         return err_msg("Apploader: file is too short to be valid");
 
     // Read the Apploader header
-    apploader_header t_header;
+    uint8_t block[sizeof(apploader_header)];
     qlseek(m_input_file, 0, SEEK_SET);
 
-    if (qlread(m_input_file, &t_header, sizeof(apploader_header)) != sizeof(apploader_header))
+    if (qlread(m_input_file, block, sizeof(block)) != sizeof(block))
         return err_msg("Apploader: file is inaccessible");
 
     // Set header
-    header = t_header;
-
-    // Swap the endianness of entries
-    header.entryPoint = swap32(header.entryPoint);
-    header.size = swap32(header.size);
-    header.trailerSize = swap32(header.trailerSize);
+    apploader_header_view view(block);
+    memcpy(header.revision, view.revision(), sizeof(header.revision));
+    memset(header.padding, 0, sizeof(header.padding));
+    header.entryPoint = view.entryPoint();
+    header.size = view.size();
+    header.trailerSize = view.trailerSize();
     msg("Revision date: %s\n", header.revision);
     msg("Entry Point: %08X\n", header.entryPoint);
 
@@ -46,7 +46,7 @@ bool apploader_track::read_header()
             "header.size = %08X header.trailerSize = %08X", m_file_size, totalSize, header.size, header.trailerSize);
     }
 
-    if (header.entryPoint < 0x81200000 || header.entryPoint >= 0x81800000)
+    if (header.entryPoint < APPLOADER_BASE || header.entryPoint >= 0x81800000)
         return err_msg("Apploader: entry point isn't valid! Entry Point: %08X", header.entryPoint);
 
     m_valid = true;
@@ -65,4 +65,28 @@ bool apploader_track::validate_header()
 bool apploader_track::is_good() const
 {
     return m_valid;
-}
\ No newline at end of file
+}
+
+bool apploader_track::create_segments(ea_t base)
+{
+    // Create the sections
+    auto name = std::string(NAME_CODE) + std::string("_boot");
+    if (!add_segm(1, base, base + header.size, name.c_str(), CLASS_CODE))
+        return err_msg("Failed to create entry segment!");
+
+    if (!file2base(m_input_file, sizeof(apploader_header), base, base + header.size, FILEREG_PATCHABLE))
+        return err_msg("Failed to load entry segment!");
+
+    name = std::string(NAME_CODE) + std::string("_trailer");
+    if (!add_segm(1, base + header.size, base + header.size + header.trailerSize, name.c_str(), CLASS_CODE))
+        return err_msg("Failed to create data segment!");
+
+    if (!file2base(m_input_file, sizeof(apploader_header) + header.size, base + header.size,
+        base + header.size + header.trailerSize, FILEREG_PATCHABLE))
+        return err_msg("Failed to load data segment!");
+
+    // Set entrypoint function name
+    set_name(header.entryPoint, "entrypoint");
+    add_func(header.entryPoint);
+    return true;
+}
@@ -9,6 +9,9 @@ public:
 
     bool is_good() const;
 
+    // Create the boot and trailer segments at base and name the entrypoint
+    bool create_segments(ea_t base);
+
     apploader_header header;
 
 private:
@@ -7,6 +7,10 @@
 #include "../loader/idaloader.h"
 #include "dol.h"
 #include "dol_track.h"
+#include "../loader/probe.h"
+#include "../loader/compression.h"
+#include "../loader/disc_image.h"
+#include <memory>
 
 /*--------------------------------------------------------------------------
  *
@@ -18,16 +22,35 @@
 
 int idaapi accept_file(qstring *fileFormatName, qstring *processor, linput_t *li, const char *fileName)
 {
-    dol_track track(li);
+    // Check the header without fully parsing it
+    uint8_t block[PROBE_BLOCK_SIZE];
+    size_t size = probe_read(li, block);
 
-    if (!track.is_good())
+    // The boot DOL of a disc image is loaded from its place in the image
+    if (probe_disc(block, size, qlsize(li)))
     {
-        msg("File is not a Nintendo GameCube DOL!");
-        return 0;
+        fileFormatName->sprnt("Nintendo GameCube DOL (disc image)");
+        processor->sprnt("PPC");
+        return(ACCEPT_FIRST | 0xD07);
+    }
+
+    // Compressed executables are checked on their decompressed header
+    uint8_t unpacked[PROBE_UNPACK_SIZE];
+    uint64_t unpacked_size;
+    size_t unpacked_count = probe_unpack(li, block, size, unpacked, &unpacked_size);
+    if (unpacked_count != 0)
+    {
+        if (!probe_dol(unpacked, unpacked_count, unpacked_size))
+            return 0;
     }
+    else if (!probe_dol(block, size, qlsize(li)))
+        return 0;
 
     // file has passed all sanity checks and might be a DOL
-    fileFormatName->sprnt("Nintendo GameCube DOL");
+    if (unpacked_count != 0)
+        fileFormatName->sprnt("Nintendo GameCube DOL (%s)", compression_name(compression_detect(block, size)));
+    else
+        fileFormatName->sprnt("Nintendo GameCube DOL");
     processor->sprnt("PPC");
 
     return(ACCEPT_FIRST | 0xD07);
@@ -57,71 +80,29 @@ void idaapi load_file(linput_t *fp, ushort /*neflag*/, const char * /*fileformat
 
     set_compiler_id(COMP_GNU);
 
-    dol_track track(fp);
+    // A disc image's boot DOL is read in place, nothing is extracted
+    uint8_t block[PROBE_BLOCK_SIZE];
+    size_t size = probe_read(fp, block);
+    disc_image disc;
+    bool from_disc = probe_disc(block, size, qlsize(fp));
+    if (from_disc && !disc.open(fp))
+        qexit(1);
+
+    std::unique_ptr<dol_track> track(from_disc ? new dol_track(disc.input(), disc.dol().m_offset, disc.dol().m_size, !disc.encrypted()) : new dol_track(fp));
 
     // read DOL header into memory
-    if (!track.is_good())
+    if (!track->is_good())
         qexit(1);
   
     // every journey has a beginning
-    inf.start_ea = inf.start_ip = track.header.entrypoint;
+    inf.start_ea = inf.start_ip = track->header.entrypoint;
 
     // map selector 1 to 0
     set_selector(1, 0);
 
-    // create all code segments
-    for (uint i=0, snum=1; i < 7; i++, snum++) {
-    qstring buf;
-    
-    // 0 == no segment
-    if (track.header.addressText[i] == 0)
-        continue;
-    
-    // create a name according to segmenttype and number
-    buf.sprnt(NAME_CODE "%u", snum);
-    
-    // add the code segment
-    if (!add_segm(1, track.header.addressText[i], track.header.addressText[i] + track.header.sizeText[i], buf.c_str(), CLASS_CODE))
+    // create the code, data and BSS segments
+    if (!track->create_segments())
         qexit(1);
-    
-    // set addressing to 32 bit
-    set_segm_addressing(getseg(track.header.addressText[i]), 1);
-
-    // and get the content from the file
-    file2base(fp, track.header.offsetText[i], track.header.addressText[i], track.header.addressText[i ]+ track.header.sizeText[i], FILEREG_PATCHABLE);
-  }
-
-  // create all data segments
-  for (uint i = 0, snum = 1; i < 11; i++, snum++) {
-    qstring buf;
-
-    // 0 == no segment
-    if (track.header.addressData[i] == 0)
-        continue;
-
-    // create a name according to segmenttype and number
-    buf.sprnt(NAME_DATA "%u", snum);
-
-    // add the data segment
-    if (!add_segm(1, track.header.addressData[i], track.header.addressData[i] + track.header.sizeData[i], buf.c_str(), CLASS_DATA))
-        qexit(1);
-    
-    // set addressing to 32 bit
-    set_segm_addressing(getseg(track.header.addressData[i]), 1);
-
-    // and get the content from the file
-    file2base(fp, track.header.offsetData[i], track.header.addressData[i], track.header.addressData[i] + track.header.sizeData[i], FILEREG_PATCHABLE);
-  }
-
-  // is there a BSS defined?
-  if (track.header.addressBSS != NULL) {
-    // then add it
-    if(!add_segm(1, track.header.addressBSS, track.header.addressBSS + track.header.sizeBSS, NAME_BSS, CLASS_BSS))
-        qexit(1);
-
-    // and set addressing mode to 32 bit
-    set_segm_addressing(getseg(track.header.addressBSS), 1);
-  }
 }
 
 /*--------------------------------------------------------------------------
@@ -8,6 +8,7 @@
 #define __DOL_H__
 
 #include "../loader/idaloader.h"
+#include "../loader/be_view.h"
 
 /* Header Size = 100h bytes 
 
@@ -36,4 +37,29 @@ typedef struct {
   unsigned int entrypoint;
 } dolhdr;
 
+static_assert(sizeof(dolhdr) == 0xE4, "dolhdr layout");
+
+// Big endian view of a dolhdr inside the file
+class dolhdr_view : public be_view
+{
+public:
+  explicit dolhdr_view(const uint8_t *base) : be_view(base) {}
+
+  uint32_t offsetText(size_t i) const  { return element<uint32_t, 0x00>(i); }
+  uint32_t offsetData(size_t i) const  { return element<uint32_t, 0x1C>(i); }
+  uint32_t addressText(size_t i) const { return element<uint32_t, 0x48>(i); }
+  uint32_t addressData(size_t i) const { return element<uint32_t, 0x64>(i); }
+  uint32_t sizeText(size_t i) const    { return element<uint32_t, 0x90>(i); }
+  uint32_t sizeData(size_t i) const    { return element<uint32_t, 0xAC>(i); }
+  uint32_t addressBSS() const          { return field<uint32_t, 0xD8>(); }
+  uint32_t sizeBSS() const             { return field<uint32_t, 0xDC>(); }
+  uint32_t entrypoint() const          { return field<uint32_t, 0xE0>(); }
+
+  // Byte swap the whole header into host order in one pass
+  void copy_to(dolhdr *header) const
+  {
+    be_swap32_array(reinterpret_cast<uint32_t *>(header), data(), sizeof(dolhdr) / sizeof(uint32_t));
+  }
+};
+
 #endif
\ No newline at end of file
@@ -2,7 +2,10 @@
 
 dol_track::dol_track() : m_valid(false) { }
 
-dol_track::dol_track(linput_t *p_input) : m_valid(false), m_file_size(qlsize(p_input)), m_input_file(p_input)
+dol_track::dol_track(linput_t *p_input) : dol_track(p_input, 0, static_cast<uint32_t>(qlsize(p_input))) { }
+
+dol_track::dol_track(linput_t *p_input, uint64_t offset, uint32_t size, bool patchable)
+    : m_valid(false), m_input_file(p_input), m_offset(offset), m_file_size(size), m_patchable(patchable)
 {
     // Read the header
     if (!this->read_header()) {
@@ -23,29 +26,26 @@ bool dol_track::read_header()
     if (m_file_size < 0x100)
         return err_msg("DOL: file is too short to be valid");
 
-    dolhdr base_header;
     // Read the DOL header
-    qlseek(m_input_file, 0, SEEK_SET);
-    if (qlread(m_input_file, &base_header, sizeof(dolhdr)) != sizeof(dolhdr))
+    uint8_t block[sizeof(dolhdr)];
+    qlseek(m_input_file, static_cast<qoff64_t>(m_offset), SEEK_SET);
+    if (qlread(m_input_file, block, sizeof(block)) != sizeof(block))
         return err_msg("DOL: header is too short or file is inaccessible");
 
-    // Swap endianness
-    for (int i = 0; i<7; i++) {
-        base_header.offsetText[i] = swap32(base_header.offsetText[i]);
-        base_header.addressText[i] = swap32(base_header.addressText[i]);
-        base_header.sizeText[i] = swap32(base_header.sizeText[i]);
-    }
-    for (int i = 0; i<11; i++) {
-        base_header.offsetData[i] = swap32(base_header.offsetData[i]);
-        base_header.addressData[i] = swap32(base_header.addressData[i]);
-        base_header.sizeData[i] = swap32(base_header.sizeData[i]);
+    // Compressed executables are decompressed in memory and loaded from there
+    if (compression_detect(block, sizeof(block)) != COMPRESSION_NONE) {
+        if (!m_unpacked.read(m_input_file, m_offset, m_file_size) || !m_unpacked.unpack())
+            return err_msg("DOL: failed to decompress the input");
+        msg("DOL: Decompressed %u bytes to %u\n", static_cast<uint32_t>(m_unpacked.packed_size()), static_cast<uint32_t>(m_unpacked.size()));
+
+        m_file_size = static_cast<uint32_t>(m_unpacked.size());
+        if (m_file_size < sizeof(block))
+            return err_msg("DOL: file is too short to be valid");
+        memcpy(block, m_unpacked.data(), sizeof(block));
     }
-    base_header.entrypoint = swap32(base_header.entrypoint);
-    base_header.sizeBSS = swap32(base_header.sizeBSS);
-    base_header.addressBSS = swap32(base_header.addressBSS);
 
-    // Set header
-    header = base_header;
+    // Swap endianness of every table in one go
+    dolhdr_view(block).copy_to(&header);
     return true;
 }
 
@@ -95,4 +95,72 @@ bool dol_track::validate_header()
 bool dol_track::is_good() const
 {
     return m_valid;
-}
\ No newline at end of file
+}
+
+void dol_track::load_contents(uint32_t offset, ea_t start, ea_t end)
+{
+    // Decompressed bytes have no place in the input file to patch back to
+    if (!m_unpacked.empty())
+        mem2base(m_unpacked.data() + offset, start, end, -1);
+    else
+        file2base(m_input_file, m_offset + offset, start, end, m_patchable ? FILEREG_PATCHABLE : FILEREG_NOTPATCHABLE);
+}
+
+bool dol_track::create_segments()
+{
+    // create all code segments
+    for (uint i = 0, snum = 1; i < 7; i++, snum++) {
+        qstring buf;
+
+        // 0 == no segment
+        if (header.addressText[i] == 0)
+            continue;
+
+        // create a name according to segmenttype and number
+        buf.sprnt(NAME_CODE "%u", snum);
+
+        // add the code segment
+        if (!add_segm(1, header.addressText[i], header.addressText[i] + header.sizeText[i], buf.c_str(), CLASS_CODE))
+            return err_msg("DOL: failed to create .text segment %u", i);
+
+        // set addressing to 32 bit
+        set_segm_addressing(getseg(header.addressText[i]), 1);
+
+        // and get the content from the file
+        this->load_contents(header.offsetText[i], header.addressText[i], header.addressText[i] + header.sizeText[i]);
+    }
+
+    // create all data segments
+    for (uint i = 0, snum = 1; i < 11; i++, snum++) {
+        qstring buf;
+
+        // 0 == no segment
+        if (header.addressData[i] == 0)
+            continue;
+
+        // create a name according to segmenttype and number
+        buf.sprnt(NAME_DATA "%u", snum);
+
+        // add the data segment
+        if (!add_segm(1, header.addressData[i], header.addressData[i] + header.sizeData[i], buf.c_str(), CLASS_DATA))
+            return err_msg("DOL: failed to create .data segment %u", i);
+
+        // set addressing to 32 bit
+        set_segm_addressing(getseg(header.addressData[i]), 1);
+
+        // and get the content from the file
+        this->load_contents(header.offsetData[i], header.addressData[i], header.addressData[i] + header.sizeData[i]);
+    }
+
+    // is there a BSS defined?
+    if (header.addressBSS != 0) {
+        // then add it
+        if (!add_segm(1, header.addressBSS, header.addressBSS + header.sizeBSS, NAME_BSS, CLASS_BSS))
+            return err_msg("DOL: failed to create the .bss segment");
+
+        // and set addressing mode to 32 bit
+        set_segm_addressing(getseg(header.addressBSS), 1);
+    }
+
+    return true;
+}
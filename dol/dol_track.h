@@ -1,5 +1,6 @@
 #pragma once
 #include "dol.h"
+#include "../loader/input_buffer.h"
 
 class dol_track
 {
@@ -7,16 +8,32 @@ public:
     dol_track();
     dol_track(linput_t *p_input);
 
+    // A DOL stored at offset in the input, e.g. the boot DOL of a disc image.
+    // Inputs that are not the file on disk (a decrypted Wii partition) are
+    // not patchable.
+    dol_track(linput_t *p_input, uint64_t offset, uint32_t size, bool patchable = true);
+
     bool is_good() const;
 
+    // Create the segments described by the header and load their contents
+    bool create_segments();
+
     dolhdr header;
 
 private:
     bool read_header();
     bool validate_header();
 
+    // Fill a segment with file contents
+    void load_contents(uint32_t offset, ea_t start, ea_t end);
+
     bool m_valid;
     linput_t* m_input_file;
+    uint64_t m_offset;      // of the DOL in the input file
     uint32_t m_file_size;
+    bool m_patchable;
+
+    // Decompressed contents of a compressed DOL, empty otherwise
+    input_buffer m_unpacked;
 };
 
@@ -0,0 +1,322 @@
+#include "aes.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define AES_HAS_HARDWARE 1
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AES_TARGET
+#else
+#include <cpuid.h>
+#define AES_TARGET __attribute__((target("aes,sse2")))
+#endif
+#endif
+
+static uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    uint8_t product = 0;
+    while ( b != 0 )
+    {
+        if ( b & 1 )
+            product ^= a;
+        a = static_cast<uint8_t>((a << 1) ^ ((a & 0x80) ? 0x1B : 0));
+        b >>= 1;
+    }
+    return product;
+}
+
+static inline uint32_t rotl(uint32_t value, unsigned bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// Columns are little endian, row 0 in the low byte
+static inline uint32_t load_column(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static inline void store_column(uint8_t *p, uint32_t value)
+{
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+    p[2] = static_cast<uint8_t>(value >> 16);
+    p[3] = static_cast<uint8_t>(value >> 24);
+}
+
+// S-boxes and the decryption round tables, built once from the field
+// arithmetic rather than spelled out
+struct aes_tables
+{
+    uint8_t m_sbox[256];
+    uint8_t m_inverse[256];
+    uint32_t m_td[4][256];   // InvSubBytes and InvMixColumns of one byte, per row
+
+    aes_tables()
+    {
+        // Walk the multiplicative group with generator 3 to get the inverses
+        uint8_t p = 1, q = 1;
+        do
+        {
+            p = static_cast<uint8_t>(p ^ (p << 1) ^ ((p & 0x80) ? 0x1B : 0));
+            q ^= q << 1;
+            q ^= q << 2;
+            q ^= q << 4;
+            if ( q & 0x80 )
+                q ^= 0x09;
+            uint8_t s = static_cast<uint8_t>(q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4) ^ 0x63);
+            m_sbox[p] = s;
+        } while ( p != 1 );
+        m_sbox[0] = 0x63;
+
+        for ( unsigned i = 0; i < 256; ++i )
+            m_inverse[m_sbox[i]] = static_cast<uint8_t>(i);
+
+        for ( unsigned i = 0; i < 256; ++i )
+        {
+            uint8_t s = m_inverse[i];
+            uint32_t column = gf_mul(s, 0x0E) | (gf_mul(s, 0x09) << 8) | (gf_mul(s, 0x0D) << 16) |
+                              (static_cast<uint32_t>(gf_mul(s, 0x0B)) << 24);
+            for ( unsigned row = 0; row < 4; ++row )
+                m_td[row][i] = row == 0 ? column : rotl(column, row * 8);
+        }
+    }
+
+    static uint8_t rotl8(uint8_t value, unsigned bits)
+    {
+        return static_cast<uint8_t>((value << bits) | (value >> (8 - bits)));
+    }
+};
+
+static const aes_tables s_tables;
+
+static void inverse_mix_column(uint8_t *column)
+{
+    uint8_t a = column[0], b = column[1], c = column[2], d = column[3];
+    column[0] = gf_mul(a, 0x0E) ^ gf_mul(b, 0x0B) ^ gf_mul(c, 0x0D) ^ gf_mul(d, 0x09);
+    column[1] = gf_mul(a, 0x09) ^ gf_mul(b, 0x0E) ^ gf_mul(c, 0x0B) ^ gf_mul(d, 0x0D);
+    column[2] = gf_mul(a, 0x0D) ^ gf_mul(b, 0x09) ^ gf_mul(c, 0x0E) ^ gf_mul(d, 0x0B);
+    column[3] = gf_mul(a, 0x0B) ^ gf_mul(b, 0x0D) ^ gf_mul(c, 0x09) ^ gf_mul(d, 0x0E);
+}
+
+aes128::aes128()
+{
+    memset(m_encrypt_keys, 0, sizeof(m_encrypt_keys));
+    memset(m_decrypt_keys, 0, sizeof(m_decrypt_keys));
+}
+
+void aes128::set_key(const uint8_t key[AES_BLOCK_SIZE])
+{
+    uint8_t *words = &m_encrypt_keys[0][0];
+    memcpy(words, key, AES_BLOCK_SIZE);
+
+    uint8_t rcon = 1;
+    for ( unsigned i = 4; i < 4 * (AES_ROUNDS + 1); ++i )
+    {
+        uint8_t t[4];
+        memcpy(t, words + (i - 1) * 4, 4);
+        if ( i % 4 == 0 )
+        {
+            uint8_t first = t[0];
+            t[0] = s_tables.m_sbox[t[1]] ^ rcon;
+            t[1] = s_tables.m_sbox[t[2]];
+            t[2] = s_tables.m_sbox[t[3]];
+            t[3] = s_tables.m_sbox[first];
+            rcon = gf_mul(rcon, 2);
+        }
+        for ( unsigned j = 0; j < 4; ++j )
+            words[i * 4 + j] = words[(i - 4) * 4 + j] ^ t[j];
+    }
+
+    // The equivalent inverse cipher runs the rounds in reverse with
+    // InvMixColumns folded into the inner round keys. AES-NI expects the
+    // same schedule.
+    for ( unsigned round = 0; round <= AES_ROUNDS; ++round )
+    {
+        memcpy(m_decrypt_keys[round], m_encrypt_keys[AES_ROUNDS - round], AES_BLOCK_SIZE);
+        if ( round != 0 && round != AES_ROUNDS )
+        {
+            for ( unsigned column = 0; column < 4; ++column )
+                inverse_mix_column(&m_decrypt_keys[round][column * 4]);
+        }
+    }
+}
+
+bool aes128::hardware()
+{
+#ifdef AES_HAS_HARDWARE
+    static const bool s_hardware = []()
+    {
+#ifdef _MSC_VER
+        int info[4] = {};
+        __cpuid(info, 1);
+        return (info[2] & (1 << 25)) != 0;
+#else
+        unsigned eax, ebx, ecx, edx;
+        return __get_cpuid(1, &eax, &ebx, &ecx, &edx) != 0 && (ecx & bit_AES) != 0;
+#endif
+    }();
+    return s_hardware;
+#else
+    return false;
+#endif
+}
+
+void aes128::decrypt_cbc(const uint8_t iv[AES_BLOCK_SIZE], const uint8_t *in, uint8_t *out, size_t size) const
+{
+    if ( hardware() )
+        this->decrypt_hardware(iv, in, out, size);
+    else
+        this->decrypt_tables(iv, in, out, size);
+}
+
+void aes128::decrypt_tables(const uint8_t iv[AES_BLOCK_SIZE], const uint8_t *in, uint8_t *out, size_t size) const
+{
+    uint8_t chain[AES_BLOCK_SIZE];
+    memcpy(chain, iv, sizeof(chain));
+
+    uint32_t keys[AES_ROUNDS + 1][4];
+    for ( unsigned round = 0; round <= AES_ROUNDS; ++round )
+    {
+        for ( unsigned c = 0; c < 4; ++c )
+            keys[round][c] = load_column(m_decrypt_keys[round] + c * 4);
+    }
+
+    auto const &td = s_tables.m_td;
+    for ( size_t offset = 0; offset + AES_BLOCK_SIZE <= size; offset += AES_BLOCK_SIZE )
+    {
+        uint8_t cipher[AES_BLOCK_SIZE];
+        memcpy(cipher, in + offset, sizeof(cipher));
+
+        uint32_t s[4], t[4];
+        for ( unsigned c = 0; c < 4; ++c )
+            s[c] = load_column(cipher + c * 4) ^ keys[0][c];
+
+        // InvShiftRows moves row r right by r columns
+        for ( unsigned round = 1; round < AES_ROUNDS; ++round )
+        {
+            for ( unsigned c = 0; c < 4; ++c )
+            {
+                t[c] = td[0][s[c] & 0xFF] ^ td[1][(s[(c + 3) & 3] >> 8) & 0xFF] ^
+                       td[2][(s[(c + 2) & 3] >> 16) & 0xFF] ^ td[3][s[(c + 1) & 3] >> 24] ^
+                       keys[round][c];
+            }
+            memcpy(s, t, sizeof(s));
+        }
+
+        const uint8_t *inverse = s_tables.m_inverse;
+        for ( unsigned c = 0; c < 4; ++c )
+        {
+            uint32_t column = inverse[s[c] & 0xFF] | (inverse[(s[(c + 3) & 3] >> 8) & 0xFF] << 8) |
+                              (inverse[(s[(c + 2) & 3] >> 16) & 0xFF] << 16) |
+                              (static_cast<uint32_t>(inverse[s[(c + 1) & 3] >> 24]) << 24);
+            column ^= keys[AES_ROUNDS][c] ^ load_column(chain + c * 4);
+            store_column(out + offset + c * 4, column);
+        }
+        memcpy(chain, cipher, sizeof(chain));
+    }
+}
+
+#ifdef AES_HAS_HARDWARE
+// The blocks of a CBC decryption are independent, four are kept in flight
+// to hide the latency of aesdec
+AES_TARGET static void decrypt_blocks(const uint8_t keys[AES_ROUNDS + 1][AES_BLOCK_SIZE], const uint8_t iv[AES_BLOCK_SIZE],
+                                      const uint8_t *in, uint8_t *out, size_t size)
+{
+    __m128i k[AES_ROUNDS + 1];
+    for ( unsigned round = 0; round <= AES_ROUNDS; ++round )
+        k[round] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys[round]));
+
+    __m128i chain = _mm_loadu_si128(reinterpret_cast<const __m128i *>(iv));
+    size_t offset = 0;
+    for ( ; offset + 4 * AES_BLOCK_SIZE <= size; offset += 4 * AES_BLOCK_SIZE )
+    {
+        const __m128i *src = reinterpret_cast<const __m128i *>(in + offset);
+        __m128i c0 = _mm_loadu_si128(src), c1 = _mm_loadu_si128(src + 1);
+        __m128i c2 = _mm_loadu_si128(src + 2), c3 = _mm_loadu_si128(src + 3);
+        __m128i b0 = _mm_xor_si128(c0, k[0]), b1 = _mm_xor_si128(c1, k[0]);
+        __m128i b2 = _mm_xor_si128(c2, k[0]), b3 = _mm_xor_si128(c3, k[0]);
+        for ( unsigned round = 1; round < AES_ROUNDS; ++round )
+        {
+            b0 = _mm_aesdec_si128(b0, k[round]);
+            b1 = _mm_aesdec_si128(b1, k[round]);
+            b2 = _mm_aesdec_si128(b2, k[round]);
+            b3 = _mm_aesdec_si128(b3, k[round]);
+        }
+        b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, k[AES_ROUNDS]), chain);
+        b1 = _mm_xor_si128(_mm_aesdeclast_si128(b1, k[AES_ROUNDS]), c0);
+        b2 = _mm_xor_si128(_mm_aesdeclast_si128(b2, k[AES_ROUNDS]), c1);
+        b3 = _mm_xor_si128(_mm_aesdeclast_si128(b3, k[AES_ROUNDS]), c2);
+        __m128i *dst = reinterpret_cast<__m128i *>(out + offset);
+        _mm_storeu_si128(dst, b0);
+        _mm_storeu_si128(dst + 1, b1);
+        _mm_storeu_si128(dst + 2, b2);
+        _mm_storeu_si128(dst + 3, b3);
+        chain = c3;
+    }
+    for ( ; offset + AES_BLOCK_SIZE <= size; offset += AES_BLOCK_SIZE )
+    {
+        __m128i cipher = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + offset));
+        __m128i block = _mm_xor_si128(cipher, k[0]);
+        for ( unsigned round = 1; round < AES_ROUNDS; ++round )
+            block = _mm_aesdec_si128(block, k[round]);
+        block = _mm_xor_si128(_mm_aesdeclast_si128(block, k[AES_ROUNDS]), chain);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + offset), block);
+        chain = cipher;
+    }
+}
+#endif
+
+void aes128::decrypt_hardware(const uint8_t iv[AES_BLOCK_SIZE], const uint8_t *in, uint8_t *out, size_t size) const
+{
+#ifdef AES_HAS_HARDWARE
+    decrypt_blocks(m_decrypt_keys, iv, in, out, size);
+#else
+    this->decrypt_tables(iv, in, out, size);
+#endif
+}
+
+void aes128::encrypt_cbc(const uint8_t iv[AES_BLOCK_SIZE], const uint8_t *in, uint8_t *out, size_t size) const
+{
+    uint8_t chain[AES_BLOCK_SIZE];
+    memcpy(chain, iv, sizeof(chain));
+
+    for ( size_t offset = 0; offset + AES_BLOCK_SIZE <= size; offset += AES_BLOCK_SIZE )
+    {
+        uint8_t state[AES_BLOCK_SIZE];
+        for ( unsigned i = 0; i < AES_BLOCK_SIZE; ++i )
+            state[i] = in[offset + i] ^ chain[i] ^ m_encrypt_keys[0][i];
+
+        for ( unsigned round = 1; round <= AES_ROUNDS; ++round )
+        {
+            // SubBytes and ShiftRows, row r moves left by r columns
+            uint8_t shifted[AES_BLOCK_SIZE];
+            for ( unsigned c = 0; c < 4; ++c )
+            {
+                for ( unsigned r = 0; r < 4; ++r )
+                    shifted[c * 4 + r] = s_tables.m_sbox[state[((c + r) & 3) * 4 + r]];
+            }
+
+            for ( unsigned c = 0; c < 4; ++c )
+            {
+                uint8_t *column = &shifted[c * 4];
+                if ( round != AES_ROUNDS )
+                {
+                    uint8_t a = column[0], b = column[1], d = column[2], e = column[3];
+                    column[0] = gf_mul(a, 2) ^ gf_mul(b, 3) ^ d ^ e;
+                    column[1] = a ^ gf_mul(b, 2) ^ gf_mul(d, 3) ^ e;
+                    column[2] = a ^ b ^ gf_mul(d, 2) ^ gf_mul(e, 3);
+                    column[3] = gf_mul(a, 3) ^ b ^ d ^ gf_mul(e, 2);
+                }
+                for ( unsigned r = 0; r < 4; ++r )
+                    state[c * 4 + r] = column[r] ^ m_encrypt_keys[round][c * 4 + r];
+            }
+        }
+
+        memcpy(out + offset, state, sizeof(state));
+        memcpy(chain, state, sizeof(chain));
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef __AES_H__
+#define __AES_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#define AES_BLOCK_SIZE 16
+#define AES_ROUNDS     10
+
+// AES-128 in CBC mode, as used for the Wii disc partitions. Decryption uses
+// AES-NI when the CPU has it and lookup tables otherwise; encryption is only
+// needed to build test images and is kept simple.
+class aes128
+{
+public:
+    aes128();
+
+    void set_key(const uint8_t key[AES_BLOCK_SIZE]);
+
+    // size is a multiple of AES_BLOCK_SIZE, in and out may be the same buffer
+    void decrypt_cbc(const uint8_t iv[AES_BLOCK_SIZE], const uint8_t *in, uint8_t *out, size_t size) const;
+    void encrypt_cbc(const uint8_t iv[AES_BLOCK_SIZE], const uint8_t *in, uint8_t *out, size_t size) const;
+
+    // Whether decryption runs on AES-NI
+    static bool hardware();
+
+private:
+    void decrypt_tables(const uint8_t iv[AES_BLOCK_SIZE], const uint8_t *in, uint8_t *out, size_t size) const;
+    void decrypt_hardware(const uint8_t iv[AES_BLOCK_SIZE], const uint8_t *in, uint8_t *out, size_t size) const;
+
+    uint8_t m_encrypt_keys[AES_ROUNDS + 1][AES_BLOCK_SIZE];
+    uint8_t m_decrypt_keys[AES_ROUNDS + 1][AES_BLOCK_SIZE];   // equivalent inverse cipher
+};
+
+#endif // #ifndef __AES_H__
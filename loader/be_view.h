@@ -0,0 +1,96 @@
+#ifndef __BE_VIEW_H__
+#define __BE_VIEW_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BE_VIEW_SSE2 1
+#endif
+
+#ifdef _MSC_VER
+#include <stdlib.h>
+#define be_bswap16(x) _byteswap_ushort(x)
+#define be_bswap32(x) _byteswap_ulong(x)
+#else
+#define be_bswap16(x) __builtin_bswap16(x)
+#define be_bswap32(x) __builtin_bswap32(x)
+#endif
+
+// Load a big endian value of type T from an unaligned pointer
+template <typename T> inline T be_load(const uint8_t *p);
+
+template <> inline uint8_t be_load<uint8_t>(const uint8_t *p)
+{
+    return *p;
+}
+
+template <> inline uint16_t be_load<uint16_t>(const uint8_t *p)
+{
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return be_bswap16(value);
+}
+
+template <> inline uint32_t be_load<uint32_t>(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return be_bswap32(value);
+}
+
+template <> inline int32_t be_load<int32_t>(const uint8_t *p)
+{
+    return static_cast<int32_t>(be_load<uint32_t>(p));
+}
+
+// Byte swap count big endian dwords from src into dst. Uses SSE2 shuffles
+// four dwords at a time where available.
+inline void be_swap32_array(uint32_t *dst, const uint8_t *src, size_t count)
+{
+    size_t i = 0;
+#ifdef BE_VIEW_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+        // swap the bytes of each word, then the words of each dword
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = be_load<uint32_t>(src + i * 4);
+}
+
+// Read-only view of a big endian structure laid out in a byte buffer.
+// Field offsets are template arguments, so every accessor compiles down to
+// an unaligned load and a byte swap.
+class be_view
+{
+public:
+    explicit be_view(const uint8_t *base) : m_base(base) { }
+
+    const uint8_t *data() const { return m_base; }
+
+protected:
+    template <typename T, size_t Offset>
+    T field() const
+    {
+        return be_load<T>(m_base + Offset);
+    }
+
+    template <typename T, size_t Offset>
+    T element(size_t index) const
+    {
+        return be_load<T>(m_base + Offset + index * sizeof(T));
+    }
+
+private:
+    const uint8_t *m_base;
+};
+
+#endif // #ifndef __BE_VIEW_H__
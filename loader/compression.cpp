@@ -0,0 +1,237 @@
+#include "compression.h"
+
+#include <algorithm>
+#include <cstring>
+
+static uint32_t be32(const uint8_t *p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+// Number of literals at the top of a flag byte, so runs of literals are
+// copied in one go instead of bit by bit
+struct literal_runs
+{
+    uint8_t m_run[256];
+
+    literal_runs()
+    {
+        for ( unsigned flags = 0; flags < 256; ++flags )
+        {
+            uint8_t run = 0;
+            while ( run < 8 && (flags & (0x80 >> run)) != 0 )
+                ++run;
+            m_run[flags] = run;
+        }
+    }
+};
+
+static const literal_runs s_runs;
+
+// Copy up to eight bytes. With room for all eight they are copied at once
+// and the bytes past count are overwritten by the next operation, which is
+// much cheaper than a memcpy of a variable size for these short runs.
+static inline void copy_short(uint8_t *out, const uint8_t *from, size_t count, size_t room)
+{
+    if ( room >= 8 )
+        memcpy(out, from, 8);
+    else
+    {
+        for ( size_t i = 0; i < count; ++i )
+            out[i] = from[i];
+    }
+}
+
+// Copy a back reference, the source may overlap the destination
+static inline void copy_match(uint8_t *out, uint32_t distance, size_t length, uint8_t *out_end)
+{
+    const uint8_t *from = out - distance;
+    if ( distance >= 8 && static_cast<size_t>(out_end - out) >= length + 8 )
+    {
+        // Every eight byte block reads bytes already written
+        for ( size_t i = 0; i < length; i += 8 )
+            memcpy(out + i, from + i, 8);
+    }
+    else if ( distance == 1 )
+        memset(out, *from, length);
+    else
+    {
+        for ( size_t i = 0; i < length; ++i )
+            out[i] = from[i];
+    }
+}
+
+compression_format compression_detect(const uint8_t *data, size_t size, uint32_t *unpacked_size)
+{
+    if ( size < COMPRESSION_HEADER_SIZE )
+        return COMPRESSION_NONE;
+
+    compression_format format = COMPRESSION_NONE;
+    if ( memcmp(data, "Yaz0", 4) == 0 )
+        format = COMPRESSION_YAZ0;
+    else if ( memcmp(data, "Yay0", 4) == 0 )
+        format = COMPRESSION_YAY0;
+
+    if ( format != COMPRESSION_NONE && unpacked_size != nullptr )
+        *unpacked_size = be32(data + 4);
+    return format;
+}
+
+const char *compression_name(compression_format format)
+{
+    switch ( format )
+    {
+    case COMPRESSION_YAZ0: return "Yaz0";
+    case COMPRESSION_YAY0: return "Yay0";
+    default:               return "none";
+    }
+}
+
+size_t yaz0_decode(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+    const uint8_t *in = src;
+    const uint8_t *in_end = src + src_size;
+    uint8_t *out = dst;
+    uint8_t *out_end = dst + dst_size;
+
+    while ( out < out_end && in < in_end )
+    {
+        // Eight operations per flag byte, set bits are literals
+        unsigned flags = *in++;
+        unsigned count = 8;
+        while ( count != 0 && out < out_end )
+        {
+            size_t run = s_runs.m_run[flags];
+            if ( run != 0 )
+            {
+                if ( run > static_cast<size_t>(out_end - out) )
+                    run = static_cast<size_t>(out_end - out);
+                if ( run > static_cast<size_t>(in_end - in) )
+                    return static_cast<size_t>(out - dst);
+                copy_short(out, in, run, std::min(out_end - out, in_end - in));
+                out += run;
+                in += run;
+                flags = (flags << run) & 0xFF;
+                count -= static_cast<unsigned>(run);
+                if ( count == 0 || out >= out_end )
+                    break;
+            }
+
+            // Back reference: length in the top nibble (0 means a third
+            // byte holds length - 0x12), distance - 1 in the low 12 bits
+            if ( in_end - in < 2 )
+                return static_cast<size_t>(out - dst);
+            uint32_t distance = (((in[0] & 0x0F) << 8) | in[1]) + 1;
+            size_t length = in[0] >> 4;
+            in += 2;
+            if ( length == 0 )
+            {
+                if ( in >= in_end )
+                    return static_cast<size_t>(out - dst);
+                length = *in++ + 0x12;
+            }
+            else
+                length += 2;
+
+            if ( distance > static_cast<size_t>(out - dst) )
+                return static_cast<size_t>(out - dst);
+            if ( length > static_cast<size_t>(out_end - out) )
+                length = static_cast<size_t>(out_end - out);
+            copy_match(out, distance, length, out_end);
+            out += length;
+
+            flags = (flags << 1) & 0xFF;
+            --count;
+        }
+    }
+    return static_cast<size_t>(out - dst);
+}
+
+size_t yay0_decode(const uint8_t *flags, size_t flags_size, const uint8_t *links, size_t links_size,
+                   const uint8_t *chunks, size_t chunks_size, uint8_t *dst, size_t dst_size)
+{
+    const uint8_t *flags_end = flags + flags_size;
+    const uint8_t *links_end = links + links_size;
+    const uint8_t *chunks_end = chunks + chunks_size;
+    uint8_t *out = dst;
+    uint8_t *out_end = dst + dst_size;
+
+    while ( out < out_end && flags_end - flags >= 4 )
+    {
+        // 32 operations per flag word, handled a byte at a time
+        for ( unsigned byte = 0; byte < 4 && out < out_end; ++byte )
+        {
+            unsigned bits = *flags++;
+            unsigned count = 8;
+            while ( count != 0 && out < out_end )
+            {
+                size_t run = s_runs.m_run[bits];
+                if ( run != 0 )
+                {
+                    if ( run > static_cast<size_t>(out_end - out) )
+                        run = static_cast<size_t>(out_end - out);
+                    if ( run > static_cast<size_t>(chunks_end - chunks) )
+                        return static_cast<size_t>(out - dst);
+                    copy_short(out, chunks, run, std::min(out_end - out, chunks_end - chunks));
+                    out += run;
+                    chunks += run;
+                    bits = (bits << run) & 0xFF;
+                    count -= static_cast<unsigned>(run);
+                    if ( count == 0 || out >= out_end )
+                        break;
+                }
+
+                // Back reference from the link table, a zero length nibble
+                // takes length - 0x12 from the literal stream
+                if ( links_end - links < 2 )
+                    return static_cast<size_t>(out - dst);
+                uint32_t distance = (((links[0] & 0x0F) << 8) | links[1]) + 1;
+                size_t length = links[0] >> 4;
+                links += 2;
+                if ( length == 0 )
+                {
+                    if ( chunks >= chunks_end )
+                        return static_cast<size_t>(out - dst);
+                    length = *chunks++ + 0x12;
+                }
+                else
+                    length += 2;
+
+                if ( distance > static_cast<size_t>(out - dst) )
+                    return static_cast<size_t>(out - dst);
+                if ( length > static_cast<size_t>(out_end - out) )
+                    length = static_cast<size_t>(out_end - out);
+                copy_match(out, distance, length, out_end);
+                out += length;
+
+                bits = (bits << 1) & 0xFF;
+                --count;
+            }
+        }
+    }
+    return static_cast<size_t>(out - dst);
+}
+
+size_t decompress(const uint8_t *data, size_t size, uint8_t *dst, size_t dst_size)
+{
+    switch ( compression_detect(data, size) )
+    {
+    case COMPRESSION_YAZ0:
+        return yaz0_decode(data + COMPRESSION_HEADER_SIZE, size - COMPRESSION_HEADER_SIZE, dst, dst_size);
+
+    case COMPRESSION_YAY0:
+    {
+        // The flags run from the header up to the link table
+        uint32_t links = be32(data + 8);
+        uint32_t chunks = be32(data + 12);
+        if ( links < COMPRESSION_HEADER_SIZE || links > size || chunks < links || chunks > size )
+            return 0;
+        return yay0_decode(data + COMPRESSION_HEADER_SIZE, links - COMPRESSION_HEADER_SIZE, data + links, chunks - links,
+                           data + chunks, size - chunks, dst, dst_size);
+    }
+
+    default:
+        return 0;
+    }
+}
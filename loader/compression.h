@@ -0,0 +1,43 @@
+#ifndef __COMPRESSION_H__
+#define __COMPRESSION_H__
+
+#include <cstddef>
+#include <cstdint>
+
+// Nintendo's LZ formats. Modules are commonly shipped as Yaz0 (.szs), older
+// titles use Yay0, which keeps the flags, back references and literals in
+// three separate streams.
+enum compression_format
+{
+    COMPRESSION_NONE,
+    COMPRESSION_YAZ0,
+    COMPRESSION_YAY0,
+};
+
+#define COMPRESSION_HEADER_SIZE 0x10
+
+// Longest back reference of both formats
+#define COMPRESSION_MAX_MATCH 0x111
+
+// Most bytes one input byte can decode to: a two byte back reference copies
+// at most COMPRESSION_MAX_MATCH bytes. Headers claiming more are damaged.
+#define COMPRESSION_MAX_RATIO ((COMPRESSION_MAX_MATCH + 1) / 2)
+
+// Format of a file from its first bytes, with the size it decompresses to
+compression_format compression_detect(const uint8_t *data, size_t size, uint32_t *unpacked_size = nullptr);
+
+const char *compression_name(compression_format format);
+
+// Decode the Yaz0 stream that follows the header. Decoding stops when dst is
+// full, so a short dst decodes only the start of the file. Returns the bytes
+// written, less than dst_size if the input ended or is damaged.
+size_t yaz0_decode(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size);
+
+// Decode Yay0 from its three streams, see yaz0_decode
+size_t yay0_decode(const uint8_t *flags, size_t flags_size, const uint8_t *links, size_t links_size,
+                   const uint8_t *chunks, size_t chunks_size, uint8_t *dst, size_t dst_size);
+
+// Decode a whole compressed file, header included. Returns the bytes written.
+size_t decompress(const uint8_t *data, size_t size, uint8_t *dst, size_t dst_size);
+
+#endif // #ifndef __COMPRESSION_H__
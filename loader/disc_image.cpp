@@ -0,0 +1,114 @@
+#include "disc_image.h"
+#include "input_buffer.h"
+#include "../dol/dol.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Read size bytes at offset of the image, all or nothing
+static bool read_range(linput_t *li, uint64_t offset, void *buffer, size_t size)
+{
+    if (qlseek(li, static_cast<qoff64_t>(offset), SEEK_SET) != static_cast<qoff64_t>(offset))
+        return false;
+    return qlread(li, buffer, size) == static_cast<ssize_t>(size);
+}
+
+disc_image::disc_image() : m_input(nullptr), m_shift(0), m_size(0)
+{
+    memset(m_game_id, 0, sizeof(m_game_id));
+    m_dol = disc_file{ "main.dol", 0, 0 };
+}
+
+disc_image::~disc_image()
+{
+    this->close();
+}
+
+void disc_image::close()
+{
+    // The partition input reads through the Wii disc, it goes first
+    if (m_wii != nullptr)
+        close_linput(m_input);
+    m_wii.reset();
+    m_input = nullptr;
+}
+
+bool disc_image::open(linput_t *li)
+{
+    this->close();
+    m_files.clear();
+
+    // Wii discs, plain or in a WBFS container, are read through their
+    // decrypted data partition, which starts with a GameCube style header
+    uint8_t magic[DISC_MAGIC_OFFSET + 4];
+    if (!read_range(li, 0, magic, sizeof(magic)))
+        return err_msg("Disc: the image is too short for a disc header");
+    if (read_be32(magic) == WBFS_MAGIC || read_be32(magic + WII_MAGIC_OFFSET) == WII_MAGIC)
+    {
+        m_wii.reset(new wii_disc());
+        if (!m_wii->open(li) || (m_input = m_wii->create_input()) == nullptr)
+        {
+            m_wii.reset();
+            return false;
+        }
+        m_shift = 2;
+    }
+    else
+    {
+        m_input = li;
+        m_shift = 0;
+    }
+    m_size = static_cast<uint64_t>(qlsize(m_input));
+
+    uint8_t header[DISC_HEADER_SIZE];
+    if (m_size < DISC_HEADER_SIZE || !read_range(m_input, 0, header, sizeof(header)))
+        return err_msg("Disc: the image is too short for a disc header");
+    if (m_wii != nullptr ? read_be32(header + WII_MAGIC_OFFSET) != WII_MAGIC : read_be32(header + DISC_MAGIC_OFFSET) != DISC_MAGIC_GAMECUBE)
+        return err_msg("Disc: not a GameCube or Wii disc image");
+
+    memcpy(m_game_id, header, 6);
+    m_title.assign(reinterpret_cast<const char *>(header + DISC_TITLE_OFFSET), strnlen(reinterpret_cast<const char *>(header + DISC_TITLE_OFFSET), DISC_TITLE_SIZE));
+
+    // The DOL has no FST entry, its extent is the furthest of its sections
+    uint64_t dol_offset = uint64_t(read_be32(header + DISC_DOL_OFFSET)) << m_shift;
+    uint8_t dol[sizeof(dolhdr)];
+    if (dol_offset < DISC_HEADER_SIZE || dol_offset + sizeof(dol) > m_size || !read_range(m_input, dol_offset, dol, sizeof(dol)))
+        return err_msg("Disc: the DOL offset %08llX is out of bounds", static_cast<unsigned long long>(dol_offset));
+
+    dolhdr_view hdr(dol);
+    uint64_t dol_size = sizeof(dolhdr);
+    for (size_t i = 0; i < 7; i++)
+        dol_size = std::max<uint64_t>(dol_size, uint64_t(hdr.offsetText(i)) + hdr.sizeText(i));
+    for (size_t i = 0; i < 11; i++)
+        dol_size = std::max<uint64_t>(dol_size, uint64_t(hdr.offsetData(i)) + hdr.sizeData(i));
+    if (dol_offset + dol_size > m_size)
+        return err_msg("Disc: the DOL at %08llX runs past the end of the image", static_cast<unsigned long long>(dol_offset));
+    m_dol.m_offset = dol_offset;
+    m_dol.m_size = static_cast<uint32_t>(dol_size);
+
+    if (!this->read_fst(uint64_t(read_be32(header + DISC_FST_OFFSET)) << m_shift, uint64_t(read_be32(header + DISC_FST_SIZE)) << m_shift))
+        return false;
+
+    msg("Disc: %s \"%s\", %s, %u files, DOL at %08llX\n", m_game_id, m_title.c_str(),
+        m_wii == nullptr ? "GameCube" : m_wii->wbfs() ? "Wii (WBFS)" : "Wii",
+        static_cast<uint32_t>(m_files.size()), static_cast<unsigned long long>(dol_offset));
+    return true;
+}
+
+bool disc_image::read_fst(uint64_t offset, uint64_t size)
+{
+    if (size < FILE_TABLE_ENTRY_SIZE || size > DISC_FST_MAX_SIZE || offset + size > m_size)
+        return err_msg("Disc: the FST (%llu bytes at %08llX) is out of bounds", static_cast<unsigned long long>(size), static_cast<unsigned long long>(offset));
+
+    std::vector<uint8_t> fst(static_cast<size_t>(size));
+    if (!read_range(m_input, offset, fst.data(), fst.size()))
+        return err_msg("Disc: unable to read the FST");
+
+    return read_file_table(fst.data(), fst.size(), m_shift, m_size, "Disc", &m_files);
+}
+
+disc_file const *ask_disc_file(disc_image const &disc, const char *extensions, const char *kind)
+{
+    std::string container = std::string("Disc ") + disc.game_id();
+    return ask_table_file(disc.files(), extensions, kind, container.c_str());
+}
@@ -0,0 +1,84 @@
+#ifndef __DISC_IMAGE_H__
+#define __DISC_IMAGE_H__
+
+#include "idaloader.h"
+#include "file_table.h"
+#include "wii_disc.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// GameCube disc header (boot.bin), followed by bi2.bin and the apploader.
+// A Wii partition starts with the same header, with offsets and sizes >> 2.
+#define DISC_HEADER_SIZE      0x440
+#define DISC_MAGIC_OFFSET     0x1C
+#define DISC_MAGIC_GAMECUBE   0xC2339F3D
+#define DISC_TITLE_OFFSET     0x20
+#define DISC_TITLE_SIZE       0x3E0
+#define DISC_DOL_OFFSET       0x420
+#define DISC_FST_OFFSET       0x424
+#define DISC_FST_SIZE         0x428
+
+// Larger than the FST of any retail disc
+#define DISC_FST_MAX_SIZE     (16 * 1024 * 1024)
+
+// Index of a GameCube disc image (GCM/ISO) or of the data partition of a
+// Wii disc (ISO/WBFS). Opening it reads the disc header, the DOL header and
+// the FST, nothing else: the loaders read the files they need as ranges of
+// input(), so nothing has to be extracted.
+class disc_image
+{
+public:
+    disc_image();
+    ~disc_image();
+
+    disc_image(disc_image const &) = delete;
+    disc_image &operator=(disc_image const &) = delete;
+
+    // Read the disc header and the FST
+    bool open(linput_t *li);
+
+    // Where the files are read from: the image itself, or the decrypted data
+    // partition of a Wii disc
+    linput_t *input() const { return m_input; }
+
+    // Wii discs are read decrypted, their files cannot be patched in place
+    bool encrypted() const { return m_wii != nullptr; }
+
+    // Game code and maker, e.g. "GALE01"
+    const char *game_id() const { return m_game_id; }
+    const char *title() const { return m_title.c_str(); }
+
+    // The boot DOL, its size is taken from its header
+    disc_file const & dol() const { return m_dol; }
+
+    // Every file, sorted by path
+    std::vector<disc_file> const & files() const { return m_files; }
+
+    // Case insensitive, paths are relative to the FST root
+    disc_file const *find(const char *path) const { return find_file(m_files, path); }
+
+    // Files whose name ends with one of extensions (".rel;.rel.szs")
+    std::vector<disc_file const *> files(const char *extensions) const { return match_files(m_files, extensions); }
+
+private:
+    void close();
+    bool read_fst(uint64_t offset, uint64_t size);
+
+    linput_t *m_input;
+    std::unique_ptr<wii_disc> m_wii;
+    uint32_t m_shift;       // of offsets in the headers, 2 on Wii
+    char m_game_id[7];
+    std::string m_title;
+    uint64_t m_size;
+    disc_file m_dol;
+    std::vector<disc_file> m_files;
+};
+
+// Let the user pick one of the files with the given extensions, the first
+// one is offered. Returns nullptr if there is none or the dialog is cancelled.
+disc_file const *ask_disc_file(disc_image const &disc, const char *extensions, const char *kind);
+
+#endif // #ifndef __DISC_IMAGE_H__
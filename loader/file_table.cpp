@@ -0,0 +1,117 @@
+#include "file_table.h"
+#include "input_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool read_file_table(const uint8_t *table, size_t size, uint32_t shift, uint64_t limit, const char *kind, std::vector<disc_file> *files)
+{
+    files->clear();
+
+    // The root directory's size is the number of entries, the names follow
+    uint32_t count = size >= FILE_TABLE_ENTRY_SIZE ? read_be32(table + 8) : 0;
+    if (count == 0 || count > size / FILE_TABLE_ENTRY_SIZE)
+        return err_msg("%s: the file table has an invalid number of entries (%u)", kind, count);
+    const char *names = reinterpret_cast<const char *>(table + count * FILE_TABLE_ENTRY_SIZE);
+    uint32_t names_size = static_cast<uint32_t>(size) - count * FILE_TABLE_ENTRY_SIZE;
+
+    // Directories span the entries up to their next index, nested ones end
+    // before their parent
+    struct open_dir
+    {
+        uint32_t m_end;
+        size_t m_prefix;
+    };
+    std::vector<open_dir> dirs(1, open_dir{ count, 0 });
+    std::string path;
+
+    files->reserve(count);
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        while (i >= dirs.back().m_end)
+        {
+            dirs.pop_back();
+            path.resize(dirs.back().m_prefix);
+        }
+
+        const uint8_t *entry = table + i * FILE_TABLE_ENTRY_SIZE;
+        uint32_t name_offset = read_be32(entry) & 0xFFFFFF;
+        if (name_offset >= names_size || memchr(names + name_offset, 0, names_size - name_offset) == nullptr)
+            return err_msg("%s: file table entry %u has an invalid name", kind, i);
+        const char *name = names + name_offset;
+
+        if (entry[0] != 0)
+        {
+            uint32_t next = read_be32(entry + 8);
+            if (next <= i || next > dirs.back().m_end)
+                return err_msg("%s: directory %s has an invalid extent", kind, name);
+            path.append(name).append("/");
+            dirs.push_back(open_dir{ next, path.size() });
+            continue;
+        }
+
+        uint64_t file_offset = uint64_t(read_be32(entry + 4)) << shift;
+        uint32_t file_size = read_be32(entry + 8);
+        if (file_offset + file_size > limit)
+            return err_msg("%s: %s%s runs past the end of its container", kind, path.c_str(), name);
+        files->push_back(disc_file{ path + name, file_offset, file_size });
+    }
+
+    std::sort(files->begin(), files->end(), [](disc_file const &a, disc_file const &b) {
+        return stricmp(a.m_path.c_str(), b.m_path.c_str()) < 0;
+    });
+    return true;
+}
+
+disc_file const *find_file(std::vector<disc_file> const &files, const char *path)
+{
+    auto it = std::lower_bound(files.begin(), files.end(), path, [](disc_file const &file, const char *value) {
+        return stricmp(file.m_path.c_str(), value) < 0;
+    });
+    if (it == files.end() || stricmp(it->m_path.c_str(), path) != 0)
+        return nullptr;
+    return &*it;
+}
+
+bool match_extension(std::string const &path, const char *extensions)
+{
+    for (const char *ext = extensions; *ext != '\0'; )
+    {
+        const char *next = strchr(ext, ';');
+        size_t length = next != nullptr ? static_cast<size_t>(next - ext) : strlen(ext);
+        if (path.size() > length && strnicmp(path.c_str() + path.size() - length, ext, length) == 0)
+            return true;
+        ext += next != nullptr ? length + 1 : length;
+    }
+    return false;
+}
+
+std::vector<disc_file const *> match_files(std::vector<disc_file> const &files, const char *extensions)
+{
+    std::vector<disc_file const *> found;
+    for (auto const &file : files)
+    {
+        if (match_extension(file.m_path, extensions))
+            found.push_back(&file);
+    }
+    return found;
+}
+
+disc_file const *ask_table_file(std::vector<disc_file> const &files, const char *extensions, const char *kind, const char *container)
+{
+    std::vector<disc_file const *> candidates = match_files(files, extensions);
+    if (candidates.empty())
+    {
+        err_msg("%s has no %s files", container, kind);
+        return nullptr;
+    }
+
+    qstring path(candidates.front()->m_path.c_str());
+    if (!ask_str(&path, HIST_FILE, "%s to load from %s (%u in it)", kind, container, static_cast<uint32_t>(candidates.size())))
+        return nullptr;
+
+    disc_file const *file = find_file(files, path.c_str());
+    if (file == nullptr)
+        err_msg("%s is not in %s", path.c_str(), container);
+    return file;
+}
@@ -0,0 +1,40 @@
+#ifndef __FILE_TABLE_H__
+#define __FILE_TABLE_H__
+
+#include "idaloader.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Table entries, as in a disc FST or a U8 archive: flags and name offset,
+// file offset or parent, size or next. The root directory comes first, its
+// size is the number of entries, and the names follow the entries.
+#define FILE_TABLE_ENTRY_SIZE 12
+
+// A file inside a disc image or an archive, as a range of its container
+struct disc_file
+{
+    std::string m_path;     // from the root, e.g. "rels/d_a_npc.rel"
+    uint64_t m_offset;      // in the container, see disc_image::input()
+    uint32_t m_size;
+};
+
+// Read the files of a table, sorted by path. Offsets are stored shifted
+// right by shift and must end within limit. kind prefixes the errors.
+bool read_file_table(const uint8_t *table, size_t size, uint32_t shift, uint64_t limit, const char *kind, std::vector<disc_file> *files);
+
+// Case insensitive, paths are relative to the root
+disc_file const *find_file(std::vector<disc_file> const &files, const char *path);
+
+// Whether path ends with one of extensions (".rel;.rel.szs")
+bool match_extension(std::string const &path, const char *extensions);
+
+// Files whose name ends with one of extensions
+std::vector<disc_file const *> match_files(std::vector<disc_file> const &files, const char *extensions);
+
+// Let the user pick one of the files with the given extensions, the first
+// one is offered. Returns nullptr if there is none or the dialog is cancelled.
+disc_file const *ask_table_file(std::vector<disc_file> const &files, const char *extensions, const char *kind, const char *container);
+
+#endif // #ifndef __FILE_TABLE_H__
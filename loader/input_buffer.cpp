@@ -0,0 +1,135 @@
+#ifdef __NT__
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "input_buffer.h"
+
+#include <new>
+
+input_buffer::input_buffer() : m_data(nullptr), m_size(0), m_packed_size(0) { }
+
+bool input_buffer::read(linput_t *li)
+{
+    int64 file_size = qlsize(li);
+    if (file_size <= 0)
+        return false;
+    return this->read(li, 0, static_cast<uint64_t>(file_size));
+}
+
+bool input_buffer::read(linput_t *li, uint64_t offset, uint64_t range_size)
+{
+    if (range_size == 0 || range_size > SIZE_MAX)
+        return false;
+
+    size_t size = static_cast<size_t>(range_size);
+    std::shared_ptr<uint8_t> storage(new uint8_t[size], std::default_delete<uint8_t[]>());
+
+    qlseek(li, static_cast<qoff64_t>(offset), SEEK_SET);
+    if (qlread(li, storage.get(), size) != static_cast<ssize_t>(size))
+        return false;
+
+    m_data = storage.get();
+    m_size = size;
+    m_packed_size = 0;
+    m_storage = storage;
+    return true;
+}
+
+bool input_buffer::map(const char *path)
+{
+#ifdef __NT__
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER file_size;
+        HANDLE mapping = NULL;
+        if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+
+        if (mapping != NULL)
+        {
+            const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping); // the view keeps the mapping alive
+            if (view != NULL)
+            {
+                m_data = static_cast<const uint8_t *>(view);
+                m_size = static_cast<size_t>(file_size.QuadPart);
+                m_packed_size = 0;
+                m_storage.reset(m_data, [](const uint8_t *p) { UnmapViewOfFile(p); });
+                return true;
+            }
+        }
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat st;
+        void *view = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+            view = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // the mapping stays valid
+
+        if (view != MAP_FAILED)
+        {
+            size_t size = static_cast<size_t>(st.st_size);
+            m_data = static_cast<const uint8_t *>(view);
+            m_size = size;
+            m_packed_size = 0;
+            m_storage.reset(m_data, [size](const uint8_t *p) { munmap(const_cast<uint8_t *>(p), size); });
+            return true;
+        }
+    }
+#endif
+
+    // Not mappable, read it through IDA instead
+    linput_t *li = open_linput(path, false);
+    if (li == nullptr)
+        return false;
+    bool ok = read(li);
+    close_linput(li);
+    return ok;
+}
+
+input_buffer input_buffer::slice(uint64_t offset, uint64_t size) const
+{
+    input_buffer part;
+    if (!this->contains(offset, size))
+        return part;
+    part.m_storage = m_storage;
+    part.m_data = m_data + offset;
+    part.m_size = static_cast<size_t>(size);
+    return part;
+}
+
+bool input_buffer::unpack()
+{
+    uint32_t unpacked_size;
+    compression_format format = compression_detect(m_data, m_size, &unpacked_size);
+    if (format == COMPRESSION_NONE)
+        return true;
+    if (unpacked_size == 0)
+        return err_msg("%s: the input decompresses to nothing", compression_name(format));
+
+    if (unpacked_size > static_cast<uint64_t>(m_size) * COMPRESSION_MAX_RATIO)
+        return err_msg("%s: the input is damaged, it cannot decompress to %u bytes", compression_name(format), unpacked_size);
+
+    std::shared_ptr<uint8_t> storage(new (std::nothrow) uint8_t[unpacked_size], std::default_delete<uint8_t[]>());
+    if (!storage)
+        return err_msg("%s: not enough memory to decompress %u bytes", compression_name(format), unpacked_size);
+    size_t decoded = decompress(m_data, m_size, storage.get(), unpacked_size);
+    if (decoded != unpacked_size)
+        return err_msg("%s: the input is damaged, decoded %u of %u bytes", compression_name(format), static_cast<uint32_t>(decoded), unpacked_size);
+
+    m_packed_size = m_size;
+    m_data = storage.get();
+    m_size = unpacked_size;
+    m_storage = storage;
+    return true;
+}
@@ -0,0 +1,191 @@
+#ifndef __INPUT_BUFFER_H__
+#define __INPUT_BUFFER_H__
+
+#include "idaloader.h"
+#include "compression.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+inline uint16_t read_be16(const uint8_t *p)
+{
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline uint32_t read_be32(const uint8_t *p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+// 64-bit FNV-1a, chained through hash to cover several ranges
+inline uint64_t hash_bytes(const uint8_t *data, size_t size, uint64_t hash = 0xCBF29CE484222325ull)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Big endian writers for the sidecar files, the counterparts of be_cursor
+inline void put_be16(std::vector<uint8_t> &out, uint16_t value)
+{
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline void put_be32(std::vector<uint8_t> &out, uint32_t value)
+{
+    put_be16(out, static_cast<uint16_t>(value >> 16));
+    put_be16(out, static_cast<uint16_t>(value));
+}
+
+inline void put_be64(std::vector<uint8_t> &out, uint64_t value)
+{
+    put_be32(out, static_cast<uint32_t>(value >> 32));
+    put_be32(out, static_cast<uint32_t>(value));
+}
+
+// Strings are stored with a 16-bit length
+inline void put_be_str(std::vector<uint8_t> &out, std::string const &value)
+{
+    put_be16(out, static_cast<uint16_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+// Bounds-checked big endian reader over a region of an input_buffer.
+// Every read fails (returns false) instead of running past the end.
+class be_cursor
+{
+public:
+    be_cursor() : m_begin(nullptr), m_end(nullptr), m_pos(nullptr) { }
+    be_cursor(const uint8_t *begin, const uint8_t *end, const uint8_t *pos) : m_begin(begin), m_end(end), m_pos(pos) { }
+
+    bool read_u8(uint8_t *out)
+    {
+        if (remaining() < 1)
+            return false;
+        *out = *m_pos++;
+        return true;
+    }
+
+    bool read_u16(uint16_t *out)
+    {
+        if (remaining() < 2)
+            return false;
+        *out = read_be16(m_pos);
+        m_pos += 2;
+        return true;
+    }
+
+    bool read_u32(uint32_t *out)
+    {
+        if (remaining() < 4)
+            return false;
+        *out = read_be32(m_pos);
+        m_pos += 4;
+        return true;
+    }
+
+    bool read_u64(uint64_t *out)
+    {
+        uint32_t hi, lo;
+        if (!read_u32(&hi) || !read_u32(&lo))
+            return false;
+        *out = (static_cast<uint64_t>(hi) << 32) | lo;
+        return true;
+    }
+
+    // A string written by put_be_str
+    bool read_str(std::string *out)
+    {
+        uint16_t size;
+        if (!read_u16(&size) || remaining() < size)
+            return false;
+        out->assign(reinterpret_cast<const char *>(m_pos), size);
+        m_pos += size;
+        return true;
+    }
+
+    bool skip(size_t count)
+    {
+        if (remaining() < count)
+            return false;
+        m_pos += count;
+        return true;
+    }
+
+    // Bytes left before the end of the buffer
+    size_t remaining() const { return static_cast<size_t>(m_end - m_pos); }
+
+    // Offset of the cursor from the start of the buffer
+    size_t tell() const { return static_cast<size_t>(m_pos - m_begin); }
+
+    const uint8_t *ptr() const { return m_pos; }
+
+private:
+    const uint8_t *m_begin;
+    const uint8_t *m_end;
+    const uint8_t *m_pos;
+};
+
+// Contiguous, read-only copy of an input file. The bytes are either read
+// with a single qlread or memory-mapped when a path on disk is known.
+// Copies are cheap and share the same storage.
+class input_buffer
+{
+public:
+    input_buffer();
+
+    // Read the whole input in one go
+    bool read(linput_t *li);
+
+    // Read size bytes at offset, e.g. one file of a disc image
+    bool read(linput_t *li, uint64_t offset, uint64_t size);
+
+    // Map a file on disk (falls back to reading it)
+    bool map(const char *path);
+
+    // Part of the contents sharing the same storage, e.g. one file of an
+    // archive. Empty if the range is out of bounds.
+    input_buffer slice(uint64_t offset, uint64_t size) const;
+
+    // Format of the contents, see compression_detect
+    compression_format compression() const { return compression_detect(m_data, m_size); }
+
+    // Replace Yaz0/Yay0 compressed contents with the decompressed bytes.
+    // Uncompressed contents are kept as they are.
+    bool unpack();
+
+    // Size of the input before unpack(), 0 if it was not compressed
+    size_t packed_size() const { return m_packed_size; }
+
+    const uint8_t *data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    bool contains(uint64_t offset, uint64_t size) const
+    {
+        return offset <= m_size && size <= m_size - offset;
+    }
+
+    // Cursor positioned at offset, or an empty cursor if offset is out of range
+    be_cursor cursor(uint64_t offset) const
+    {
+        if (offset > m_size)
+            return be_cursor();
+        return be_cursor(m_data, m_data + m_size, m_data + offset);
+    }
+
+private:
+    std::shared_ptr<const uint8_t> m_storage;
+    const uint8_t *m_data;
+    size_t m_size;
+    size_t m_packed_size;
+};
+
+#endif // #ifndef __INPUT_BUFFER_H__
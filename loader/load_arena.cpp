@@ -0,0 +1,66 @@
+#include "load_arena.h"
+
+#include <cstdlib>
+#include <cstring>
+
+load_arena::load_arena(size_t block_size)
+    : m_pos(nullptr), m_end(nullptr), m_block_size(block_size),
+      m_allocations(0), m_bytes(0), m_reserved(0)
+{
+}
+
+load_arena::~load_arena()
+{
+    this->release();
+}
+
+uint8_t *load_arena::new_block(size_t size)
+{
+    uint8_t *block = static_cast<uint8_t *>(::operator new(size));
+    m_blocks.push_back(block);
+    m_reserved += size;
+    return block;
+}
+
+void *load_arena::allocate(size_t size, size_t align)
+{
+    ++m_allocations;
+    m_bytes += size;
+
+    uintptr_t pos = (reinterpret_cast<uintptr_t>(m_pos) + align - 1) & ~static_cast<uintptr_t>(align - 1);
+    if ( m_pos != nullptr && pos + size <= reinterpret_cast<uintptr_t>(m_end) )
+    {
+        m_pos = reinterpret_cast<uint8_t *>(pos + size);
+        return reinterpret_cast<void *>(pos);
+    }
+
+    // Large requests get a block of their own, the current one stays open
+    if ( size + align > m_block_size / 4 )
+    {
+        uint8_t *block = this->new_block(size + align);
+        return reinterpret_cast<void *>((reinterpret_cast<uintptr_t>(block) + align - 1) & ~static_cast<uintptr_t>(align - 1));
+    }
+
+    uint8_t *block = this->new_block(m_block_size);
+    m_end = block + m_block_size;
+    pos = (reinterpret_cast<uintptr_t>(block) + align - 1) & ~static_cast<uintptr_t>(align - 1);
+    m_pos = reinterpret_cast<uint8_t *>(pos + size);
+    return reinterpret_cast<void *>(pos);
+}
+
+const char *load_arena::copy(const char *text, size_t length)
+{
+    char *result = static_cast<char *>(this->allocate(length + 1, 1));
+    memcpy(result, text, length);
+    result[length] = '\0';
+    return result;
+}
+
+void load_arena::release()
+{
+    for ( uint8_t *block : m_blocks )
+        ::operator delete(block);
+    m_blocks.clear();
+    m_pos = nullptr;
+    m_end = nullptr;
+}
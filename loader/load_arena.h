@@ -0,0 +1,82 @@
+#ifndef __LOAD_ARENA_H__
+#define __LOAD_ARENA_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// Monotonic allocator for the transient state of one load. Memory is handed
+// out from large blocks and never freed piecemeal; everything goes at once
+// when the arena is released or destroyed at the end of load_file. Not
+// thread safe, workers use the heap.
+class load_arena
+{
+public:
+    explicit load_arena(size_t block_size = 64 * 1024);
+    ~load_arena();
+
+    void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+    // Zero terminated copy that lives as long as the arena
+    const char *copy(const char *text, size_t length);
+
+    void release();
+
+    uint64_t allocations() const { return m_allocations; }
+    uint64_t bytes() const { return m_bytes; }          // handed out
+    uint64_t reserved() const { return m_reserved; }    // taken from the heap
+    size_t blocks() const { return m_blocks.size(); }
+
+private:
+    load_arena(load_arena const &) = delete;
+    load_arena & operator=(load_arena const &) = delete;
+
+    uint8_t *new_block(size_t size);
+
+    std::vector<uint8_t *> m_blocks;
+    uint8_t *m_pos;
+    uint8_t *m_end;
+    size_t m_block_size;
+    uint64_t m_allocations;
+    uint64_t m_bytes;
+    uint64_t m_reserved;
+};
+
+// Standard allocator on top of a load_arena. Without an arena it uses the
+// heap, so containers filled on worker threads can have the same types.
+template <class T>
+class arena_allocator
+{
+public:
+    typedef T value_type;
+
+    arena_allocator(load_arena *arena = nullptr) : m_arena(arena) { }
+    template <class U> arena_allocator(arena_allocator<U> const &other) : m_arena(other.arena()) { }
+
+    T *allocate(size_t count)
+    {
+        if ( m_arena != nullptr )
+            return static_cast<T *>(m_arena->allocate(count * sizeof(T), alignof(T)));
+        return static_cast<T *>(::operator new(count * sizeof(T)));
+    }
+
+    void deallocate(T *ptr, size_t)
+    {
+        if ( m_arena == nullptr )
+            ::operator delete(ptr);
+    }
+
+    load_arena *arena() const { return m_arena; }
+
+    template <class U> bool operator==(arena_allocator<U> const &other) const { return m_arena == other.arena(); }
+    template <class U> bool operator!=(arena_allocator<U> const &other) const { return m_arena != other.arena(); }
+
+private:
+    load_arena *m_arena;
+};
+
+template <class T>
+using arena_vector = std::vector<T, arena_allocator<T> >;
+
+#endif // #ifndef __LOAD_ARENA_H__
@@ -0,0 +1,28 @@
+#ifdef __NT__
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "load_phases.h"
+
+double process_cpu_ms()
+{
+#ifdef __NT__
+    // clock() is wall time with the Microsoft CRT
+    FILETIME creation, exit, kernel, user;
+    if ( !GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user) )
+        return 0.0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return static_cast<double>(k.QuadPart + u.QuadPart) / 10000.0;   // 100 ns units
+#else
+    timespec ts;
+    if ( clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0 )
+        return 0.0;
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#endif
+}
@@ -0,0 +1,116 @@
+#ifndef __LOAD_PHASES_H__
+#define __LOAD_PHASES_H__
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Time and database calls spent in one named phase of a load
+struct load_phase
+{
+    const char *m_name;
+    unsigned m_depth;     // number of phases this one is nested in
+    double m_wall_ms;
+    double m_cpu_ms;      // process CPU time, worker threads included
+    uint64_t m_db_calls;
+    uint64_t m_peak_bytes; // peak heap growth, only measured with a memory probe
+    uint64_t m_allocations; // heap allocations, only counted with a memory probe
+};
+
+// CPU time of the whole process so far in ms, worker threads included
+double process_cpu_ms();
+
+// Optional peak memory probe for every phase. Nothing installs one inside
+// IDA; the headless driver backs it with its allocation counters. Phases
+// nest, so begin and end always pair up in LIFO order.
+struct load_memory_probe
+{
+    void (*m_begin)();
+    uint64_t (*m_end)();  // peak bytes above the live size at the matching begin
+    uint64_t (*m_allocations)();   // running allocation count
+};
+
+inline load_memory_probe const *& load_memory_probe_instance()
+{
+    static load_memory_probe const *probe = nullptr;
+    return probe;
+}
+
+// Ordered list of the phases a loader went through. Phases may nest, the
+// outermost ones (depth 0) add up to the whole load. Database calls are
+// counted by the loader through count_db() and attributed to every phase
+// that is open at the time.
+class load_phases
+{
+public:
+    load_phases() : m_open(0), m_db_calls(0) { }
+
+    void clear()
+    {
+        m_phases.clear();
+        m_starts.clear();
+        m_open = 0;
+        m_db_calls = 0;
+    }
+
+    size_t begin(const char *name)
+    {
+        m_phases.push_back(load_phase{ name, m_open++, 0.0, 0.0, m_db_calls, 0, 0 });
+        m_starts.push_back(start{ std::chrono::steady_clock::now(), process_cpu_ms() });
+        if ( load_memory_probe_instance() != nullptr )
+        {
+            load_memory_probe_instance()->m_begin();
+            m_phases.back().m_allocations = load_memory_probe_instance()->m_allocations();
+        }
+        return m_phases.size() - 1;
+    }
+
+    void end(size_t index)
+    {
+        load_phase &phase = m_phases[index];
+        phase.m_wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_starts[index].m_wall).count();
+        phase.m_cpu_ms = process_cpu_ms() - m_starts[index].m_cpu_ms;
+        phase.m_db_calls = m_db_calls - phase.m_db_calls;
+        if ( load_memory_probe_instance() != nullptr )
+        {
+            phase.m_peak_bytes = load_memory_probe_instance()->m_end();
+            phase.m_allocations = load_memory_probe_instance()->m_allocations() - phase.m_allocations;
+        }
+        --m_open;
+    }
+
+    void count_db(uint64_t calls = 1) { m_db_calls += calls; }
+    uint64_t db_calls() const { return m_db_calls; }
+
+    std::vector<load_phase> const & phases() const { return m_phases; }
+
+private:
+    struct start
+    {
+        std::chrono::steady_clock::time_point m_wall;
+        double m_cpu_ms;
+    };
+
+    std::vector<load_phase> m_phases;
+    std::vector<start> m_starts;
+    unsigned m_open;
+    uint64_t m_db_calls;
+};
+
+// Times the enclosing scope as one phase
+class load_phase_scope
+{
+public:
+    load_phase_scope(load_phases &phases, const char *name) : m_phases(phases), m_index(phases.begin(name)) { }
+    ~load_phase_scope() { m_phases.end(m_index); }
+
+private:
+    load_phase_scope(load_phase_scope const &) = delete;
+    load_phase_scope & operator=(load_phase_scope const &) = delete;
+
+    load_phases &m_phases;
+    size_t m_index;
+};
+
+#endif // #ifndef __LOAD_PHASES_H__
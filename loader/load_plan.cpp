@@ -0,0 +1,317 @@
+#include "load_plan.h"
+
+#include <cstring>
+
+bool load_target::extra_cmt(ea_t ea, bool isprev, const char *format, ...)
+{
+    char text[MAXSTR];
+    va_list va;
+    va_start(va, format);
+    qvsnprintf(text, sizeof(text), format, va);
+    va_end(va);
+    return this->add_extra(ea, isprev, false, text);
+}
+
+bool load_target::extra_line(ea_t ea, bool isprev, const char *format, ...)
+{
+    char text[MAXSTR];
+    va_list va;
+    va_start(va, format);
+    qvsnprintf(text, sizeof(text), format, va);
+    va_end(va);
+    return this->add_extra(ea, isprev, true, text);
+}
+
+void load_target::program_cmt(const char *format, ...)
+{
+    char text[MAXSTR];
+    va_list va;
+    va_start(va, format);
+    qvsnprintf(text, sizeof(text), format, va);
+    va_end(va);
+    this->add_program_cmt(text);
+}
+
+//--------------------------------------------------------------------------
+bool database_target::add_segment(ea_t start, ea_t end, const char *name, const char *sclass)
+{
+    if ( !add_segm(1, start, end, name, sclass) )
+        return false;
+    set_segm_addressing(getseg(start), 1);
+    return true;
+}
+
+bool database_target::load_bytes(ea_t start, const uint8_t *bytes, uint32_t size, uint32_t file_offset)
+{
+    return mem2base(bytes, start, start + size, file_offset) != 0;
+}
+
+bool database_target::patch_bytes(ea_t start, const uint8_t *bytes, uint32_t size, bool keep_original)
+{
+    if ( keep_original )
+        ::patch_bytes(start, bytes, size);
+    else
+        ::put_bytes(start, bytes, size);
+    return true;
+}
+
+bool database_target::set_name(ea_t ea, const char *name, int flags)
+{
+    return ::set_name(ea, name, flags);
+}
+
+bool database_target::add_func(ea_t start, ea_t end)
+{
+    return ::add_func(start, end);
+}
+
+bool database_target::add_entry(ea_t ea, const char *name)
+{
+    return ::add_entry(ea, ea, name, true);
+}
+
+bool database_target::set_libitem(ea_t ea)
+{
+    return ::set_libitem(ea);
+}
+
+bool database_target::add_extra(ea_t ea, bool isprev, bool line, const char *text)
+{
+    if ( line )
+        return add_extra_line(ea, isprev, "%s", text);
+    return add_extra_cmt(ea, isprev, "%s", text);
+}
+
+void database_target::add_program_cmt(const char *text)
+{
+    add_pgm_cmt("%s", text);
+}
+
+//--------------------------------------------------------------------------
+load_plan::load_plan()
+{
+    this->clear();
+}
+
+void load_plan::clear()
+{
+    m_ops.clear();
+    m_text.assign(1, '\0');     // offset 0 is the empty string
+    m_bytes.clear();
+}
+
+plan_op & load_plan::add(plan_op_kind kind, ea_t start)
+{
+    m_ops.push_back(plan_op{ kind, start, BADADDR, 0, false, false, 0, 0, 0, 0 });
+    return m_ops.back();
+}
+
+uint32_t load_plan::add_text(const char *text)
+{
+    if ( text == nullptr || *text == '\0' )
+        return 0;
+    uint32_t offset = static_cast<uint32_t>(m_text.size());
+    m_text.insert(m_text.end(), text, text + strlen(text) + 1);
+    return offset;
+}
+
+uint32_t load_plan::add_bytes(const uint8_t *bytes, uint32_t size)
+{
+    uint32_t offset = static_cast<uint32_t>(m_bytes.size());
+    m_bytes.insert(m_bytes.end(), bytes, bytes + size);
+    return offset;
+}
+
+bool load_plan::add_segment(ea_t start, ea_t end, const char *name, const char *sclass)
+{
+    plan_op &op = this->add(PLAN_SEGMENT, start);
+    op.m_end = end;
+    op.m_text = this->add_text(name);
+    op.m_class = this->add_text(sclass);
+    return true;
+}
+
+bool load_plan::load_bytes(ea_t start, const uint8_t *bytes, uint32_t size, uint32_t file_offset)
+{
+    uint32_t offset = this->add_bytes(bytes, size);
+    plan_op &op = this->add(PLAN_LOAD, start);
+    op.m_value = file_offset;
+    op.m_bytes = offset;
+    op.m_size = size;
+    return true;
+}
+
+bool load_plan::patch_bytes(ea_t start, const uint8_t *bytes, uint32_t size, bool keep_original)
+{
+    uint32_t offset = this->add_bytes(bytes, size);
+    plan_op &op = this->add(PLAN_PATCH, start);
+    op.m_flag = keep_original;
+    op.m_bytes = offset;
+    op.m_size = size;
+    return true;
+}
+
+bool load_plan::set_name(ea_t ea, const char *name, int flags)
+{
+    uint32_t text = this->add_text(name);
+    plan_op &op = this->add(PLAN_NAME, ea);
+    op.m_value = static_cast<uint32_t>(flags);
+    op.m_text = text;
+    return true;
+}
+
+bool load_plan::add_func(ea_t start, ea_t end)
+{
+    this->add(PLAN_FUNC, start).m_end = end;
+    return true;
+}
+
+bool load_plan::add_entry(ea_t ea, const char *name)
+{
+    uint32_t text = this->add_text(name);
+    this->add(PLAN_ENTRY, ea).m_text = text;
+    return true;
+}
+
+bool load_plan::set_libitem(ea_t ea)
+{
+    this->add(PLAN_LIBITEM, ea);
+    return true;
+}
+
+bool load_plan::add_extra(ea_t ea, bool isprev, bool line, const char *text)
+{
+    uint32_t offset = this->add_text(text);
+    plan_op &op = this->add(PLAN_EXTRA, ea);
+    op.m_flag = isprev;
+    op.m_line = line;
+    op.m_text = offset;
+    return true;
+}
+
+void load_plan::add_program_cmt(const char *text)
+{
+    uint32_t offset = this->add_text(text);
+    this->add(PLAN_PROGRAM_CMT, BADADDR).m_text = offset;
+}
+
+size_t load_plan::count(plan_op_kind kind) const
+{
+    size_t count = 0;
+    for ( auto const &op : m_ops )
+        count += op.m_kind == kind;
+    return count;
+}
+
+bool load_plan::apply(load_target &target) const
+{
+    for ( auto const &op : m_ops )
+    {
+        bool ok = true;
+        switch ( op.m_kind )
+        {
+        case PLAN_SEGMENT:
+            ok = target.add_segment(op.m_start, op.m_end, this->text(op), this->sclass(op));
+            break;
+        case PLAN_LOAD:
+            ok = target.load_bytes(op.m_start, this->bytes(op), op.m_size, op.m_value);
+            break;
+        case PLAN_PATCH:
+            ok = target.patch_bytes(op.m_start, this->bytes(op), op.m_size, op.m_flag);
+            break;
+        case PLAN_NAME:
+            // A name that is refused is reported by the loader, not fatal
+            target.set_name(op.m_start, this->text(op), static_cast<int>(op.m_value));
+            break;
+        case PLAN_FUNC:
+            target.add_func(op.m_start, op.m_end);
+            break;
+        case PLAN_ENTRY:
+            ok = target.add_entry(op.m_start, this->text(op));
+            break;
+        case PLAN_LIBITEM:
+            target.set_libitem(op.m_start);
+            break;
+        case PLAN_EXTRA:
+            target.add_extra(op.m_start, op.m_flag, op.m_line, this->text(op));
+            break;
+        case PLAN_PROGRAM_CMT:
+            target.add_program_cmt(this->text(op));
+            break;
+        }
+        if ( !ok )
+            return err_msg("Applying the load plan failed at %08X", op.m_start);
+    }
+    return true;
+}
+
+// Rest of a line, with the line breaks of multi-line comments escaped
+static void write_text(FILE *fp, const char *text)
+{
+    for ( ; *text != '\0'; ++text )
+    {
+        if ( *text == '\n' )
+            qfprintf(fp, "\\n");
+        else
+            qfprintf(fp, "%c", *text);
+    }
+    qfprintf(fp, "\n");
+}
+
+void load_plan::write(FILE *fp) const
+{
+    for ( auto const &op : m_ops )
+    {
+        switch ( op.m_kind )
+        {
+        case PLAN_SEGMENT:
+            qfprintf(fp, "segment %08X %08X %s %s\n", op.m_start, op.m_end, this->text(op), this->sclass(op));
+            break;
+        case PLAN_LOAD:
+        {
+            // File bytes are identified by their hash, they are not computed
+            uint32_t hash = 2166136261u;
+            const uint8_t *p = this->bytes(op);
+            for ( uint32_t i = 0; i < op.m_size; ++i )
+                hash = (hash ^ p[i]) * 16777619u;
+            qfprintf(fp, "load %08X %08X from %08X fnv %08X\n", op.m_start, op.m_size, op.m_value, hash);
+            break;
+        }
+        case PLAN_PATCH:
+        {
+            qfprintf(fp, "%s %08X %08X\n", op.m_flag ? "patch" : "put", op.m_start, op.m_size);
+            const uint8_t *p = this->bytes(op);
+            for ( uint32_t i = 0; i < op.m_size; i += 16 )
+            {
+                qfprintf(fp, "  %08X", op.m_start + i);
+                for ( uint32_t j = i; j < op.m_size && j < i + 16; ++j )
+                    qfprintf(fp, (j & 3) == 0 ? " %02X" : "%02X", p[j]);
+                qfprintf(fp, "\n");
+            }
+            break;
+        }
+        case PLAN_NAME:
+            qfprintf(fp, "name %08X ", op.m_start);
+            write_text(fp, this->text(op));
+            break;
+        case PLAN_FUNC:
+            qfprintf(fp, "func %08X %08X\n", op.m_start, op.m_end);
+            break;
+        case PLAN_ENTRY:
+            qfprintf(fp, "entry %08X ", op.m_start);
+            write_text(fp, this->text(op));
+            break;
+        case PLAN_LIBITEM:
+            qfprintf(fp, "libitem %08X\n", op.m_start);
+            break;
+        case PLAN_EXTRA:
+            qfprintf(fp, "%s %08X%s ", op.m_line ? "line" : "cmt", op.m_start, op.m_flag ? " prev" : "");
+            write_text(fp, this->text(op));
+            break;
+        case PLAN_PROGRAM_CMT:
+            qfprintf(fp, "program ");
+            write_text(fp, this->text(op));
+            break;
+        }
+    }
+}
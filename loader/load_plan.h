@@ -0,0 +1,128 @@
+#ifndef __LOAD_PLAN_H__
+#define __LOAD_PLAN_H__
+
+#include "idaloader.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Everything a loader does to the database goes through a load_target, so a
+// load can be issued directly or recorded into a plan instead.
+class load_target
+{
+public:
+    virtual ~load_target() { }
+
+    // Segment with 32-bit addressing
+    virtual bool add_segment(ea_t start, ea_t end, const char *name, const char *sclass) = 0;
+
+    // File bytes loaded into a segment
+    virtual bool load_bytes(ea_t start, const uint8_t *bytes, uint32_t size, uint32_t file_offset) = 0;
+
+    // Patched bytes; without keep_original the bytes become the original ones
+    virtual bool patch_bytes(ea_t start, const uint8_t *bytes, uint32_t size, bool keep_original) = 0;
+
+    virtual bool set_name(ea_t ea, const char *name, int flags) = 0;
+    virtual bool add_func(ea_t start, ea_t end) = 0;
+    virtual bool add_entry(ea_t ea, const char *name) = 0;
+    virtual bool set_libitem(ea_t ea) = 0;
+    virtual bool add_extra(ea_t ea, bool isprev, bool line, const char *text) = 0;
+    virtual void add_program_cmt(const char *text) = 0;
+
+    // printf style front ends of the comment calls
+    bool extra_cmt(ea_t ea, bool isprev, const char *format, ...);
+    bool extra_line(ea_t ea, bool isprev, const char *format, ...);
+    void program_cmt(const char *format, ...);
+};
+
+// Issues every call to the open database
+class database_target : public load_target
+{
+public:
+    bool add_segment(ea_t start, ea_t end, const char *name, const char *sclass) override;
+    bool load_bytes(ea_t start, const uint8_t *bytes, uint32_t size, uint32_t file_offset) override;
+    bool patch_bytes(ea_t start, const uint8_t *bytes, uint32_t size, bool keep_original) override;
+    bool set_name(ea_t ea, const char *name, int flags) override;
+    bool add_func(ea_t start, ea_t end) override;
+    bool add_entry(ea_t ea, const char *name) override;
+    bool set_libitem(ea_t ea) override;
+    bool add_extra(ea_t ea, bool isprev, bool line, const char *text) override;
+    void add_program_cmt(const char *text) override;
+};
+
+enum plan_op_kind
+{
+    PLAN_SEGMENT,
+    PLAN_LOAD,
+    PLAN_PATCH,
+    PLAN_NAME,
+    PLAN_FUNC,
+    PLAN_ENTRY,
+    PLAN_LIBITEM,
+    PLAN_EXTRA,
+    PLAN_PROGRAM_CMT,
+};
+
+// One recorded call. Text and bytes are kept in the plan's pools so the
+// plan outlives the input and the loader state it was computed from.
+struct plan_op
+{
+    plan_op_kind m_kind;
+    ea_t m_start;
+    ea_t m_end;          // segment and function end
+    uint32_t m_value;    // load file offset, name flags
+    bool m_flag;         // patch keeps the original bytes, comment is a previous one
+    bool m_line;         // extra line rather than comment
+    uint32_t m_text;     // offset into the text pool, or the segment name
+    uint32_t m_class;    // segment class in the text pool
+    uint32_t m_bytes;    // offset into the byte pool
+    uint32_t m_size;
+};
+
+// The database calls of a load in the order they were made, without any
+// of them reaching the database. Applying the plan to a database_target
+// gives the same database as loading directly; written out as text it can
+// be diffed between loader versions.
+class load_plan : public load_target
+{
+public:
+    load_plan();
+
+    void clear();
+
+    bool add_segment(ea_t start, ea_t end, const char *name, const char *sclass) override;
+    bool load_bytes(ea_t start, const uint8_t *bytes, uint32_t size, uint32_t file_offset) override;
+    bool patch_bytes(ea_t start, const uint8_t *bytes, uint32_t size, bool keep_original) override;
+    bool set_name(ea_t ea, const char *name, int flags) override;
+    bool add_func(ea_t start, ea_t end) override;
+    bool add_entry(ea_t ea, const char *name) override;
+    bool set_libitem(ea_t ea) override;
+    bool add_extra(ea_t ea, bool isprev, bool line, const char *text) override;
+    void add_program_cmt(const char *text) override;
+
+    std::vector<plan_op> const & ops() const { return m_ops; }
+    const char *text(plan_op const &op) const { return &m_text[op.m_text]; }
+    const char *sclass(plan_op const &op) const { return &m_text[op.m_class]; }
+    const uint8_t *bytes(plan_op const &op) const { return m_bytes.data() + op.m_bytes; }
+
+    // Number of recorded calls of one kind
+    size_t count(plan_op_kind kind) const;
+
+    // Replay every call in order, stops at the first one that fails
+    bool apply(load_target &target) const;
+
+    // One line per call, patched bytes as hex dwords with their address
+    void write(FILE *fp) const;
+
+private:
+    plan_op & add(plan_op_kind kind, ea_t start);
+    uint32_t add_text(const char *text);
+    uint32_t add_bytes(const uint8_t *bytes, uint32_t size);
+
+    std::vector<plan_op> m_ops;
+    std::vector<char> m_text;
+    std::vector<uint8_t> m_bytes;
+};
+
+#endif // #ifndef __LOAD_PLAN_H__
@@ -0,0 +1,182 @@
+#include "probe.h"
+#include "compression.h"
+#include "input_buffer.h"
+#include "disc_image.h"
+#include "u8_archive.h"
+#include "../rel/rel.h"
+#include "../dol/dol.h"
+#include "../apploader/apploader.h"
+
+size_t probe_read(linput_t *li, uint8_t *block)
+{
+    qlseek(li, 0, SEEK_SET);
+    ssize_t count = qlread(li, block, PROBE_BLOCK_SIZE);
+    return count < 0 ? 0 : static_cast<size_t>(count);
+}
+
+size_t probe_unpack(linput_t *li, const uint8_t *block, size_t size, uint8_t *unpacked, uint64_t *unpacked_size)
+{
+    uint32_t file_size;
+    compression_format format = compression_detect(block, size, &file_size);
+    if (format == COMPRESSION_NONE)
+        return 0;
+
+    size_t wanted = file_size < PROBE_UNPACK_SIZE ? file_size : PROBE_UNPACK_SIZE;
+    size_t decoded = 0;
+    if (format == COMPRESSION_YAZ0)
+    {
+        // A literal costs 9 bits, so this covers the worst case
+        uint8_t packed[COMPRESSION_HEADER_SIZE + PROBE_UNPACK_SIZE * 9 / 8 + 3];
+        qlseek(li, 0, SEEK_SET);
+        ssize_t count = qlread(li, packed, sizeof(packed));
+        if (count <= COMPRESSION_HEADER_SIZE)
+            return 0;
+        decoded = decompress(packed, static_cast<size_t>(count), unpacked, wanted);
+    }
+    else
+    {
+        // Each stream is read up to what the first bytes can take from it
+        uint8_t flags[PROBE_UNPACK_SIZE / 8 + 4];
+        uint8_t links[PROBE_UNPACK_SIZE / 3 * 2 + 2];
+        uint8_t chunks[PROBE_UNPACK_SIZE];
+        uint32_t links_offset = read_be32(block + 8);
+        uint32_t chunks_offset = read_be32(block + 12);
+        if (links_offset < COMPRESSION_HEADER_SIZE || chunks_offset < links_offset)
+            return 0;
+
+        auto fetch = [&](uint32_t offset, uint32_t end, uint8_t *buffer, size_t buffer_size) -> size_t {
+            size_t length = end - offset < buffer_size ? end - offset : buffer_size;
+            qlseek(li, offset, SEEK_SET);
+            ssize_t count = qlread(li, buffer, length);
+            return count < 0 ? 0 : static_cast<size_t>(count);
+        };
+        size_t flags_size = fetch(COMPRESSION_HEADER_SIZE, links_offset, flags, sizeof(flags));
+        size_t links_size = fetch(links_offset, chunks_offset, links, sizeof(links));
+        size_t chunks_size = fetch(chunks_offset, UINT32_MAX, chunks, sizeof(chunks));
+        decoded = yay0_decode(flags, flags_size, links, links_size, chunks, chunks_size, unpacked, wanted);
+    }
+
+    if (decoded != wanted)
+        return 0;
+    *unpacked_size = file_size;
+    return decoded;
+}
+
+bool probe_rel(linput_t *li, const uint8_t *block, size_t size, uint64_t file_size)
+{
+    if (size < relhdr_view::header_size(1))
+        return false;
+
+    relhdr_view hdr(block);
+    uint32_t num_sections   = hdr.num_sections();
+    uint32_t section_offset = hdr.section_offset();
+    uint32_t version        = hdr.version();
+    uint32_t bss_size       = hdr.bss_size();
+
+    if (num_sections > 32 || num_sections <= 1)
+        return false;
+    if (version == 0 || version > 3)
+        return false;
+
+    uint32_t header_size = relhdr_view::header_size(version);
+    if (size < header_size)
+        return false;
+
+    auto in_bounds = [&](uint32_t offset, uint32_t length) {
+        offset = SECTION_OFF(offset);
+        return header_size <= offset && uint64_t(offset) + length <= file_size;
+    };
+
+    uint32_t table_size = num_sections * sizeof(section_entry);
+    if (!in_bounds(section_offset, table_size))
+        return false;
+
+    // The section table usually follows the header, otherwise fetch it
+    uint8_t table_block[32 * sizeof(section_entry)];
+    const uint8_t *table = block + section_offset;
+    if (uint64_t(section_offset) + table_size > size)
+    {
+        if (li == nullptr)
+            return false;
+        qlseek(li, section_offset, SEEK_SET);
+        if (qlread(li, table_block, table_size) != static_cast<ssize_t>(table_size))
+            return false;
+        table = table_block;
+    }
+
+    for (uint32_t i = 0; i < num_sections; ++i)
+    {
+        section_entry_view entry(table + i * sizeof(section_entry));
+        if (entry.file_offset() == 0 && entry.size() != 0 && entry.size() != bss_size)
+            return false;
+        if (entry.file_offset() != 0 && entry.size() != 0 && !in_bounds(entry.file_offset(), entry.size()))
+            return false;
+    }
+    return true;
+}
+
+bool probe_dol(const uint8_t *block, size_t size, uint64_t file_size)
+{
+    if (size < 0x100 || file_size < 0x100)
+        return false;
+
+    dolhdr_view hdr(block);
+    bool entry_in_text = false;
+
+    for (size_t i = 0; i < 7; i++)
+    {
+        if (hdr.offsetText(i) != 0 && hdr.offsetText(i) < 0x100)
+            return false;
+        if (uint64_t(hdr.offsetText(i)) + hdr.sizeText(i) > file_size)
+            return false;
+        if (hdr.addressText(i) != 0 && !(hdr.addressText(i) & 0x80000000))
+            return false;
+
+        if (hdr.entrypoint() >= hdr.addressText(i) && hdr.entrypoint() < hdr.addressText(i) + hdr.sizeText(i))
+            entry_in_text = true;
+    }
+
+    for (size_t i = 0; i < 11; i++)
+    {
+        if (hdr.offsetData(i) != 0 && hdr.offsetData(i) < 0x100)
+            return false;
+        if (uint64_t(hdr.offsetData(i)) + hdr.sizeData(i) > file_size)
+            return false;
+        if (hdr.addressData(i) != 0 && !(hdr.addressData(i) & 0x80000000))
+            return false;
+    }
+
+    if (hdr.addressBSS() != 0 && !(hdr.addressBSS() & 0x80000000))
+        return false;
+
+    return entry_in_text;
+}
+
+bool probe_apploader(const uint8_t *block, size_t size, uint64_t file_size)
+{
+    if (size < sizeof(apploader_header) || file_size <= sizeof(apploader_header))
+        return false;
+
+    apploader_header_view hdr(block);
+    if (uint64_t(uint32_t(hdr.size())) + uint32_t(hdr.trailerSize()) + sizeof(apploader_header) > file_size)
+        return false;
+
+    return hdr.entryPoint() >= 0x81200000 && hdr.entryPoint() < 0x81800000;
+}
+
+bool probe_disc(const uint8_t *block, size_t size, uint64_t file_size)
+{
+    if (size < DISC_MAGIC_OFFSET + 4 || file_size < DISC_HEADER_SIZE)
+        return false;
+    return read_be32(block + DISC_MAGIC_OFFSET) == DISC_MAGIC_GAMECUBE ||
+           read_be32(block + WII_MAGIC_OFFSET) == WII_MAGIC || read_be32(block) == WBFS_MAGIC;
+}
+
+bool probe_archive(const uint8_t *block, size_t size, uint64_t file_size)
+{
+    if (size < U8_HEADER_SIZE || read_be32(block) != U8_MAGIC)
+        return false;
+    uint32_t root = read_be32(block + U8_ROOT_OFFSET);
+    uint32_t table_size = read_be32(block + U8_TABLE_SIZE);
+    return root >= U8_HEADER_SIZE && table_size >= FILE_TABLE_ENTRY_SIZE && uint64_t(root) + table_size <= file_size;
+}
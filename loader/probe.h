@@ -0,0 +1,40 @@
+#ifndef __PROBE_H__
+#define __PROBE_H__
+
+#include "idaloader.h"
+
+#include <cstdint>
+
+// Size of the header block read by the probes
+#define PROBE_BLOCK_SIZE 0x100
+
+// Bytes of a compressed input decoded for the probes, enough for a DOL
+// header or a REL header with a full section table
+#define PROBE_UNPACK_SIZE 0x200
+
+// Cheap format checks used by accept_file. They read at most a couple of
+// fixed-size blocks into stack buffers, never allocate and never log, so
+// that full parsing (and its diagnostics) is only done by load_file.
+
+// Read the first PROBE_BLOCK_SIZE bytes of the input, returns the byte count
+size_t probe_read(linput_t *li, uint8_t *block);
+
+// Decode the start of a Yaz0/Yay0 compressed input into unpacked. Returns
+// the number of bytes decoded and the decompressed size of the whole file,
+// or 0 if the input is not compressed or damaged. Only the compressed bytes
+// needed for the first PROBE_UNPACK_SIZE bytes are read.
+size_t probe_unpack(linput_t *li, const uint8_t *block, size_t size, uint8_t *unpacked, uint64_t *unpacked_size);
+
+// Without li the section table has to be in the block
+bool probe_rel(linput_t *li, const uint8_t *block, size_t size, uint64_t file_size);
+bool probe_dol(const uint8_t *block, size_t size, uint64_t file_size);
+bool probe_apploader(const uint8_t *block, size_t size, uint64_t file_size);
+
+// GameCube or Wii disc image (ISO or WBFS), only the magic is checked (see
+// disc_image)
+bool probe_disc(const uint8_t *block, size_t size, uint64_t file_size);
+
+// U8 archive, the magic and the bounds of the node table (see u8_archive)
+bool probe_archive(const uint8_t *block, size_t size, uint64_t file_size);
+
+#endif // #ifndef __PROBE_H__
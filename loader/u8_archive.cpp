@@ -0,0 +1,27 @@
+#include "u8_archive.h"
+
+bool u8_archive::open(input_buffer const &buffer, const char *name)
+{
+    m_name = name;
+    m_files.clear();
+    m_buffer = buffer;
+    if (m_buffer.compression() != COMPRESSION_NONE && !m_buffer.unpack())
+        return false;
+
+    const uint8_t *data = m_buffer.data();
+    if (m_buffer.size() < U8_HEADER_SIZE || read_be32(data) != U8_MAGIC)
+        return err_msg("U8: %s is not a U8 archive", name);
+
+    uint32_t root = read_be32(data + U8_ROOT_OFFSET);
+    uint32_t size = read_be32(data + U8_TABLE_SIZE);
+    if (root < U8_HEADER_SIZE || !m_buffer.contains(root, size))
+        return err_msg("U8: the node table of %s is out of bounds", name);
+
+    return read_file_table(data + root, size, 0, m_buffer.size(), "U8", &m_files);
+}
+
+disc_file const *ask_archive_file(u8_archive const &archive, const char *extensions, const char *kind)
+{
+    std::string container = std::string("Archive ") + archive.name();
+    return ask_table_file(archive.files(), extensions, kind, container.c_str());
+}
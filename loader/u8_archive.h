@@ -0,0 +1,55 @@
+#ifndef __U8_ARCHIVE_H__
+#define __U8_ARCHIVE_H__
+
+#include "idaloader.h"
+#include "file_table.h"
+#include "input_buffer.h"
+
+#include <cstdint>
+#include <vector>
+
+// U8 header: magic, offset of the root node, size of the nodes and names,
+// offset of the file data. Node tables use the FST layout, file offsets are
+// from the start of the archive.
+#define U8_MAGIC          0x55AA382D
+#define U8_HEADER_SIZE    0x20
+#define U8_ROOT_OFFSET    0x04
+#define U8_TABLE_SIZE     0x08
+
+// Archives are commonly Yaz0 compressed (.arc.szs, .szs)
+#define U8_EXTENSIONS     ".arc;.arc.szs;.szs"
+
+// Index of a U8 archive (.arc), kept in memory unpacked. The node table is
+// parsed once into a sorted list of files; a file is handed out as a slice
+// of the archive's buffer, nothing is copied or written to disk.
+class u8_archive
+{
+public:
+    // Parse the node table of an archive, decompressing it first if needed
+    bool open(input_buffer const &buffer, const char *name);
+
+    const char *name() const { return m_name.c_str(); }
+
+    // Every file, sorted by path
+    std::vector<disc_file> const & files() const { return m_files; }
+
+    // Case insensitive, paths are relative to the archive root
+    disc_file const *find(const char *path) const { return find_file(m_files, path); }
+
+    // Files whose name ends with one of extensions (".rel;.rel.szs")
+    std::vector<disc_file const *> files(const char *extensions) const { return match_files(m_files, extensions); }
+
+    // Contents of a file, sharing the archive's storage
+    input_buffer contents(disc_file const &file) const { return m_buffer.slice(file.m_offset, file.m_size); }
+
+private:
+    std::string m_name;
+    input_buffer m_buffer;
+    std::vector<disc_file> m_files;
+};
+
+// Let the user pick one of the files with the given extensions, the first
+// one is offered. Returns nullptr if there is none or the dialog is cancelled.
+disc_file const *ask_archive_file(u8_archive const &archive, const char *extensions, const char *kind);
+
+#endif // #ifndef __U8_ARCHIVE_H__
@@ -0,0 +1,253 @@
+#include "wii_disc.h"
+#include "input_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+// Input over the decrypted data partition, the disc outlives it
+struct wii_partition_input : public generic_linput_t
+{
+    wii_disc *m_disc;
+
+    explicit wii_partition_input(wii_disc *disc) : m_disc(disc)
+    {
+        filesize = disc->size();
+        blocksize = 0;
+    }
+
+    virtual ssize_t idaapi read(qoff64_t off, void *buffer, size_t nbytes) override
+    {
+        return off < 0 ? -1 : m_disc->read(static_cast<uint64_t>(off), buffer, nbytes);
+    }
+};
+
+wii_disc::wii_disc(size_t cache_clusters)
+    : m_input(nullptr), m_data_offset(0), m_data_size(0), m_wbfs_shift(0),
+      m_cache_clusters(std::max<size_t>(cache_clusters, 1)), m_decrypted(0), m_hits(0)
+{
+}
+
+wii_disc::~wii_disc()
+{
+    if (m_decrypted != 0)
+    {
+        msg("Disc: %u clusters decrypted (%s), %u reads from the cache\n", m_decrypted,
+            aes128::hardware() ? "AES-NI" : "tables", m_hits);
+    }
+}
+
+bool wii_disc::open(linput_t *li)
+{
+    m_input = li;
+    m_wbfs_sectors.clear();
+    m_cache.clear();
+    m_cached.clear();
+
+    uint64_t file_size = static_cast<uint64_t>(qlsize(li));
+    uint8_t magic[4];
+    if (!read_raw(0, magic, sizeof(magic)))
+        return err_msg("Disc: unable to read the image");
+    if (read_be32(magic) == WBFS_MAGIC && !this->open_wbfs(file_size))
+        return false;
+
+    uint8_t header[WII_MAGIC_OFFSET + 4];
+    if (!read_raw(0, header, sizeof(header)) || read_be32(header + WII_MAGIC_OFFSET) != WII_MAGIC)
+        return err_msg("Disc: not a Wii disc image");
+
+    // The game is in the first data partition, the others hold updates and
+    // channels
+    uint8_t groups[WII_PARTITION_GROUP_COUNT * 8];
+    if (!read_raw(WII_PARTITION_GROUPS, groups, sizeof(groups)))
+        return err_msg("Disc: unable to read the partition table");
+
+    uint64_t partition = 0;
+    for (size_t group = 0; group < WII_PARTITION_GROUP_COUNT && partition == 0; group++)
+    {
+        uint32_t count = read_be32(groups + group * 8);
+        uint64_t table = uint64_t(read_be32(groups + group * 8 + 4)) << 2;
+        for (uint32_t i = 0; i < count && i < 64 && partition == 0; i++)
+        {
+            uint8_t entry[8];
+            if (!read_raw(table + i * 8, entry, sizeof(entry)))
+                return err_msg("Disc: unable to read the partition table");
+            if (read_be32(entry + 4) == WII_PARTITION_DATA)
+                partition = uint64_t(read_be32(entry)) << 2;
+        }
+    }
+    if (partition == 0)
+        return err_msg("Disc: the Wii disc has no data partition");
+
+    uint8_t sizes[8];
+    if (!read_raw(partition + WII_PARTITION_DATA_OFFSET, sizes, sizeof(sizes)))
+        return err_msg("Disc: unable to read the partition header at %llX", static_cast<unsigned long long>(partition));
+    m_data_offset = partition + (uint64_t(read_be32(sizes)) << 2);
+    m_data_size = ((uint64_t(read_be32(sizes + 4)) << 2) / WII_CLUSTER_SIZE) * WII_CLUSTER_DATA_SIZE;
+    if (m_data_size == 0)
+        return err_msg("Disc: the data partition is empty");
+
+    return this->read_title_key(partition);
+}
+
+bool wii_disc::open_wbfs(uint64_t file_size)
+{
+    uint8_t header[WBFS_DISC_TABLE + 1];
+    if (!read_raw(0, header, sizeof(header)))
+        return err_msg("Disc: unable to read the WBFS header");
+
+    // Only the first disc of the container is loaded
+    uint32_t hd_shift = header[8];
+    uint32_t wbfs_shift = header[9];
+    if (hd_shift < 9 || hd_shift > 16 || wbfs_shift < 15 || wbfs_shift > 30 || header[WBFS_DISC_TABLE] == 0)
+        return err_msg("Disc: the WBFS header is invalid or holds no disc");
+
+    uint64_t sectors = (uint64_t(WBFS_WII_SECTORS) * WII_CLUSTER_SIZE) >> wbfs_shift;
+    uint64_t info = uint64_t(1) << hd_shift;
+    std::vector<uint8_t> table(static_cast<size_t>(sectors * 2));
+    if (info + WBFS_DISC_HEADER_COPY + table.size() > file_size ||
+        qlseek(m_input, static_cast<qoff64_t>(info + WBFS_DISC_HEADER_COPY), SEEK_SET) != static_cast<qoff64_t>(info + WBFS_DISC_HEADER_COPY) ||
+        qlread(m_input, table.data(), table.size()) != static_cast<ssize_t>(table.size()))
+        return err_msg("Disc: unable to read the WBFS sector table");
+
+    m_wbfs_sectors.resize(static_cast<size_t>(sectors));
+    for (size_t i = 0; i < m_wbfs_sectors.size(); i++)
+        m_wbfs_sectors[i] = read_be16(&table[i * 2]);
+    m_wbfs_shift = wbfs_shift;
+    return true;
+}
+
+// Read a range of the disc, mapped through the WBFS sector table if needed
+bool wii_disc::read_raw(uint64_t offset, void *buffer, size_t size)
+{
+    uint8_t *out = static_cast<uint8_t *>(buffer);
+    while (size != 0)
+    {
+        uint64_t source = offset;
+        size_t count = size;
+        if (!m_wbfs_sectors.empty())
+        {
+            uint64_t sector = offset >> m_wbfs_shift;
+            uint64_t within = offset & ((uint64_t(1) << m_wbfs_shift) - 1);
+            count = static_cast<size_t>(std::min<uint64_t>(size, (uint64_t(1) << m_wbfs_shift) - within));
+            if (sector >= m_wbfs_sectors.size())
+                return false;
+            if (m_wbfs_sectors[sector] == 0)
+            {
+                // Sectors that were not stored read as zeros
+                memset(out, 0, count);
+                out += count;
+                offset += count;
+                size -= count;
+                continue;
+            }
+            source = (uint64_t(m_wbfs_sectors[sector]) << m_wbfs_shift) + within;
+        }
+
+        if (qlseek(m_input, static_cast<qoff64_t>(source), SEEK_SET) != static_cast<qoff64_t>(source) ||
+            qlread(m_input, out, count) != static_cast<ssize_t>(count))
+            return false;
+        out += count;
+        offset += count;
+        size -= count;
+    }
+    return true;
+}
+
+bool wii_disc::read_title_key(uint64_t partition)
+{
+    uint8_t ticket[WII_TICKET_KEY_INDEX + 1];
+    if (!read_raw(partition, ticket, sizeof(ticket)))
+        return err_msg("Disc: unable to read the partition ticket");
+    uint32_t key_index = ticket[WII_TICKET_KEY_INDEX];
+
+    qstring path;
+    if (!qgetenv(WII_KEY_ENV, &path) || path.empty())
+    {
+        char dir[QMAXPATH] = {};
+        char file[QMAXPATH] = {};
+        if (qdirname(dir, sizeof(dir), get_path(PATH_TYPE_IDB)) != nullptr)
+            qmakepath(file, sizeof(file), dir, WII_KEY_FILE, nullptr);
+        else
+            qstrncpy(file, WII_KEY_FILE, sizeof(file));
+        path = file;
+    }
+
+    uint8_t common[AES_BLOCK_SIZE];
+    FILE *fp = fopenRB(path.c_str());
+    bool found = fp != nullptr && qfseek(fp, key_index * AES_BLOCK_SIZE, SEEK_SET) == 0 &&
+                 qfread(fp, common, sizeof(common)) == static_cast<ssize_t>(sizeof(common));
+    qfclose(fp);
+    if (!found)
+        return err_msg("Disc: Wii common key %u not found in %s (set %s to the key file)", key_index, path.c_str(), WII_KEY_ENV);
+
+    // The title key is encrypted with the common key, the IV is the title ID
+    uint8_t iv[AES_BLOCK_SIZE] = {};
+    memcpy(iv, ticket + WII_TICKET_TITLE_ID, 8);
+    uint8_t title_key[AES_BLOCK_SIZE];
+    aes128 cipher;
+    cipher.set_key(common);
+    cipher.decrypt_cbc(iv, ticket + WII_TICKET_TITLE_KEY, title_key, sizeof(title_key));
+    m_key.set_key(title_key);
+    return true;
+}
+
+const uint8_t *wii_disc::cluster(uint64_t index)
+{
+    auto found = m_cached.find(index);
+    if (found != m_cached.end())
+    {
+        ++m_hits;
+        m_cache.splice(m_cache.begin(), m_cache, found->second);
+        return found->second->m_data.data();
+    }
+
+    // Reuse the buffer of the least recently used cluster once full
+    if (m_cache.size() >= m_cache_clusters)
+    {
+        m_cached.erase(m_cache.back().m_index);
+        m_cache.splice(m_cache.begin(), m_cache, std::prev(m_cache.end()));
+    }
+    else
+        m_cache.emplace_front(cached_cluster{ 0, std::vector<uint8_t>(WII_CLUSTER_DATA_SIZE) });
+
+    cached_cluster &entry = m_cache.front();
+    m_encrypted.resize(WII_CLUSTER_SIZE);
+    if (!read_raw(m_data_offset + index * WII_CLUSTER_SIZE, m_encrypted.data(), m_encrypted.size()))
+    {
+        m_cache.pop_front();
+        return nullptr;
+    }
+    m_key.decrypt_cbc(&m_encrypted[WII_CLUSTER_IV_OFFSET], &m_encrypted[WII_CLUSTER_HASH_SIZE], entry.m_data.data(), WII_CLUSTER_DATA_SIZE);
+    ++m_decrypted;
+
+    entry.m_index = index;
+    m_cached[index] = m_cache.begin();
+    return entry.m_data.data();
+}
+
+ssize_t wii_disc::read(uint64_t offset, void *buffer, size_t size)
+{
+    if (offset >= m_data_size)
+        return 0;
+    size = static_cast<size_t>(std::min<uint64_t>(size, m_data_size - offset));
+
+    uint8_t *out = static_cast<uint8_t *>(buffer);
+    size_t done = 0;
+    while (done < size)
+    {
+        uint64_t index = (offset + done) / WII_CLUSTER_DATA_SIZE;
+        size_t within = static_cast<size_t>((offset + done) % WII_CLUSTER_DATA_SIZE);
+        size_t count = std::min<size_t>(size - done, WII_CLUSTER_DATA_SIZE - within);
+        const uint8_t *data = this->cluster(index);
+        if (data == nullptr)
+            break;
+        memcpy(out + done, data + within, count);
+        done += count;
+    }
+    return static_cast<ssize_t>(done);
+}
+
+linput_t *wii_disc::create_input()
+{
+    return create_generic_linput(new wii_partition_input(this));
+}
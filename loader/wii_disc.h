@@ -0,0 +1,110 @@
+#ifndef __WII_DISC_H__
+#define __WII_DISC_H__
+
+#include "idaloader.h"
+#include "aes.h"
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Wii disc header, the rest of it is laid out like a GameCube disc
+#define WII_MAGIC_OFFSET          0x18
+#define WII_MAGIC                 0x5D1C9EA3
+
+// Four partition groups of (count, table offset >> 2), each table entry is
+// (partition offset >> 2, type)
+#define WII_PARTITION_GROUPS      0x40000
+#define WII_PARTITION_GROUP_COUNT 4
+#define WII_PARTITION_DATA        0
+
+// Partition header: the ticket, then the offsets of the TMD, the
+// certificates, the H3 table and the encrypted data (all >> 2)
+#define WII_TICKET_TITLE_KEY      0x1BF
+#define WII_TICKET_TITLE_ID       0x1DC
+#define WII_TICKET_KEY_INDEX      0x1F1
+#define WII_PARTITION_DATA_OFFSET 0x2B8
+#define WII_PARTITION_DATA_SIZE   0x2BC
+#define WII_PARTITION_HEADER_SIZE 0x2C0
+
+// The data is stored in clusters of hashes followed by encrypted data, the
+// data's IV is the last 16 bytes of the (still encrypted) hash area
+#define WII_CLUSTER_SIZE          0x8000
+#define WII_CLUSTER_HASH_SIZE     0x400
+#define WII_CLUSTER_DATA_SIZE     (WII_CLUSTER_SIZE - WII_CLUSTER_HASH_SIZE)
+#define WII_CLUSTER_IV_OFFSET     0x3D0
+
+// Decrypted clusters kept by default, 8 MB
+#define WII_CACHE_CLUSTERS        256
+
+// The common keys are never shipped: they are read from the file named by
+// this variable, or from common-key.bin next to the database. The file holds
+// the keys in the order of the ticket's key index (common, Korean).
+#define WII_KEY_ENV               "WII_COMMON_KEY"
+#define WII_KEY_FILE              "common-key.bin"
+
+// WBFS container: a header sector with the disc table, then per disc a copy
+// of its header and the table of WBFS sectors backing the disc
+#define WBFS_MAGIC                0x57424653
+#define WBFS_DISC_TABLE           0xC
+#define WBFS_DISC_HEADER_COPY     0x100
+#define WBFS_WII_SECTORS          (143432 * 2)   // dual layer disc
+
+// Reader of the data partition of a Wii disc, from a plain ISO or the first
+// disc of a WBFS container. Only the clusters that are actually read are
+// decrypted, and they are kept in an LRU cache: the loaders read the DOL,
+// the FST and the RELs as many small ranges and most of them share clusters.
+class wii_disc
+{
+public:
+    wii_disc(size_t cache_clusters = WII_CACHE_CLUSTERS);
+    ~wii_disc();
+
+    // Find the data partition and decrypt its title key
+    bool open(linput_t *li);
+
+    // Decrypted size of the data partition
+    uint64_t size() const { return m_data_size; }
+
+    // Read decrypted bytes of the data partition, returns the count read
+    ssize_t read(uint64_t offset, void *buffer, size_t size);
+
+    // Input over the decrypted partition, close it before the disc
+    linput_t *create_input();
+
+    bool wbfs() const { return !m_wbfs_sectors.empty(); }
+
+private:
+    bool open_wbfs(uint64_t file_size);
+    bool read_raw(uint64_t offset, void *buffer, size_t size);
+    bool read_title_key(uint64_t partition);
+
+    // Decrypted data of a cluster of the partition, nullptr if unreadable
+    const uint8_t *cluster(uint64_t index);
+
+    struct cached_cluster
+    {
+        uint64_t m_index;
+        std::vector<uint8_t> m_data;
+    };
+
+    linput_t *m_input;
+    aes128 m_key;
+    uint64_t m_data_offset;   // of the encrypted clusters in the disc
+    uint64_t m_data_size;
+
+    // WBFS sector of every disc sector, 0 for sectors that were not stored
+    std::vector<uint16_t> m_wbfs_sectors;
+    uint32_t m_wbfs_shift;
+
+    // Most recently used first
+    size_t m_cache_clusters;
+    std::list<cached_cluster> m_cache;
+    std::unordered_map<uint64_t, std::list<cached_cluster>::iterator> m_cached;
+    std::vector<uint8_t> m_encrypted;
+    uint32_t m_decrypted;
+    uint32_t m_hits;
+};
+
+#endif // #ifndef __WII_DISC_H__
@@ -0,0 +1,83 @@
+#include "ext_module.h"
+#include "../loader/input_buffer.h"
+#include <algorithm>
+
+void ext_module_table::clear()
+{
+  m_modules.clear();
+  m_sections.clear();
+  m_names.clear();
+}
+
+void ext_module_table::reserve(size_t count)
+{
+  m_modules.reserve(count);
+  m_sections.reserve(count * 16);
+  m_names.reserve(count * 16);
+}
+
+void ext_module_table::add(uint32_t id, std::string const &name, std::vector<section_entry> const &sections)
+{
+  ext_module module;
+  module.m_id            = id;
+  module.m_first_offset  = 0;
+  module.m_name_offset   = static_cast<uint32_t>(m_names.size());
+  module.m_section_begin = static_cast<uint32_t>(m_sections.size());
+  module.m_num_sections  = static_cast<uint8_t>(sections.size());
+
+  // Precompute the base every section offset is made relative to
+  for ( unsigned i = 0; i < sections.size() && module.m_first_offset == 0; ++i )
+    module.m_first_offset = SECTION_OFF(sections[i].file_offset);
+
+  m_names.append(name);
+  m_names.push_back('\0');
+  m_sections.insert(m_sections.end(), sections.begin(), sections.end());
+  m_modules.push_back(module);
+}
+
+void ext_module_table::finalize()
+{
+  std::stable_sort(m_modules.begin(), m_modules.end(),
+    [](ext_module const &a, ext_module const &b) { return a.m_id < b.m_id; });
+
+  // Keep the last module registered for an id
+  auto last = m_modules.begin();
+  for ( auto it = m_modules.begin(); it != m_modules.end(); ++it )
+  {
+    if ( last != it && last->m_id == it->m_id )
+      *last = *it;
+    else if ( last != it )
+      *++last = *it;
+  }
+  if ( !m_modules.empty() )
+    m_modules.erase(last + 1, m_modules.end());
+}
+
+ext_module const * ext_module_table::find(uint32_t id) const
+{
+  auto it = std::lower_bound(m_modules.begin(), m_modules.end(), id,
+    [](ext_module const &module, uint32_t value) { return module.m_id < value; });
+  if ( it == m_modules.end() || it->m_id != id )
+    return nullptr;
+  return &*it;
+}
+
+uint64_t ext_module_table::fingerprint() const
+{
+  uint64_t hash = hash_bytes(nullptr, 0);
+  for ( auto const &module : m_modules )
+  {
+    char const *module_name = this->name(module);
+    hash = hash_bytes(reinterpret_cast<uint8_t const *>(&module.m_id), sizeof(module.m_id), hash);
+    hash = hash_bytes(reinterpret_cast<uint8_t const *>(module_name), strlen(module_name) + 1, hash);
+    hash = hash_bytes(reinterpret_cast<uint8_t const *>(m_sections.data() + module.m_section_begin), module.m_num_sections * sizeof(section_entry), hash);
+  }
+  return hash;
+}
+
+size_t ext_module_table::memory_usage() const
+{
+  return m_modules.capacity() * sizeof(ext_module) +
+         m_sections.capacity() * sizeof(section_entry) +
+         m_names.capacity();
+}
@@ -0,0 +1,56 @@
+#ifndef __EXT_MODULE_H__
+#define __EXT_MODULE_H__
+
+#include "rel.h"
+#include <string>
+#include <vector>
+
+// Compact descriptor of a sibling module, everything needed to resolve
+// imports against it. Names and section tables live in the owning table.
+struct ext_module
+{
+  uint32_t m_id;
+  uint32_t m_first_offset;   // file offset of the first section with data
+  uint32_t m_name_offset;    // into the table's name pool
+  uint32_t m_section_begin;  // into the table's section pool
+  uint8_t  m_num_sections;
+};
+
+// Flat table of external modules, sorted by module id
+class ext_module_table
+{
+public:
+  ext_module_table() {}
+  ext_module_table(ext_module_table &&) = default;
+  ext_module_table & operator=(ext_module_table &&) = default;
+  ext_module_table(ext_module_table const &) = delete;
+  ext_module_table & operator=(ext_module_table const &) = delete;
+
+  void clear();
+  void reserve(size_t count);
+  void add(uint32_t id, std::string const &name, std::vector<section_entry> const &sections);
+
+  // Sort by id once every module has been added; later duplicates win
+  void finalize();
+
+  ext_module const * find(uint32_t id) const;
+
+  char const * name(ext_module const &module) const { return m_names.c_str() + module.m_name_offset; }
+  section_entry const & section(ext_module const &module, uint8_t index) const { return m_sections[module.m_section_begin + index]; }
+
+  size_t size() const { return m_modules.size(); }
+
+  // Hash of every module's id, name and section table, it changes whenever
+  // an import could resolve differently
+  uint64_t fingerprint() const;
+
+  // Heap bytes owned by the table
+  size_t memory_usage() const;
+
+private:
+  std::vector<ext_module> m_modules;
+  std::vector<section_entry> m_sections;
+  std::string m_names;   // zero separated
+};
+
+#endif // #ifndef __EXT_MODULE_H__
@@ -0,0 +1,96 @@
+#include "import_map.h"
+
+// Slots are small, so no real key ever has all bits set
+#define EMPTY_KEY (~static_cast<uint64_t>(0))
+#define MIN_CAPACITY 64
+
+import_map::import_map(load_arena *arena)
+  : m_entries(arena_allocator<entry>(arena))
+  , m_size(0)
+{
+}
+
+void import_map::clear()
+{
+  m_entries.clear();
+  m_size = 0;
+}
+
+void import_map::reserve(size_t count)
+{
+  // Keep the load factor at or below one half
+  size_t capacity = MIN_CAPACITY;
+  while ( capacity < count * 2 )
+    capacity <<= 1;
+  if ( capacity > m_entries.size() )
+    rehash(capacity);
+}
+
+size_t import_map::bucket(uint64_t key) const
+{
+  // Fibonacci hashing spreads the sequential offsets over the table
+  uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+  return static_cast<size_t>(hash ^ (hash >> 32)) & (m_entries.size() - 1);
+}
+
+void import_map::rehash(size_t capacity)
+{
+  arena_vector<entry> old(m_entries.get_allocator());
+  old.swap(m_entries);
+  m_entries.assign(capacity, entry{ EMPTY_KEY, BADADDR });
+
+  for ( auto const &e : old )
+  {
+    if ( e.m_key == EMPTY_KEY )
+      continue;
+    size_t i = bucket(e.m_key);
+    while ( m_entries[i].m_key != EMPTY_KEY )
+      i = (i + 1) & (m_entries.size() - 1);
+    m_entries[i] = e;
+  }
+}
+
+ea_t import_map::insert(uint32_t slot, uint32_t offset, ea_t stub, bool *inserted)
+{
+  if ( (m_size + 1) * 2 > m_entries.size() )
+    rehash(m_entries.empty() ? MIN_CAPACITY : m_entries.size() * 2);
+
+  uint64_t key = make_key(slot, offset);
+  size_t i = bucket(key);
+  for ( ;; )
+  {
+    entry &e = m_entries[i];
+    if ( e.m_key == key )
+    {
+      *inserted = false;
+      return e.m_stub;
+    }
+    if ( e.m_key == EMPTY_KEY )
+    {
+      e.m_key = key;
+      e.m_stub = stub;
+      ++m_size;
+      *inserted = true;
+      return stub;
+    }
+    i = (i + 1) & (m_entries.size() - 1);
+  }
+}
+
+ea_t import_map::find(uint32_t slot, uint32_t offset) const
+{
+  if ( m_entries.empty() )
+    return BADADDR;
+
+  uint64_t key = make_key(slot, offset);
+  size_t i = bucket(key);
+  for ( ;; )
+  {
+    entry const &e = m_entries[i];
+    if ( e.m_key == key )
+      return e.m_stub;
+    if ( e.m_key == EMPTY_KEY )
+      return BADADDR;
+    i = (i + 1) & (m_entries.size() - 1);
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef __IMPORT_MAP_H__
+#define __IMPORT_MAP_H__
+
+#include "rel.h"
+#include "ext_module.h"
+#include "../loader/load_arena.h"
+#include <vector>
+
+// Relocations against one imported module, which is interned to a small slot
+// number the first time the import table references it. The relocations are
+// not kept, the patching pass decodes them again from the streams.
+struct import_module
+{
+  uint32_t m_id;
+  ext_module const *m_module;   // null when the module isn't next to the database
+  ea_t m_start;                 // first import stub of the module
+  arena_vector<uint32_t> m_streams;  // file offsets of the module's relocation streams
+};
+
+// Open addressing hash table from (module slot, target offset) to the import
+// stub allocated for that target. The table lives in the arena when one is
+// given, workers use the heap.
+class import_map
+{
+public:
+  explicit import_map(load_arena *arena = nullptr);
+
+  void clear();
+  void reserve(size_t count);
+
+  // Stub of the key, `stub` is stored and returned when the key is new
+  ea_t insert(uint32_t slot, uint32_t offset, ea_t stub, bool *inserted);
+
+  // BADADDR when the key isn't mapped
+  ea_t find(uint32_t slot, uint32_t offset) const;
+
+  size_t size() const { return m_size; }
+
+private:
+  struct entry
+  {
+    uint64_t m_key;
+    ea_t m_stub;
+  };
+
+  static uint64_t make_key(uint32_t slot, uint32_t offset) { return (static_cast<uint64_t>(slot) << 32) | offset; }
+  size_t bucket(uint64_t key) const;
+  void rehash(size_t capacity);
+
+  arena_vector<entry> m_entries;   // power of two sized, linear probing
+  size_t m_size;
+};
+
+#endif // #ifndef __IMPORT_MAP_H__
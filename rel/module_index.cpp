@@ -0,0 +1,415 @@
+#include "module_index.h"
+#include "rel_track.h"
+#include "../loader/probe.h"
+#include "../loader/u8_archive.h"
+#include <sys/stat.h>
+
+#define MODULE_INDEX_MAGIC   0x524C4958 // RLIX
+#define MODULE_INDEX_VERSION 2
+
+// FNV-1a, used to detect truncated or damaged index files
+static uint32_t index_checksum(uint8_t const *data, size_t size)
+{
+  uint32_t hash = 0x811C9DC5;
+  for ( size_t i = 0; i < size; ++i )
+  {
+    hash ^= data[i];
+    hash *= 0x01000193;
+  }
+  return hash;
+}
+
+module_index::module_index(std::string const &directory)
+  : m_directory(directory)
+  , m_dirty(false)
+  , m_reused(0)
+  , m_parsed(0)
+{}
+
+std::string module_index::index_path() const
+{
+  char path[QMAXPATH];
+  qmakepath(path, sizeof(path), m_directory.c_str(), MODULE_INDEX_FILE, nullptr);
+  return path;
+}
+
+bool module_index::load()
+{
+  m_entries.clear();
+  m_archives.clear();
+
+  input_buffer buffer;
+  if ( !qfileexist(index_path().c_str()) || !buffer.map(index_path().c_str()) )
+    return false;
+
+  // The checksum covers everything but itself
+  if ( buffer.size() < 16 || index_checksum(buffer.data(), buffer.size() - 4) != read_be32(buffer.data() + buffer.size() - 4) )
+    return err_msg("REL: Module index is damaged, rebuilding it");
+
+  be_cursor in = buffer.cursor(0);
+  uint32_t magic, version, count;
+  if ( !in.read_u32(&magic) || !in.read_u32(&version) || !in.read_u32(&count) ||
+       magic != MODULE_INDEX_MAGIC || version != MODULE_INDEX_VERSION )
+    return false;
+
+  for ( uint32_t i = 0; i < count; ++i )
+  {
+    module_index_entry entry;
+    uint64_t mtime;
+    uint32_t num_sections;
+    if ( !in.read_str(&entry.m_file) || !in.read_u64(&entry.m_size) || !in.read_u64(&mtime) ||
+         !in.read_u32(&entry.m_id) || !in.read_str(&entry.m_name) || !in.read_u32(&num_sections) ||
+         num_sections > 32 )
+    {
+      m_entries.clear();
+      return err_msg("REL: Module index entry %u is damaged, rebuilding it", i);
+    }
+    entry.m_mtime = static_cast<int64_t>(mtime);
+
+    entry.m_sections.resize(num_sections);
+    for ( auto &section : entry.m_sections )
+    {
+      if ( !in.read_u32(&section.file_offset) || !in.read_u32(&section.size) )
+      {
+        m_entries.clear();
+        return err_msg("REL: Module index entry %u is damaged, rebuilding it", i);
+      }
+    }
+
+    std::string file = entry.m_file;
+    m_entries[file] = std::move(entry);
+  }
+
+  uint32_t archives;
+  if ( !in.read_u32(&archives) )
+  {
+    m_entries.clear();
+    return err_msg("REL: Module index is damaged, rebuilding it");
+  }
+  for ( uint32_t i = 0; i < archives; ++i )
+  {
+    std::string file;
+    module_index_archive stamp;
+    uint64_t mtime;
+    if ( !in.read_str(&file) || !in.read_u64(&stamp.m_size) || !in.read_u64(&mtime) )
+    {
+      m_entries.clear();
+      m_archives.clear();
+      return err_msg("REL: Module index archive %u is damaged, rebuilding it", i);
+    }
+    stamp.m_mtime = static_cast<int64_t>(mtime);
+    m_archives[file] = stamp;
+  }
+  return true;
+}
+
+// Module name of a file: the file name without its .rel or .rel.szs extension
+static std::string module_file_name(std::string const &file)
+{
+  std::string name = file.substr(0, file.find_last_of('.'));
+  std::string extension = file.substr(name.size());
+  if ( extension == ".szs" || extension == ".SZS" )
+    name = name.substr(0, name.find_last_of('.'));
+  return name;
+}
+
+int idaapi index_modules_cb(char const *file, module_index *index)
+{
+  index->scan_file(file);
+  return 0;
+}
+
+void module_index::scan_file(char const *file)
+{
+  struct stat st;
+  if ( stat(file, &st) != 0 )
+    return;
+
+  std::string basename(qbasename(file));
+  m_seen[basename] = true;
+
+  // Unchanged since the index was written
+  auto it = m_entries.find(basename);
+  if ( it != m_entries.end() && it->second.m_size == static_cast<uint64_t>(st.st_size) && it->second.m_mtime == static_cast<int64_t>(st.st_mtime) )
+  {
+    ++m_reused;
+    return;
+  }
+
+  // Failed to unpack or parse when the index was written, and unchanged since
+  module_index_archive stamp = { static_cast<uint64_t>(st.st_size), static_cast<int64_t>(st.st_mtime) };
+  auto failed = m_archives.find(basename);
+  if ( failed != m_archives.end() && failed->second.m_size == stamp.m_size && failed->second.m_mtime == stamp.m_mtime )
+    return;
+
+  // (Re)parse the module header and section table
+  m_dirty = true;
+  ++m_parsed;
+
+  input_buffer buffer;
+  if ( !buffer.map(file) || !buffer.unpack() )
+  {
+    m_entries.erase(basename);
+    m_archives[basename] = stamp;
+    return;
+  }
+
+  rel_track rel(buffer);
+  if ( !rel.is_good() )
+  {
+    m_entries.erase(basename);
+    m_archives[basename] = stamp;
+    return;
+  }
+
+  m_archives.erase(basename);
+  module_index_entry entry;
+  entry.m_file     = basename;
+  entry.m_size     = stamp.m_size;
+  entry.m_mtime    = stamp.m_mtime;
+  entry.m_id       = rel.get_id();
+  entry.m_name     = module_file_name(basename);
+  entry.m_sections = rel.get_sections();
+  m_entries[basename] = std::move(entry);
+}
+
+int idaapi index_archives_cb(char const *file, module_index *index)
+{
+  index->scan_archive(file);
+  return 0;
+}
+
+void module_index::scan_archive(char const *file)
+{
+  // Compressed modules are matched by *.szs as well
+  std::string basename(qbasename(file));
+  if ( match_extension(basename, ".rel.szs") )
+    return;
+
+  struct stat st;
+  if ( stat(file, &st) != 0 )
+    return;
+  m_seen[basename] = true;
+
+  // Unchanged since the index was written, its modules are kept as they are
+  std::string prefix = basename + ":";
+  auto archive = m_archives.find(basename);
+  if ( archive != m_archives.end() && archive->second.m_size == static_cast<uint64_t>(st.st_size) && archive->second.m_mtime == static_cast<int64_t>(st.st_mtime) )
+  {
+    for ( auto it = m_entries.lower_bound(prefix); it != m_entries.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it )
+    {
+      m_seen[it->first] = true;
+      ++m_reused;
+    }
+    return;
+  }
+
+  m_dirty = true;
+  for ( auto it = m_entries.lower_bound(prefix); it != m_entries.end() && it->first.compare(0, prefix.size(), prefix) == 0; )
+    it = m_entries.erase(it);
+
+  module_index_archive stamp = { static_cast<uint64_t>(st.st_size), static_cast<int64_t>(st.st_mtime) };
+  m_archives[basename] = stamp;
+  this->scan_archive_modules(file, basename, stamp);
+}
+
+void module_index::scan_archive_modules(char const *file, std::string const &basename, module_index_archive const &stamp)
+{
+  // Most .szs files are not archives, only their first bytes are decoded to
+  // tell. Those are remembered too so they are not looked at again.
+  linput_t *li = open_linput(file, false);
+  if ( li == nullptr )
+    return;
+  uint8_t block[PROBE_BLOCK_SIZE];
+  size_t size = probe_read(li, block);
+  uint8_t unpacked[PROBE_UNPACK_SIZE];
+  uint64_t unpacked_size;
+  size_t unpacked_count = probe_unpack(li, block, size, unpacked, &unpacked_size);
+  bool is_archive = unpacked_count != 0 ? probe_archive(unpacked, unpacked_count, unpacked_size) : probe_archive(block, size, stamp.m_size);
+  close_linput(li);
+  if ( !is_archive )
+    return;
+
+  input_buffer buffer;
+  u8_archive archive;
+  if ( !buffer.map(file) || !archive.open(buffer, basename.c_str()) )
+    return;
+
+  for ( disc_file const *member : archive.files(".rel;.rel.szs") )
+  {
+    ++m_parsed;
+    input_buffer contents = archive.contents(*member);
+    if ( !contents.unpack() )
+      continue;
+    rel_track rel(contents);
+    if ( !rel.is_good() )
+      continue;
+
+    module_index_entry entry;
+    entry.m_file     = basename + ":" + member->m_path;
+    entry.m_size     = member->m_size;
+    entry.m_mtime    = stamp.m_mtime;
+    entry.m_id       = rel.get_id();
+    entry.m_name     = module_file_name(qbasename(member->m_path.c_str()));
+    entry.m_sections = rel.get_sections();
+    m_seen[entry.m_file] = true;
+    m_entries[entry.m_file] = std::move(entry);
+  }
+}
+
+void module_index::refresh()
+{
+  m_seen.clear();
+  m_reused = 0;
+  m_parsed = 0;
+
+  // Compressed modules are named <module>.rel.szs
+  enumerate_files(nullptr, 0, m_directory.c_str(), "*.rel", reinterpret_cast<int(idaapi*)(char const*,void*)>(&index_modules_cb), this);
+  enumerate_files(nullptr, 0, m_directory.c_str(), "*.rel.szs", reinterpret_cast<int(idaapi*)(char const*,void*)>(&index_modules_cb), this);
+
+  // Modules packed in archives, which are often compressed as a whole
+  enumerate_files(nullptr, 0, m_directory.c_str(), "*.arc", reinterpret_cast<int(idaapi*)(char const*,void*)>(&index_archives_cb), this);
+  enumerate_files(nullptr, 0, m_directory.c_str(), "*.szs", reinterpret_cast<int(idaapi*)(char const*,void*)>(&index_archives_cb), this);
+
+  // Drop modules that have been removed
+  for ( auto it = m_entries.begin(); it != m_entries.end(); )
+  {
+    if ( m_seen.find(it->first) == m_seen.end() )
+    {
+      it = m_entries.erase(it);
+      m_dirty = true;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  for ( auto it = m_archives.begin(); it != m_archives.end(); )
+  {
+    if ( m_seen.find(it->first) == m_seen.end() )
+    {
+      it = m_archives.erase(it);
+      m_dirty = true;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+void module_index::scan_disc(disc_image const &disc, linput_t *li)
+{
+  m_entries.clear();
+  m_seen.clear();
+  m_reused = 0;
+  m_parsed = 0;
+
+  for ( disc_file const *file : disc.files(".rel;.rel.szs") )
+  {
+    module_index_entry entry;
+    ++m_parsed;
+    if ( scan_disc_file(*file, li, &entry) )
+      m_entries[file->m_path] = std::move(entry);
+  }
+}
+
+bool module_index::scan_disc_file(disc_file const &file, linput_t *li, module_index_entry *entry)
+{
+  entry->m_file  = file.m_path;
+  entry->m_size  = file.m_size;
+  entry->m_mtime = 0;
+  entry->m_name  = module_file_name(qbasename(file.m_path.c_str()));
+
+  // Compressed modules are small, they are unpacked as a whole
+  uint8_t block[PROBE_UNPACK_SIZE];
+  uint32_t size = file.m_size < sizeof(block) ? file.m_size : static_cast<uint32_t>(sizeof(block));
+  qlseek(li, file.m_offset, SEEK_SET);
+  if ( qlread(li, block, size) != static_cast<ssize_t>(size) )
+    return false;
+  if ( compression_detect(block, size) != COMPRESSION_NONE )
+  {
+    input_buffer buffer;
+    if ( !buffer.read(li, file.m_offset, file.m_size) || !buffer.unpack() )
+      return false;
+    rel_track rel(buffer);
+    if ( !rel.is_good() )
+      return false;
+    entry->m_id       = rel.get_id();
+    entry->m_sections = rel.get_sections();
+    return true;
+  }
+
+  // The section table normally follows the header, otherwise the start of
+  // the module is read up to its end
+  std::vector<uint8_t> prefix(block, block + size);
+  if ( size >= relhdr_view::header_size(1) )
+  {
+    relhdr_view hdr(block);
+    uint64_t table_end = uint64_t(hdr.section_offset()) + uint64_t(hdr.num_sections()) * sizeof(section_entry);
+    if ( hdr.num_sections() <= 32 && table_end > size && table_end <= file.m_size )
+    {
+      prefix.resize(static_cast<size_t>(table_end));
+      qlseek(li, file.m_offset, SEEK_SET);
+      if ( qlread(li, prefix.data(), prefix.size()) != static_cast<ssize_t>(prefix.size()) )
+        return false;
+    }
+  }
+
+  // The probe checks the table the same way the module is checked on load
+  if ( !probe_rel(nullptr, prefix.data(), prefix.size(), file.m_size) )
+    return false;
+  relhdr_view hdr(prefix.data());
+  entry->m_id = hdr.id();
+  entry->m_sections.resize(hdr.num_sections());
+  for ( uint32_t i = 0; i < hdr.num_sections(); ++i )
+  {
+    section_entry_view view(prefix.data() + hdr.section_offset() + i * sizeof(section_entry));
+    entry->m_sections[i].file_offset = view.file_offset();
+    entry->m_sections[i].size        = view.size();
+  }
+  return true;
+}
+
+bool module_index::save()
+{
+  if ( !m_dirty )
+    return true;
+
+  std::vector<uint8_t> out;
+  put_be32(out, MODULE_INDEX_MAGIC);
+  put_be32(out, MODULE_INDEX_VERSION);
+  put_be32(out, static_cast<uint32_t>(m_entries.size()));
+  for ( auto const &it : m_entries )
+  {
+    module_index_entry const &entry = it.second;
+    put_be_str(out, entry.m_file);
+    put_be64(out, entry.m_size);
+    put_be64(out, static_cast<uint64_t>(entry.m_mtime));
+    put_be32(out, entry.m_id);
+    put_be_str(out, entry.m_name);
+    put_be32(out, static_cast<uint32_t>(entry.m_sections.size()));
+    for ( auto const &section : entry.m_sections )
+    {
+      put_be32(out, section.file_offset);
+      put_be32(out, section.size);
+    }
+  }
+  put_be32(out, static_cast<uint32_t>(m_archives.size()));
+  for ( auto const &it : m_archives )
+  {
+    put_be_str(out, it.first);
+    put_be64(out, it.second.m_size);
+    put_be64(out, static_cast<uint64_t>(it.second.m_mtime));
+  }
+  put_be32(out, index_checksum(out.data(), out.size()));
+
+  FILE *fp = fopenWB(index_path().c_str());
+  if ( fp == nullptr )
+    return err_msg("REL: Unable to write the module index %s", index_path().c_str());
+
+  bool ok = qfwrite(fp, out.data(), out.size()) == static_cast<ssize_t>(out.size());
+  qfclose(fp);
+  m_dirty = !ok;
+  return ok;
+}
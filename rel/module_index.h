@@ -0,0 +1,82 @@
+#ifndef __MODULE_INDEX_H__
+#define __MODULE_INDEX_H__
+
+#include "rel.h"
+#include "../loader/disc_image.h"
+#include <map>
+#include <string>
+#include <vector>
+
+#define MODULE_INDEX_FILE "rel_modules.idx"
+
+// Cached information about a REL module next to the database
+struct module_index_entry
+{
+  std::string m_file;     // file name inside the directory, or "<archive>:<path>"
+  uint64_t m_size;
+  int64_t m_mtime;
+
+  uint32_t m_id;
+  std::string m_name;     // module name (file name without extension)
+  std::vector<section_entry> m_sections;
+};
+
+// Size and modification time of a U8 archive next to the database, its
+// modules are only parsed again when these change. Files that turned out not
+// to be archives, and modules that failed to unpack or parse, are kept the
+// same way so they are not looked at again until they change.
+struct module_index_archive
+{
+  uint64_t m_size;
+  int64_t m_mtime;
+};
+
+// Persistent index of the REL modules in a directory. Entries are keyed by
+// file name and revalidated by size and modification time, so only files that
+// changed since the index was written are parsed again. Modules packed in U8
+// archives (.arc, .szs) are indexed like the others, from the archive in
+// memory.
+class module_index
+{
+public:
+  module_index(std::string const &directory);
+
+  // Read the sidecar index, a missing or damaged index is simply rebuilt
+  bool load();
+
+  // Scan the directory and reparse new or modified modules
+  void refresh();
+
+  // Write the sidecar index back if anything changed
+  bool save();
+
+  // Index the modules of a disc image instead of the directory. Only the
+  // header and section table of each module are read from the image, and
+  // nothing is written back.
+  void scan_disc(disc_image const &disc, linput_t *li);
+
+  std::map<std::string, module_index_entry> const & modules() const { return m_entries; }
+
+  uint32_t reused() const { return m_reused; }
+  uint32_t parsed() const { return m_parsed; }
+
+private:
+  std::string index_path() const;
+  void scan_file(char const *file);
+  void scan_archive(char const *file);
+  void scan_archive_modules(char const *file, std::string const &basename, module_index_archive const &stamp);
+  bool scan_disc_file(disc_file const &file, linput_t *li, module_index_entry *entry);
+
+  std::string m_directory;
+  std::map<std::string, module_index_entry> m_entries;
+  std::map<std::string, module_index_archive> m_archives;
+  std::map<std::string, bool> m_seen;
+  bool m_dirty;
+  uint32_t m_reused;
+  uint32_t m_parsed;
+
+  friend int idaapi index_modules_cb(char const *file, module_index *index);
+  friend int idaapi index_archives_cb(char const *file, module_index *index);
+};
+
+#endif // #ifndef __MODULE_INDEX_H__
@@ -0,0 +1,80 @@
+#include "name_registry.h"
+#include <string>
+
+name_registry::name_registry(load_arena &arena)
+  : m_arena(arena)
+  , m_names(0, name_hash(), name_equal(), arena_allocator<char const *>(&arena))
+  , m_addresses(0, std::hash<ea_t>(), std::equal_to<ea_t>(), arena_allocator< std::pair<ea_t const, char const *> >(&arena))
+  , m_collisions(0)
+{}
+
+size_t name_registry::name_hash::operator()(char const *name) const
+{
+  // FNV-1a
+  size_t hash = static_cast<size_t>(14695981039346656037ull);
+  for ( ; *name != '\0'; ++name )
+  {
+    hash ^= static_cast<unsigned char>(*name);
+    hash *= static_cast<size_t>(1099511628211ull);
+  }
+  return hash;
+}
+
+void name_registry::reserve(size_t count)
+{
+  m_names.reserve(count);
+  m_addresses.reserve(count);
+}
+
+uint32_t name_registry::seed_database()
+{
+  size_t count = get_nlist_size();
+  this->reserve(m_names.size() + count);
+  for ( size_t i = 0; i < count; ++i )
+  {
+    char const *name = get_nlist_name(i);
+    if ( name != nullptr )
+      this->add(get_nlist_ea(i), name);
+  }
+  return static_cast<uint32_t>(1 + count * 2);
+}
+
+char const * name_registry::add(ea_t ea, char const *name)
+{
+  auto it = m_addresses.find(ea);
+  if ( it != m_addresses.end() )
+    m_names.erase(it->second);
+
+  auto known = m_names.find(name);
+  char const *copy = known != m_names.end() ? *known : m_arena.copy(name, strlen(name));
+  m_names.insert(copy);
+  m_addresses[ea] = copy;
+  return copy;
+}
+
+char const * name_registry::name_at(ea_t ea) const
+{
+  auto it = m_addresses.find(ea);
+  return it != m_addresses.end() ? it->second : nullptr;
+}
+
+char const * name_registry::claim(ea_t ea, char const *name, char const *suffix)
+{
+  auto current = m_addresses.find(ea);
+  if ( current != m_addresses.end() && strcmp(current->second, name) == 0 )
+    return current->second;
+
+  if ( !in_use(name) )
+    return this->add(ea, name);
+
+  ++m_collisions;
+  std::string unique = name;
+  if ( suffix != nullptr )
+    unique += suffix;
+
+  std::string base = unique;
+  for ( uint32_t i = 0; in_use(unique.c_str()); ++i )
+    unique = base + '_' + std::to_string(static_cast<unsigned long long>(i));
+
+  return this->add(ea, unique.c_str());
+}
@@ -0,0 +1,54 @@
+#ifndef __NAME_REGISTRY_H__
+#define __NAME_REGISTRY_H__
+
+#include "rel.h"
+#include "../loader/load_arena.h"
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+// In-memory view of the names a load assigns, used to make every name unique
+// before it reaches the database so each address is named exactly once. The
+// names and table nodes live in the load's arena.
+class name_registry
+{
+public:
+  explicit name_registry(load_arena &arena);
+
+  void reserve(size_t count);
+
+  // Add every name already in the database, returns the number of calls issued
+  uint32_t seed_database();
+
+  // Record a name that was or will be set without uniquifying it
+  char const * add(ea_t ea, char const *name);
+
+  // Existing name at ea, or null
+  char const * name_at(ea_t ea) const;
+  bool in_use(char const *name) const { return m_names.find(name) != m_names.end(); }
+
+  // Reserve a unique name for ea. On a collision the first suffix is tried,
+  // then a running counter is appended until the name is free.
+  char const * claim(ea_t ea, char const *name, char const *suffix = nullptr);
+
+  uint32_t collisions() const { return m_collisions; }
+
+private:
+  struct name_hash
+  {
+    size_t operator()(char const *name) const;
+  };
+  struct name_equal
+  {
+    bool operator()(char const *a, char const *b) const { return strcmp(a, b) == 0; }
+  };
+
+  load_arena &m_arena;
+  std::unordered_set<char const *, name_hash, name_equal, arena_allocator<char const *> > m_names;
+  std::unordered_map<ea_t, char const *, std::hash<ea_t>, std::equal_to<ea_t>,
+    arena_allocator< std::pair<ea_t const, char const *> > > m_addresses;
+  uint32_t m_collisions;
+};
+
+#endif // #ifndef __NAME_REGISTRY_H__
@@ -0,0 +1,112 @@
+#include "patch_batch.h"
+
+patch_batch::patch_batch()
+  : m_writes(0), m_bytes(0)
+{}
+
+void patch_batch::add_section(uint8_t section, ea_t address, const uint8_t *original, uint32_t size)
+{
+  if ( section >= m_images.size() )
+    m_images.resize(section + 1, section_image{ BADADDR, nullptr, {}, 0, 0 });
+
+  section_image &img = m_images[section];
+  img.m_address     = address;
+  img.m_original    = original;
+  img.m_bytes.assign(original, original + size);
+  img.m_dirty_begin = size;
+  img.m_dirty_end   = 0;
+}
+
+void patch_batch::add_region(uint8_t section, ea_t address, uint32_t size)
+{
+  if ( section >= m_images.size() )
+    m_images.resize(section + 1, section_image{ BADADDR, nullptr, {}, 0, 0 });
+
+  section_image &img = m_images[section];
+  img.m_address     = address;
+  img.m_original    = nullptr;
+  img.m_bytes.assign(size, 0);
+  img.m_dirty_begin = size;
+  img.m_dirty_end   = 0;
+}
+
+section_image * patch_batch::image(uint8_t section, uint32_t offset, uint32_t size)
+{
+  if ( section >= m_images.size() )
+    return nullptr;
+
+  section_image &img = m_images[section];
+  if ( img.m_address == BADADDR || offset > img.m_bytes.size() || size > img.m_bytes.size() - offset )
+    return nullptr;
+
+  // Grow the span that has to be written back
+  if ( offset < img.m_dirty_begin )
+    img.m_dirty_begin = offset;
+  if ( offset + size > img.m_dirty_end )
+    img.m_dirty_end = offset + size;
+  return &img;
+}
+
+bool patch_batch::write16(uint8_t section, uint32_t offset, uint16_t value)
+{
+  section_image *img = this->image(section, offset, 2);
+  if ( img == nullptr )
+    return false;
+
+  uint8_t *p = &img->m_bytes[offset];
+  p[0] = static_cast<uint8_t>(value >> 8);
+  p[1] = static_cast<uint8_t>(value);
+  ++m_writes;
+  return true;
+}
+
+bool patch_batch::write32(uint8_t section, uint32_t offset, uint32_t value)
+{
+  section_image *img = this->image(section, offset, 4);
+  if ( img == nullptr )
+    return false;
+
+  uint8_t *p = &img->m_bytes[offset];
+  p[0] = static_cast<uint8_t>(value >> 24);
+  p[1] = static_cast<uint8_t>(value >> 16);
+  p[2] = static_cast<uint8_t>(value >> 8);
+  p[3] = static_cast<uint8_t>(value);
+  ++m_writes;
+  return true;
+}
+
+bool patch_batch::original32(uint8_t section, uint32_t offset, uint32_t *value) const
+{
+  if ( section >= m_images.size() )
+    return false;
+
+  section_image const &img = m_images[section];
+  if ( img.m_address == BADADDR || offset > img.m_bytes.size() || 4 > img.m_bytes.size() - offset )
+    return false;
+
+  if ( img.m_original == nullptr )
+    *value = 0;
+  else
+    *value = read_be32(img.m_original + offset);
+  return true;
+}
+
+uint32_t patch_batch::commit(load_target &target)
+{
+  uint32_t calls = 0;
+  for ( auto &img : m_images )
+  {
+    if ( img.m_address == BADADDR || img.m_dirty_begin >= img.m_dirty_end )
+      continue;
+
+    uint32_t size = img.m_dirty_end - img.m_dirty_begin;
+    // File backed sections keep their original bytes
+    target.patch_bytes(img.m_address + img.m_dirty_begin, &img.m_bytes[img.m_dirty_begin], size, img.m_original != nullptr);
+    ++calls;
+    m_bytes += size;
+
+    img.m_dirty_begin = static_cast<uint32_t>(img.m_bytes.size());
+    img.m_dirty_end   = 0;
+  }
+  return calls;
+}
@@ -0,0 +1,53 @@
+#ifndef __PATCH_BATCH_H__
+#define __PATCH_BATCH_H__
+
+#include "rel.h"
+#include "../loader/input_buffer.h"
+#include "../loader/load_plan.h"
+#include <vector>
+
+// In-memory copy of a section's bytes that relocations are applied to
+// before the result is pushed into the database in one write.
+struct section_image
+{
+  ea_t m_address;
+  const uint8_t * m_original;   // bytes from the file, null for regions without file data
+  std::vector<uint8_t> m_bytes;
+  uint32_t m_dirty_begin;
+  uint32_t m_dirty_end;
+};
+
+class patch_batch
+{
+public:
+  patch_batch();
+
+  // Register a section that is backed by file bytes
+  void add_section(uint8_t section, ea_t address, const uint8_t *original, uint32_t size);
+
+  // Register a zero-filled region with no file bytes (e.g. the import stubs)
+  void add_region(uint8_t section, ea_t address, uint32_t size);
+
+  bool write16(uint8_t section, uint32_t offset, uint16_t value);
+  bool write32(uint8_t section, uint32_t offset, uint32_t value);
+
+  // Value of a dword before any relocation was applied
+  bool original32(uint8_t section, uint32_t offset, uint32_t *value) const;
+
+  // Push every modified image to the target, returns the number of calls issued
+  uint32_t commit(load_target &target);
+
+  uint32_t writes() const { return m_writes; }
+
+  // Bytes pushed to the target by commit()
+  uint64_t bytes() const { return m_bytes; }
+
+private:
+  section_image * image(uint8_t section, uint32_t offset, uint32_t size);
+
+  std::vector<section_image> m_images;
+  uint32_t m_writes;
+  uint64_t m_bytes;
+};
+
+#endif // #ifndef __PATCH_BATCH_H__
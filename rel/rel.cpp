@@ -6,6 +6,11 @@
 
 #include "rel.h"
 #include "rel_track.h"
+#include "../loader/probe.h"
+#include "../loader/compression.h"
+#include "../loader/disc_image.h"
+#include "../loader/u8_archive.h"
+#include <memory>
 
 
 /*-----------------------------------------------------------------
@@ -18,14 +23,43 @@
 
 int idaapi accept_file(qstring *fileFormatName, qstring *processor, linput_t *li, const char *filename)
 {
-  rel_track test_valid(li);
-
-  // Check if valid
-  if (!test_valid.is_good())
+  // Check the header and section table without fully parsing the module
+  uint8_t block[PROBE_BLOCK_SIZE];
+  size_t size = probe_read(li, block);
+
+  // Modules can be loaded straight from a disc image, one is picked on load
+  if (probe_disc(block, size, qlsize(li)))
+  {
+    fileFormatName->sprnt("Nintendo REL (disc image)");
+    processor->sprnt("PPC");
+    return(ACCEPT_FIRST | 0xD07);
+  }
+
+  // Compressed modules are checked on their first decompressed bytes
+  uint8_t unpacked[PROBE_UNPACK_SIZE];
+  uint64_t unpacked_size;
+  size_t unpacked_count = probe_unpack(li, block, size, unpacked, &unpacked_size);
+
+  // The same for U8 archives, which are usually compressed as a whole
+  if (unpacked_count != 0 ? probe_archive(unpacked, unpacked_count, unpacked_size) : probe_archive(block, size, qlsize(li)))
+  {
+    fileFormatName->sprnt("Nintendo REL (U8 archive)");
+    processor->sprnt("PPC");
+    return(ACCEPT_FIRST | 0xD07);
+  }
+  if (unpacked_count != 0)
+  {
+    if (!probe_rel(nullptr, unpacked, unpacked_count, unpacked_size))
+      return 0;
+  }
+  else if (!probe_rel(li, block, size, qlsize(li)))
     return 0;
 
   // file has passed all sanity checks and might be a rel
-  fileFormatName->sprnt("Nintendo REL");
+  if (unpacked_count != 0)
+    fileFormatName->sprnt("Nintendo REL (%s)", compression_name(compression_detect(block, size)));
+  else
+    fileFormatName->sprnt("Nintendo REL");
   processor->sprnt("PPC");
 
   return(ACCEPT_FIRST | 0xD07);
@@ -55,13 +89,46 @@ void idaapi load_file(linput_t *fp, ushort neflag, const char * /*fileformatname
 
     set_compiler_id(COMP_GNU);
 
-    rel_track track(fp);
-    inf.start_ea = track.get_base_address();
+    // From a disc image, the module is read from its place in the image and
+    // its siblings from the disc's FST. From a U8 archive, the module is a
+    // part of the archive in memory and its siblings are the directory's.
+    uint8_t block[PROBE_BLOCK_SIZE];
+    size_t size = probe_read(fp, block);
+    uint8_t unpacked[PROBE_UNPACK_SIZE];
+    uint64_t unpacked_size;
+    size_t unpacked_count = probe_unpack(fp, block, size, unpacked, &unpacked_size);
+    disc_image disc;
+    u8_archive archive;
+    disc_file const *file = nullptr;
+    bool from_disc = probe_disc(block, size, qlsize(fp));
+    bool from_archive = unpacked_count != 0 ? probe_archive(unpacked, unpacked_count, unpacked_size) : probe_archive(block, size, qlsize(fp));
+    if (from_disc)
+    {
+        if (!disc.open(fp) || (file = ask_disc_file(disc, ".rel;.rel.szs", "REL")) == nullptr)
+            qexit(1);
+        msg("REL: Loading %s from disc %s\n", file->m_path.c_str(), disc.game_id());
+    }
+    else if (from_archive)
+    {
+        char name[QMAXPATH] = {};
+        get_root_filename(name, sizeof(name));
+        input_buffer buffer;
+        if (!buffer.read(fp) || !archive.open(buffer, name) || (file = ask_archive_file(archive, ".rel;.rel.szs", "REL")) == nullptr)
+            qexit(1);
+        msg("REL: Loading %s from archive %s\n", file->m_path.c_str(), name);
+    }
+
+    std::unique_ptr<rel_track> track(file == nullptr ? new rel_track(fp) :
+                                     from_archive ? new rel_track(archive.contents(*file)) :
+                                     new rel_track(disc.input(), file->m_offset, file->m_size));
+    if (from_disc)
+        track->set_disc(&disc, disc.input());
+    inf.start_ea = track->get_base_address();
 
     // map selector 1 to 0
     set_selector(1, 0);
 
-    track.apply_patches();
+    track->apply_patches();
 }
 
 /*-----------------------------------------------------------------
@@ -75,5 +142,7 @@ extern "C" loader_t LDSC = {
   0, /* no loader flags */
   accept_file,
   load_file,
+  NULL,           /* save_file */
+  rel_move_segm,  /* patches the relocations when the program is rebased */
   NULL,
 };
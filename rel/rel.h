@@ -11,6 +11,7 @@
 #define START_DEFAULT  0x80500000
 
 #include "../loader/idaloader.h"
+#include "../loader/be_view.h"
 
 #include <cstdint>
 #include <string>
@@ -75,17 +76,79 @@ typedef struct {
   uint32_t fix_size;
 } relhdr;
 
+static_assert(sizeof(relhdr) == 0x4C, "relhdr layout");
+
+// Big endian view of a relhdr inside the file
+class relhdr_view : public be_view
+{
+public:
+  explicit relhdr_view(const uint8_t *base) : be_view(base) {}
+
+  uint32_t id() const                 { return field<uint32_t, 0x00>(); }
+  uint32_t prev() const               { return field<uint32_t, 0x04>(); }
+  uint32_t next() const               { return field<uint32_t, 0x08>(); }
+  uint32_t num_sections() const       { return field<uint32_t, 0x0C>(); }
+  uint32_t section_offset() const     { return field<uint32_t, 0x10>(); }
+  uint32_t name_offset() const        { return field<uint32_t, 0x14>(); }
+  uint32_t name_size() const          { return field<uint32_t, 0x18>(); }
+  uint32_t version() const            { return field<uint32_t, 0x1C>(); }
+
+  // version 1
+  uint32_t bss_size() const           { return field<uint32_t, 0x20>(); }
+  uint32_t rel_offset() const         { return field<uint32_t, 0x24>(); }
+  uint32_t import_offset() const      { return field<uint32_t, 0x28>(); }
+  uint32_t import_size() const        { return field<uint32_t, 0x2C>(); }
+  uint8_t  prolog_section() const     { return field<uint8_t,  0x30>(); }
+  uint8_t  epilog_section() const     { return field<uint8_t,  0x31>(); }
+  uint8_t  unresolved_section() const { return field<uint8_t,  0x32>(); }
+  uint8_t  bss_section() const        { return field<uint8_t,  0x33>(); }
+  uint32_t prolog_offset() const      { return field<uint32_t, 0x34>(); }
+  uint32_t epilog_offset() const      { return field<uint32_t, 0x38>(); }
+  uint32_t unresolved_offset() const  { return field<uint32_t, 0x3C>(); }
+
+  // version 2
+  uint32_t align() const              { return field<uint32_t, 0x40>(); }
+  uint32_t bss_align() const          { return field<uint32_t, 0x44>(); }
+
+  // version 3
+  uint32_t fix_size() const           { return field<uint32_t, 0x48>(); }
+
+  // Size of the header for a given version
+  static uint32_t header_size(uint32_t version)
+  {
+    return version < 2 ? 0x40 : version == 2 ? 0x48 : 0x4C;
+  }
+};
+
 
 typedef struct {
   uint32_t file_offset;
   uint32_t size;
 } section_entry;
 
+class section_entry_view : public be_view
+{
+public:
+  explicit section_entry_view(const uint8_t *base) : be_view(base) {}
+
+  uint32_t file_offset() const { return field<uint32_t, 0x00>(); }
+  uint32_t size() const        { return field<uint32_t, 0x04>(); }
+};
+
 typedef struct {
   uint32_t id;      // module id, maps to id in relhdr_info, 0 = base application
   uint32_t offset;
 } import_entry;
 
+class import_entry_view : public be_view
+{
+public:
+  explicit import_entry_view(const uint8_t *base) : be_view(base) {}
+
+  uint32_t id() const     { return field<uint32_t, 0x00>(); }
+  uint32_t offset() const { return field<uint32_t, 0x04>(); }
+};
+
 #define SECTION_EXEC 0x1
 #define SECTION_OFF(off) (off&~1)
 
@@ -96,6 +159,19 @@ typedef struct {
   uint32_t addend;
 } rel_entry;
 
+static_assert(sizeof(rel_entry) == 8, "rel_entry layout");
+
+class rel_entry_view : public be_view
+{
+public:
+  explicit rel_entry_view(const uint8_t *base) : be_view(base) {}
+
+  uint16_t offset() const  { return field<uint16_t, 0x00>(); }
+  uint8_t  type() const    { return field<uint8_t,  0x02>(); }
+  uint8_t  section() const { return field<uint8_t,  0x03>(); }
+  uint32_t addend() const  { return field<uint32_t, 0x04>(); }
+};
+
 
 #define R_PPC_NONE            0
 #define R_PPC_ADDR32          1     /* S + A */
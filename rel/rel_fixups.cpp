@@ -0,0 +1,306 @@
+#include "rel_fixups.h"
+#include "patch_batch.h"
+#include "reloc_kernels.h"
+#include "rel_track.h"
+#include "../loader/input_buffer.h"
+#include "../loader/load_plan.h"
+#include <bitset>
+#include <sstream>
+#include <unordered_set>
+
+#define REL_FIXUP_MAGIC   0x524C4658 // RLFX
+#define REL_FIXUP_VERSION 2
+
+void rel_fixup_table::add_section(uint8_t section, ea_t address, uint32_t size)
+{
+  m_sections.push_back(rel_fixup_section{ section, address, size });
+}
+
+bool rel_fixup_table::save() const
+{
+  std::vector<uint8_t> out;
+  out.reserve(24 + m_sections.size() * 9 + m_fixups.size() * 11 + m_stubs.size() * 13);
+  put_be32(out, REL_FIXUP_MAGIC);
+  put_be32(out, REL_FIXUP_VERSION);
+  put_be32(out, static_cast<uint32_t>(m_sections.size()));
+  for ( auto const &section : m_sections )
+  {
+    out.push_back(section.m_section);
+    put_be32(out, static_cast<uint32_t>(section.m_address));
+    put_be32(out, section.m_size);
+  }
+  put_be32(out, static_cast<uint32_t>(m_fixups.size()));
+  for ( auto const &fixup : m_fixups )
+  {
+    out.push_back(fixup.m_type);
+    out.push_back(fixup.m_section);
+    put_be32(out, fixup.m_offset);
+    out.push_back(fixup.m_target_section);
+    put_be32(out, fixup.m_target_offset);
+  }
+  put_be32(out, static_cast<uint32_t>(m_base));
+  put_be32(out, static_cast<uint32_t>(m_stubs.size()));
+  for ( auto const &stub : m_stubs )
+  {
+    put_be32(out, stub.m_offset);
+    put_be32(out, stub.m_virtual);
+    put_be32(out, stub.m_addend);
+    out.push_back(stub.m_section);
+  }
+
+  netnode node(REL_FIXUP_NODE, 0, true);
+  if ( !node.setblob(out.data(), out.size(), 0, REL_FIXUP_TAG) )
+    return err_msg("REL: Unable to store the relocation table");
+  return true;
+}
+
+bool rel_fixup_table::load()
+{
+  this->clear();
+
+  netnode node(REL_FIXUP_NODE);
+  if ( node == BADNODE )
+    return false;
+  size_t size = node.blobsize(0, REL_FIXUP_TAG);
+  std::vector<uint8_t> blob(size);
+  if ( size == 0 || node.getblob(blob.data(), &size, 0, REL_FIXUP_TAG) == nullptr )
+    return false;
+
+  be_cursor in(blob.data(), blob.data() + size, blob.data());
+  uint32_t magic, version, sections, fixups;
+  if ( !in.read_u32(&magic) || !in.read_u32(&version) || magic != REL_FIXUP_MAGIC || version != REL_FIXUP_VERSION )
+    return err_msg("REL: The relocation table has an unknown format");
+
+  if ( !in.read_u32(&sections) || sections > in.remaining() / 9 )
+    return err_msg("REL: The relocation table is damaged");
+  m_sections.resize(sections);
+  for ( auto &section : m_sections )
+  {
+    uint32_t address;
+    if ( !in.read_u8(&section.m_section) || !in.read_u32(&address) || !in.read_u32(&section.m_size) )
+    {
+      this->clear();
+      return err_msg("REL: The relocation table is damaged");
+    }
+    section.m_address = address;
+  }
+
+  if ( !in.read_u32(&fixups) || fixups > in.remaining() / 11 )
+  {
+    this->clear();
+    return err_msg("REL: The relocation table is damaged");
+  }
+  reloc_kernel const *kernels = reloc_kernels(RELOC_REBASE);
+  m_fixups.resize(fixups);
+  for ( auto &fixup : m_fixups )
+  {
+    if ( !in.read_u8(&fixup.m_type) || !in.read_u8(&fixup.m_section) || !in.read_u32(&fixup.m_offset) ||
+         !in.read_u8(&fixup.m_target_section) || !in.read_u32(&fixup.m_target_offset) ||
+         kernels[fixup.m_type].m_size == 0 )
+    {
+      this->clear();
+      return err_msg("REL: The relocation table is damaged");
+    }
+  }
+
+  uint32_t base, stubs;
+  if ( !in.read_u32(&base) || !in.read_u32(&stubs) || stubs > in.remaining() / 13 )
+  {
+    this->clear();
+    return err_msg("REL: The relocation table is damaged");
+  }
+  m_base = base;
+  m_stubs.resize(stubs);
+  for ( auto &stub : m_stubs )
+  {
+    in.read_u32(&stub.m_offset);
+    in.read_u32(&stub.m_virtual);
+    in.read_u32(&stub.m_addend);
+    in.read_u8(&stub.m_section);
+  }
+  return true;
+}
+
+int rel_fixup_table::rebase(ea_t from, ea_t to, asize_t size)
+{
+  // How far each section moved, sections without bytes stay at 0
+  ea_t addresses[256] = {};
+  ea_t deltas[256] = {};
+  bool moved = false;
+  for ( auto &section : m_sections )
+  {
+    if ( section.m_size != 0 )
+    {
+      if ( from == BADADDR )
+        deltas[section.m_section] = to;
+      else if ( section.m_address >= from && section.m_address + section.m_size <= from + size )
+        deltas[section.m_section] = to - from;
+      section.m_address += deltas[section.m_section];
+      moved = moved || deltas[section.m_section] != 0;
+    }
+    addresses[section.m_section] = section.m_address;
+  }
+
+  // The siblings are laid out from the base, so it moves with the section
+  // it is in
+  uint32_t base_delta = 0;
+  if ( from == BADADDR )
+    base_delta = static_cast<uint32_t>(to);
+  else if ( m_base >= from && m_base < from + size )
+    base_delta = static_cast<uint32_t>(to - from);
+  if ( !moved && base_delta == 0 )
+    return 0;
+
+  reloc_kernel const *kernels = reloc_kernels(RELOC_REBASE);
+
+  // Only the sites whose value depends on a section that moved: absolute
+  // values when their target moved, relative ones when the distance changed.
+  // The words they write are marked by section and dword index.
+  std::vector<bool> selected(m_fixups.size(), false);
+  std::unordered_set<uint64_t> words;
+  auto mark = [&](rel_fixup const &fixup)
+  {
+    uint64_t first = fixup.m_offset >> 2, last = (fixup.m_offset + kernels[fixup.m_type].m_size - 1) >> 2;
+    for ( uint64_t word = first; word <= last; ++word )
+      words.insert((uint64_t(fixup.m_section) << 32) | word);
+  };
+  for ( size_t i = 0; i < m_fixups.size(); ++i )
+  {
+    rel_fixup const &fixup = m_fixups[i];
+    bool changed = kernels[fixup.m_type].m_relative ? deltas[fixup.m_section] != deltas[fixup.m_target_section] : deltas[fixup.m_target_section] != 0;
+    if ( changed )
+    {
+      selected[i] = true;
+      mark(fixup);
+    }
+  }
+
+  // Relocations sharing a word with one of them are applied again too, so
+  // the last one written still wins
+  for ( bool grown = !words.empty(); grown; )
+  {
+    grown = false;
+    for ( size_t i = 0; i < m_fixups.size(); ++i )
+    {
+      rel_fixup const &fixup = m_fixups[i];
+      if ( selected[i] )
+        continue;
+      uint64_t first = fixup.m_offset >> 2, last = (fixup.m_offset + kernels[fixup.m_type].m_size - 1) >> 2;
+      for ( uint64_t word = first; word <= last && !selected[i]; ++word )
+        selected[i] = words.count((uint64_t(fixup.m_section) << 32) | word) != 0;
+      if ( selected[i] )
+      {
+        mark(fixup);
+        grown = true;
+      }
+    }
+  }
+
+  // The sites are patched in copies of their sections, written back in one go
+  std::bitset<256> sites;
+  for ( size_t i = 0; i < m_fixups.size(); ++i )
+  {
+    if ( selected[i] )
+      sites.set(m_fixups[i].m_section);
+  }
+  patch_batch patches;
+  std::vector< std::vector<uint8_t> > contents;
+  contents.reserve(m_sections.size());
+  for ( auto const &section : m_sections )
+  {
+    if ( !sites.test(section.m_section) || section.m_size == 0 )
+      continue;
+    contents.emplace_back(section.m_size);
+    if ( get_bytes(contents.back().data(), section.m_size, section.m_address) != static_cast<ssize_t>(section.m_size) )
+      return -1;
+    patches.add_section(section.m_section, section.m_address, contents.back().data(), section.m_size);
+  }
+
+  uint32_t patched = 0, skipped = 0;
+  for ( size_t i = 0; i < m_fixups.size(); ++i )
+  {
+    if ( !selected[i] )
+      continue;
+    rel_fixup const &fixup = m_fixups[i];
+    reloc_kernel const &kernel = kernels[fixup.m_type];
+    reloc_args args = { fixup.m_section, fixup.m_offset, addresses[fixup.m_section] + fixup.m_offset,
+      static_cast<uint32_t>(addresses[fixup.m_target_section] + fixup.m_target_offset), 0, 0 };
+    if ( kernel.m_apply != nullptr && kernel.m_apply(patches, args) )
+      ++patched;
+    else
+      ++skipped;
+  }
+  if ( skipped != 0 )
+    msg("REL: %u relocation sites could not be rebased\n", skipped);
+
+  database_target database;
+  patches.commit(database);
+  if ( base_delta != 0 )
+  {
+    m_base += base_delta;
+    this->rename_stubs(addresses[SECTION_IMPORTS], base_delta);
+  }
+  if ( !this->save() )
+    return -1;
+  return static_cast<int>(patched);
+}
+
+// Like rel_track::describe_stub names them
+static std::string stub_address(uint32_t address)
+{
+  std::ostringstream ss;
+  ss << '_' << reinterpret_cast<void*>(address);
+  return ss.str();
+}
+
+void rel_fixup_table::rename_stubs(ea_t stubs, uint32_t delta)
+{
+  uint32_t renamed = 0;
+  for ( auto &stub : m_stubs )
+  {
+    ea_t ea = stubs + stub.m_offset;
+    uint32_t moved = stub.m_virtual + delta;
+
+    // The address in the name, whatever suffix made it unique
+    qstring name;
+    std::string before = stub_address(stub.m_virtual), after = stub_address(moved);
+    size_t at;
+    if ( get_name(&name, ea) > 0 && (at = name.find(before.c_str())) != qstring::npos )
+    {
+      qstring renamed_to = name.substr(0, at);
+      renamed_to += after.c_str();
+      renamed_to += name.substr(at + before.size());
+      if ( set_name(ea, renamed_to.c_str(), SN_FORCE | SN_NOWARN) )
+        ++renamed;
+    }
+
+    char line[MAXSTR], moved_line[MAXSTR];
+    qsnprintf(line, sizeof(line), "addend: %08X; section: %u; virtual: 0x%08X;", stub.m_addend, static_cast<unsigned>(stub.m_section), stub.m_virtual);
+    qsnprintf(moved_line, sizeof(moved_line), "addend: %08X; section: %u; virtual: 0x%08X;", stub.m_addend, static_cast<unsigned>(stub.m_section), moved);
+    qstring text;
+    for ( int n = 0; get_extra_cmt(&text, ea, E_PREV + n) >= 0; ++n )
+    {
+      if ( text == line )
+      {
+        update_extra_cmt(ea, E_PREV + n, moved_line);
+        break;
+      }
+    }
+    stub.m_virtual = moved;
+  }
+  msg("REL: Renamed %u of %u import stubs for the new base\n", renamed, static_cast<uint32_t>(m_stubs.size()));
+}
+
+int idaapi rel_move_segm(ea_t from, ea_t to, asize_t size, const char * /*fileformatname*/)
+{
+  // Databases loaded before the table was kept have nothing to patch
+  rel_fixup_table table;
+  if ( !table.load() )
+    return 1;
+
+  int patched = table.rebase(from, to, size);
+  if ( patched < 0 )
+    return 0;
+  msg("REL: Rebased %d relocation sites\n", patched);
+  return 1;
+}
@@ -0,0 +1,83 @@
+#ifndef __REL_FIXUPS_H__
+#define __REL_FIXUPS_H__
+
+#include "rel.h"
+#include <vector>
+
+// Netnode holding the fixup table of the loaded module, as one blob
+#define REL_FIXUP_NODE "$ rel fixups"
+#define REL_FIXUP_TAG  'F'
+
+// One patched location of a relocation, of a type that writes its site. Both the site and the target are
+// kept relative to their sections, so moving a section only changes the
+// section table and the values are computed again from it.
+struct rel_fixup
+{
+  uint32_t m_offset;          // of the patch site in its section
+  uint32_t m_target_offset;   // addend, or the stub in the import section
+  uint8_t  m_type;
+  uint8_t  m_section;
+  uint8_t  m_target_section;  // SECTION_IMPORTS for imports
+};
+
+// An import stub named after the address of its symbol in a sibling module.
+// The siblings are laid out from the base address of the module, so the
+// address, the name and the comment of the stub follow the base.
+struct rel_fixup_stub
+{
+  uint32_t m_offset;    // in the import section
+  uint32_t m_virtual;   // address of the symbol at the base
+  uint32_t m_addend;
+  uint8_t  m_section;
+};
+
+struct rel_fixup_section
+{
+  uint8_t  m_section;
+  ea_t     m_address;
+  uint32_t m_size;
+};
+
+// Relocations of the loaded module, stored in the database so the module can
+// be rebased without loading it again. A rebase patches only the sites whose
+// value depends on a section that moved, and those sharing a word with them.
+class rel_fixup_table
+{
+public:
+  rel_fixup_table() : m_base(BADADDR) { }
+
+  void clear() { m_base = BADADDR; m_sections.clear(); m_fixups.clear(); m_stubs.clear(); }
+
+  // Sections with their load address, including the import stubs
+  void add_section(uint8_t section, ea_t address, uint32_t size);
+
+  // Base address of the module and the stubs named after a sibling address
+  void set_base(ea_t base) { m_base = base; }
+  void add_stub(rel_fixup_stub const &stub) { m_stubs.push_back(stub); }
+
+  std::vector<rel_fixup> & fixups() { return m_fixups; }
+  std::vector<rel_fixup> const & fixups() const { return m_fixups; }
+
+  // Write the table to, or read it from, REL_FIXUP_NODE
+  bool save() const;
+  bool load();
+
+  // Sections in [from, from + size) were moved to `to`; from is BADADDR when
+  // the whole program moved by `to`. Returns the number of sites patched, or
+  // -1 if they could not be written. Stubs are renamed when the base moved.
+  int rebase(ea_t from, ea_t to, asize_t size);
+
+private:
+  // Names and comments the stubs again for a base moved by delta
+  void rename_stubs(ea_t stubs, uint32_t delta);
+
+  ea_t m_base;
+  std::vector<rel_fixup_section> m_sections;
+  std::vector<rel_fixup> m_fixups;
+  std::vector<rel_fixup_stub> m_stubs;
+};
+
+// The loader's move_segm callback
+int idaapi rel_move_segm(ea_t from, ea_t to, asize_t size, const char *fileformatname);
+
+#endif // #ifndef __REL_FIXUPS_H__
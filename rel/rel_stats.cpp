@@ -0,0 +1,145 @@
+#include "rel_stats.h"
+#include <string>
+
+rel_stats::rel_stats()
+  : m_bytes_patched(0), m_patch_writes(0), m_import_stubs(0)
+  , m_symbols_applied(0), m_symbols_out_of_bounds(0), m_symbols_named(0), m_symbols_unmapped(0), m_symbol_collisions(0)
+  , m_arena_allocations(0), m_arena_bytes(0), m_arena_blocks(0)
+{
+  memset(m_operations, 0, sizeof(m_operations));
+}
+
+void rel_stats::add_import(uint32_t module, uint32_t relocations)
+{
+  if ( m_imports.empty() || m_imports.back().m_module != module )
+    m_imports.push_back(rel_import_stats{ module, 0 });
+
+  m_imports.back().m_relocations += relocations;
+}
+
+char const * relocation_type_name(uint8_t type)
+{
+  switch ( type )
+  {
+  case R_PPC_NONE:            return "R_PPC_NONE";
+  case R_PPC_ADDR32:          return "R_PPC_ADDR32";
+  case R_PPC_ADDR24:          return "R_PPC_ADDR24";
+  case R_PPC_ADDR16:          return "R_PPC_ADDR16";
+  case R_PPC_ADDR16_LO:       return "R_PPC_ADDR16_LO";
+  case R_PPC_ADDR16_HI:       return "R_PPC_ADDR16_HI";
+  case R_PPC_ADDR16_HA:       return "R_PPC_ADDR16_HA";
+  case R_PPC_ADDR14:          return "R_PPC_ADDR14";
+  case R_PPC_ADDR14_BRTAKEN:  return "R_PPC_ADDR14_BRTAKEN";
+  case R_PPC_ADDR14_BRNTAKEN: return "R_PPC_ADDR14_BRNTAKEN";
+  case R_PPC_REL24:           return "R_PPC_REL24";
+  case R_PPC_REL14:           return "R_PPC_REL14";
+  case R_DOLPHIN_NOP:         return "R_DOLPHIN_NOP";
+  case R_DOLPHIN_SECTION:     return "R_DOLPHIN_SECTION";
+  case R_DOLPHIN_END:         return "R_DOLPHIN_END";
+  case R_DOLPHIN_MRKREF:      return "R_DOLPHIN_MRKREF";
+  }
+  return nullptr;
+}
+
+void rel_stats::report(load_phases const &phases, char const *module, uint32_t id) const
+{
+  msg("REL: Load statistics for %s (id %u)\n", module, id);
+  msg("REL:   %-24s %10s %10s %10s\n", "phase", "wall ms", "cpu ms", "db calls");
+  for ( auto const &phase : phases.phases() )
+  {
+    std::string name(phase.m_depth * 2, ' ');
+    name += phase.m_name;
+    msg("REL:   %-24s %10.3f %10.3f %10llu\n", name.c_str(), phase.m_wall_ms, phase.m_cpu_ms, static_cast<unsigned long long>(phase.m_db_calls));
+  }
+
+  for ( unsigned type = 0; type < 256; ++type )
+  {
+    if ( m_operations[type] == 0 )
+      continue;
+    char const *name = relocation_type_name(static_cast<uint8_t>(type));
+    if ( name != nullptr )
+      msg("REL:   %-24s %10u\n", name, m_operations[type]);
+    else
+      msg("REL:   type %-19u %10u\n", type, m_operations[type]);
+  }
+
+  for ( auto const &import : m_imports )
+    msg("REL:   imports from %-11u %10u relocations\n", import.m_module, import.m_relocations);
+
+  msg("REL:   %llu bytes patched from %u writes, %u import stubs\n",
+    static_cast<unsigned long long>(m_bytes_patched), m_patch_writes, m_import_stubs);
+  msg("REL:   symbols: %u applied, %u out of bounds, %u already named, %u in unmapped sections, %u collisions\n",
+    m_symbols_applied, m_symbols_out_of_bounds, m_symbols_named, m_symbols_unmapped, m_symbol_collisions);
+  msg("REL:   arena: %llu allocations, %llu bytes in %u blocks\n",
+    static_cast<unsigned long long>(m_arena_allocations), static_cast<unsigned long long>(m_arena_bytes), m_arena_blocks);
+  msg("REL:   %llu database calls in total\n", static_cast<unsigned long long>(phases.db_calls()));
+}
+
+static void json_string(FILE *fp, char const *text)
+{
+  qfprintf(fp, "\"");
+  for ( char const *p = text; *p != '\0'; ++p )
+  {
+    unsigned char c = static_cast<unsigned char>(*p);
+    if ( c == '"' || c == '\\' )
+      qfprintf(fp, "\\%c", c);
+    else if ( c < 0x20 )
+      qfprintf(fp, "\\u%04x", c);
+    else
+      qfprintf(fp, "%c", c);
+  }
+  qfprintf(fp, "\"");
+}
+
+bool rel_stats::write_json(char const *path, load_phases const &phases, char const *module, uint32_t id) const
+{
+  FILE *fp = fopenWT(path);
+  if ( fp == nullptr )
+    return err_msg("REL: Unable to write the load statistics to %s", path);
+
+  qfprintf(fp, "{\n  \"module\": ");
+  json_string(fp, module);
+  qfprintf(fp, ",\n  \"id\": %u,\n  \"phases\": [", id);
+  bool first = true;
+  for ( auto const &phase : phases.phases() )
+  {
+    qfprintf(fp, "%s\n    { \"name\": ", first ? "" : ",");
+    json_string(fp, phase.m_name);
+    qfprintf(fp, ", \"depth\": %u, \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"db_calls\": %llu }",
+      phase.m_depth, phase.m_wall_ms, phase.m_cpu_ms, static_cast<unsigned long long>(phase.m_db_calls));
+    first = false;
+  }
+
+  qfprintf(fp, "\n  ],\n  \"relocations\": {");
+  first = true;
+  for ( unsigned type = 0; type < 256; ++type )
+  {
+    if ( m_operations[type] == 0 )
+      continue;
+    char const *name = relocation_type_name(static_cast<uint8_t>(type));
+    if ( name != nullptr )
+      qfprintf(fp, "%s\n    \"%s\": %u", first ? "" : ",", name, m_operations[type]);
+    else
+      qfprintf(fp, "%s\n    \"%u\": %u", first ? "" : ",", type, m_operations[type]);
+    first = false;
+  }
+
+  qfprintf(fp, "\n  },\n  \"imports\": [");
+  first = true;
+  for ( auto const &import : m_imports )
+  {
+    qfprintf(fp, "%s\n    { \"module\": %u, \"relocations\": %u }", first ? "" : ",", import.m_module, import.m_relocations);
+    first = false;
+  }
+
+  qfprintf(fp, "\n  ],\n  \"bytes_patched\": %llu,\n  \"patch_writes\": %u,\n  \"import_stubs\": %u,\n",
+    static_cast<unsigned long long>(m_bytes_patched), m_patch_writes, m_import_stubs);
+  qfprintf(fp, "  \"symbols\": { \"applied\": %u, \"out_of_bounds\": %u, \"already_named\": %u, \"unmapped\": %u, \"collisions\": %u },\n",
+    m_symbols_applied, m_symbols_out_of_bounds, m_symbols_named, m_symbols_unmapped, m_symbol_collisions);
+  qfprintf(fp, "  \"arena\": { \"allocations\": %llu, \"bytes\": %llu, \"blocks\": %u },\n",
+    static_cast<unsigned long long>(m_arena_allocations), static_cast<unsigned long long>(m_arena_bytes), m_arena_blocks);
+  qfprintf(fp, "  \"db_calls\": %llu\n}\n", static_cast<unsigned long long>(phases.db_calls()));
+
+  qfclose(fp);
+  return true;
+}
@@ -0,0 +1,52 @@
+#ifndef __REL_STATS_H__
+#define __REL_STATS_H__
+
+#include "rel.h"
+#include "../loader/load_phases.h"
+#include <vector>
+
+// Set this environment variable to write the statistics of every load to
+// <idb>.load.json next to the database
+#define REL_STATS_ENV "REL_LOADER_STATS"
+
+struct rel_import_stats
+{
+  uint32_t m_module;
+  uint32_t m_relocations;   // relocations that patch a location, not section switches
+};
+
+// Counters gathered while a REL is loaded, reported together with the time
+// spent in each phase
+struct rel_stats
+{
+  rel_stats();
+
+  // Relocations of one import table entry, consecutive entries of a module are merged
+  void add_import(uint32_t module, uint32_t relocations);
+
+  uint32_t m_operations[256];      // relocation operations by type
+  std::vector<rel_import_stats> m_imports;
+  uint64_t m_bytes_patched;
+  uint32_t m_patch_writes;
+  uint32_t m_import_stubs;
+
+  uint32_t m_symbols_applied;
+  uint32_t m_symbols_out_of_bounds;
+  uint32_t m_symbols_named;        // the address already had a name
+  uint32_t m_symbols_unmapped;     // the section is missing from the memory map
+  uint32_t m_symbol_collisions;
+
+  uint64_t m_arena_allocations;    // transient allocations served by the load arena
+  uint64_t m_arena_bytes;
+  uint32_t m_arena_blocks;
+
+  // Summary table in the output window
+  void report(load_phases const &phases, char const *module, uint32_t id) const;
+
+  bool write_json(char const *path, load_phases const &phases, char const *module, uint32_t id) const;
+};
+
+// Name of a relocation type, or null for unknown types
+char const * relocation_type_name(uint8_t type);
+
+#endif // #ifndef __REL_STATS_H__
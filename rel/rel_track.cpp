@@ -1,4 +1,7 @@
 #include "rel_track.h"
+#include "patch_batch.h"
+#include "reloc_kernels.h"
+#include "symbol_map.h"
 #include "../dol/dol_track.h"
 #include <string>
 #include <sstream>
@@ -6,18 +9,78 @@
 #include <fstream>
 #include <utility>
 #include <algorithm>
-#include <set>
+#include <atomic>
+#include <cstdarg>
+#include <thread>
 
 rel_track::rel_track()
   : m_valid(false)
+  , m_dol_file_loaded(false)
+  , m_max_filesize(0)
+  , m_imports(arena_allocator<import_module>(&m_arena))
+  , m_names(m_arena)
+  , m_target(&m_database)
 {}
 
 rel_track::rel_track(linput_t *p_input)
+ : rel_track(p_input, 0, static_cast<uint64_t>(qlsize(p_input)))
+{}
+
+rel_track::rel_track(linput_t *p_input, uint64_t offset, uint64_t size)
+ : m_valid(false)
+ , m_dol_file_loaded(false)
+ , m_max_filesize(0)
+ , m_imports(arena_allocator<import_module>(&m_arena))
+ , m_names(m_arena)
+ , m_target(&m_database)
+{
+  // Pull the whole module into memory with a single read
+  size_t phase = m_phases.begin("read");
+  bool read = m_buffer.read(p_input, offset, size);
+  m_phases.end(phase);
+  if (!read)
+  {
+    err_msg("REL: Unable to read the input file");
+    return;
+  }
+
+  if (this->unpack())
+    this->parse();
+}
+
+rel_track::rel_track(input_buffer const &buffer)
  : m_valid(false)
- , m_max_filesize( qlsize(p_input) )
- , m_input_file(p_input)
  , m_dol_file_loaded(false)
+ , m_max_filesize(0)
+ , m_buffer(buffer)
+ , m_imports(arena_allocator<import_module>(&m_arena))
+ , m_names(m_arena)
+ , m_target(&m_database)
+{
+  if (this->unpack())
+    this->parse();
+}
+
+bool rel_track::unpack()
+{
+  // Compressed modules are decompressed in memory
+  if (m_buffer.compression() == COMPRESSION_NONE)
+    return true;
+
+  size_t phase = m_phases.begin("unpack");
+  bool unpacked = m_buffer.unpack();
+  m_phases.end(phase);
+  if (!unpacked)
+    return false;
+  msg("REL: Decompressed %u bytes to %u\n", static_cast<uint32_t>(m_buffer.packed_size()), static_cast<uint32_t>(m_buffer.size()));
+  return true;
+}
+
+void rel_track::parse()
 {
+  load_phase_scope phase(m_phases, "header");
+  m_max_filesize = static_cast<uint32_t>(m_buffer.size());
+
   // Read full header
   if (!this->read_header())
   {
@@ -48,46 +111,41 @@ uint32_t rel_track::get_base_address() {
 
 bool rel_track::read_header()
 {
-  // Read header data from input
-  relhdr base_header;
-  qlseek(m_input_file, 0, SEEK_SET);
-  if (qlread(m_input_file, &base_header, sizeof(base_header)) != sizeof(base_header))
+  // Parse the header straight out of the input buffer
+  if (!m_buffer.contains(0, relhdr_view::header_size(1)))
     return err_msg("REL: header is too short or inaccessible");
 
-  // Convert all members from big endian to little endian
-  m_id             = swap32(base_header.info.id);
-  m_num_sections   = swap32(base_header.info.num_sections);
-  m_section_offset = swap32(base_header.info.section_offset);
-  m_version        = swap32(base_header.info.version);
-
-  // This data is currently unhandled
-  //m_base_header.info.prev           = swap32(base_header.info.prev);
-  //m_base_header.info.next           = swap32(base_header.info.next);
-  //m_base_header.info.name_offset    = swap32(base_header.info.name_offset); // ignore
-  //m_base_header.info.name_size      = swap32(base_header.info.name_size);   // ignore
-  m_rel_offset    = swap32(base_header.rel_offset);
-
-  m_import_offset = swap32(base_header.import_offset);
-  m_import_size   = swap32(base_header.import_size);
-  
-  m_bss_section_ign = base_header.bss_section;
-  m_bss_size        = swap32(base_header.bss_size);
-  
-  m_prolog_prep.m_offset     = swap32(base_header.prolog_offset);
-  m_prolog_prep.m_section_id = base_header.prolog_section;
+  relhdr_view hdr(m_buffer.data());
+  m_id             = hdr.id();
+  m_num_sections   = hdr.num_sections();
+  m_section_offset = hdr.section_offset();
+  m_version        = hdr.version();
 
-  m_epilog_prep.m_offset     = swap32(base_header.epilog_offset);
-  m_epilog_prep.m_section_id = base_header.epilog_section;
+  // This data is currently unhandled: prev, next, name_offset, name_size
+  m_rel_offset    = hdr.rel_offset();
 
-  m_unresolved_prep.m_offset      = swap32(base_header.unresolved_offset);
-  m_unresolved_prep.m_section_id  = base_header.unresolved_section;
+  m_import_offset = hdr.import_offset();
+  m_import_size   = hdr.import_size();
 
-  // TODO: v2 check
-  //m_base_header.align               = swap32(base_header.align);
-  //m_base_header.bss_align           = swap32(base_header.bss_align);
-  
-  // TODO: v3 check
-  //m_base_header.fix_size            = swap32(base_header.fix_size);
+  m_bss_section_ign = hdr.bss_section();
+  m_bss_size        = hdr.bss_size();
+
+  m_prolog_prep.m_offset     = hdr.prolog_offset();
+  m_prolog_prep.m_section_id = hdr.prolog_section();
+
+  m_epilog_prep.m_offset     = hdr.epilog_offset();
+  m_epilog_prep.m_section_id = hdr.epilog_section();
+
+  m_unresolved_prep.m_offset      = hdr.unresolved_offset();
+  m_unresolved_prep.m_section_id  = hdr.unresolved_section();
+
+  // Later versions extend the header
+  if (!m_buffer.contains(0, get_header_size()))
+    return err_msg("REL: header is too short for version %u", m_version);
+
+  m_align     = m_version >= 2 ? hdr.align() : 0;
+  m_bss_align = m_version >= 2 ? hdr.bss_align() : 0;
+  m_fix_size  = m_version >= 3 ? hdr.fix_size() : 0;
 
   return true;
 }
@@ -95,17 +153,16 @@ bool rel_track::read_header()
 bool rel_track::read_sections()
 {
   // Read each section
-  qlseek(m_input_file, m_section_offset, SEEK_SET);
+  if (!m_buffer.contains(m_section_offset, m_num_sections * sizeof(section_entry)))
+    return err_msg("REL: Failed to read the section table");
+
   for (unsigned i = 0; i < m_num_sections; ++i)
   {
     // read an entry
+    section_entry_view view(m_buffer.data() + m_section_offset + i * sizeof(section_entry));
     section_entry entry;
-    if (qlread(m_input_file, &entry, sizeof(entry)) != sizeof(entry))
-      return err_msg("REL: Failed to read section %u", i);
-
-    // Swap endianness
-    entry.file_offset  = swap32(entry.file_offset);
-    entry.size    = swap32(entry.size);
+    entry.file_offset = view.file_offset();
+    entry.size        = view.size();
 
     if (entry.file_offset == 0 && entry.size != 0)   // bss
     {
@@ -125,18 +182,7 @@ bool rel_track::read_sections()
 
 uint32_t rel_track::get_header_size() const
 {
-    if (m_version < 2)
-    {
-        return 0x40;
-    }
-    else if (m_version == 2)
-    {
-        return 0x48;
-    }
-    else
-    {
-        return 0x4C;
-    }
+    return relhdr_view::header_size(m_version);
 }
 
 bool rel_track::validate_header() const
@@ -177,31 +223,64 @@ bool rel_track::is_good() const
   return nullptr;
 }*/
 
-ea_t rel_track::section_address(uint8_t section, uint32_t offset) const
+bool rel_track::apply_patches(bool dry_run)
 {
-  auto it = m_section_address_map.find(section);
-  if ( it == m_section_address_map.end() )
-    return BADADDR;
-  return it->second + offset;
+  bool applied = this->apply_phases(dry_run);
+
+  m_stats.m_arena_allocations = m_arena.allocations();
+  m_stats.m_arena_bytes = m_arena.bytes();
+  m_stats.m_arena_blocks = static_cast<uint32_t>(m_arena.blocks());
+
+  // Summarize where the time went
+  std::string module = this->module_name(m_id);
+  m_stats.report(m_phases, module.c_str(), m_id);
+
+  if ( qgetenv(REL_STATS_ENV) )
+  {
+    std::string path = get_path(PATH_TYPE_IDB);
+    size_t dot = path.find_last_of("./\\");
+    if ( dot != std::string::npos && path[dot] == '.' )
+      path.resize(dot);
+    path += ".load.json";
+    if ( m_stats.write_json(path.c_str(), m_phases, module.c_str(), m_id) )
+      msg("REL: Load statistics written to %s\n", path.c_str());
+  }
+
+  return applied;
 }
 
-bool rel_track::apply_patches(bool dry_run)
+bool rel_track::apply_phases(bool dry_run)
 {
-  if ( !this->create_sections(dry_run) )
-    return err_msg("Creating sections failed");
+  m_plan.clear();
+  m_target = dry_run ? static_cast<load_target *>(&m_plan) : &m_database;
 
-  if ( !this->apply_relocations(dry_run) )
-    return err_msg("Relocations failed");
+  {
+    load_phase_scope phase(m_phases, "sections");
+    if ( !this->create_sections(dry_run) )
+      return err_msg("Creating sections failed");
+  }
+
+  {
+    load_phase_scope phase(m_phases, "relocations");
+    if ( !this->apply_relocations(dry_run) )
+      return err_msg("Relocations failed");
+  }
 
   // TODO: Create Imports
 
   // TODO: Assign function names
-  if ( !this->apply_names(dry_run) )
-    return err_msg("Naming failed");
+  {
+    load_phase_scope phase(m_phases, "names");
+    if ( !this->apply_names(dry_run) )
+      return err_msg("Naming failed");
+  }
 
   // Assign function names
-  if (!this->apply_symbols(dry_run)) {
-      return err_msg("Function naming failed!");
+  {
+    load_phase_scope phase(m_phases, "symbols");
+    if (!this->apply_symbols(dry_run)) {
+        return err_msg("Function naming failed!");
+    }
   }
 
   return true;
@@ -209,7 +288,9 @@ bool rel_track::apply_patches(bool dry_run)
 
 
 bool rel_track::create_sections(bool dry_run) {
-    if (!ask_addr(&m_next_seg_offset, "Enter a base address for this module."))
+    if (dry_run)
+        m_next_seg_offset = m_base_address;
+    else if (!ask_addr(&m_next_seg_offset, "Enter a base address for this module."))
         m_next_seg_offset = START_DEFAULT;
     else
         m_base_address = m_next_seg_offset;
@@ -219,7 +300,7 @@ bool rel_track::create_sections(bool dry_run) {
         auto& entry = m_sections[i];
 
         // Add every section to the section address map.
-        m_section_address_map[i] = entry.size == 0 ? 0 : m_next_seg_offset;
+        m_section_addresses.set(static_cast<uint8_t>(i), entry.size == 0 ? 0 : m_next_seg_offset);
 
         // Skip unused
         if ( entry.file_offset == 0 && entry.size == 0 ) continue;
@@ -228,317 +309,692 @@ bool rel_track::create_sections(bool dry_run) {
         std::string name = (entry.file_offset & SECTION_EXEC) ? NAME_CODE : NAME_DATA;
         name += std::to_string(static_cast<unsigned long long>(i));
 
-        m_segment_address_map[i] = m_next_seg_offset;   // record the loaded segment address
+        m_segment_addresses.set(static_cast<uint8_t>(i), m_next_seg_offset);   // record the loaded segment address
         uint32_t foffset = SECTION_OFF(entry.file_offset);
 
         // Create the segment
         if ( foffset != 0 ) { // known segment
-            if (!add_segm(1, m_next_seg_offset, m_next_seg_offset + entry.size, name.c_str(), type.c_str()))
+            if (!m_target->add_segment(m_next_seg_offset, m_next_seg_offset + entry.size, name.c_str(), type.c_str()))
                 return err_msg("Failed to create segment #%u", i);
 
-            if (!file2base(m_input_file, foffset, m_next_seg_offset, m_next_seg_offset + entry.size, FILEREG_PATCHABLE))
+            if (!m_target->load_bytes(m_next_seg_offset, m_buffer.data() + foffset, entry.size, foffset))
                 return err_msg("Failed to pull data from file (segment #%u)", i);
+            m_phases.count_db(2);
         }
         else { // .bss section
             m_internal_bss_section = i;
 
-            if (!add_segm(1, m_next_seg_offset, m_next_seg_offset + entry.size, NAME_BSS, CLASS_BSS))
+            if (!m_target->add_segment(m_next_seg_offset, m_next_seg_offset + entry.size, NAME_BSS, CLASS_BSS))
                 return err_msg("Failed to create BSS segment #%u", i);
+            m_phases.count_db();
         }
 
-        set_segm_addressing(getseg(m_next_seg_offset), 1);
+        // add_segment also sets the addressing (getseg and set_segm_addressing)
+        m_phases.count_db(2);
         m_next_seg_offset += entry.size;
     }
     return true;
 }
 
+// Decode one big endian relocation operation
+static bool read_rel_entry(be_cursor &stream, rel_entry *rel)
+{
+  if (stream.remaining() < sizeof(rel_entry))
+    return false;
+
+  rel_entry_view view(stream.ptr());
+  rel->offset  = view.offset();
+  rel->type    = view.type();
+  rel->section = view.section();
+  rel->addend  = view.addend();
+  return stream.skip(sizeof(rel_entry));
+}
+
+// Stream target over a fixed buffer, so the import names are formatted the
+// way they always were without allocating a string per name
+class name_buffer : public std::streambuf
+{
+public:
+  name_buffer() { reset(); }
+
+  void reset() { setp(m_text, m_text + sizeof(m_text) - 1); }
+  char const * c_str() { *pptr() = '\0'; return m_text; }
+
+private:
+  char m_text[MAXSTR];
+};
+
+// Formats into log when it is set, otherwise into the output window
+static void log_msg(std::string *log, const char *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  if ( log == nullptr )
+  {
+    vmsg(format, va);
+  }
+  else
+  {
+    char buf[MAXSTR];
+    qvsnprintf(buf, sizeof(buf), format, va);
+    log->append(buf);
+  }
+  va_end(va);
+}
+
+void rel_track::decode_streams(arena_vector<rel_stream> &streams, patch_batch &patches) const
+{
+  // Every self stream goes to the first task, so only one worker writes to
+  // the section images. External streams only read the module table.
+  std::vector< std::vector<size_t> > tasks(1);
+  for (size_t i = 0; i < streams.size(); ++i)
+  {
+    if (streams[i].m_entry.id == m_id)
+      tasks[0].push_back(i);
+    else
+      tasks.push_back(std::vector<size_t>(1, i));
+  }
+
+  // Streams are laid out back to back, the distance to the next one bounds
+  // the number of operations in each
+  std::vector<uint32_t> starts;
+  for (auto const &stream : streams)
+    starts.push_back(stream.m_entry.offset);
+  std::sort(starts.begin(), starts.end());
+  for (auto &stream : streams)
+  {
+    auto next_start = std::upper_bound(starts.begin(), starts.end(), stream.m_entry.offset);
+    uint32_t end = next_start != starts.end() ? *next_start : m_max_filesize;
+    stream.m_extent = end > stream.m_entry.offset ? end - stream.m_entry.offset : 0;
+  }
+
+  std::atomic<size_t> next(0);
+  auto worker = [&]()
+  {
+    for ( size_t t; (t = next.fetch_add(1)) < tasks.size(); )
+    {
+      for ( size_t i : tasks[t] )
+      {
+        rel_stream &stream = streams[i];
+        stream.m_ok = stream.m_entry.id == m_id ? this->decode_self(stream, patches) : this->decode_imports(stream);
+        if (!stream.m_ok)
+          break;
+      }
+    }
+  };
+
+  // Relocation data is at the end of the file
+  uint32_t data_size = m_rel_offset < m_max_filesize ? m_max_filesize - m_rel_offset : 0;
+  unsigned hardware = std::thread::hardware_concurrency();
+  unsigned threads = 1;
+  if ( data_size >= REL_PARALLEL_THRESHOLD && hardware > 1 )
+    threads = static_cast<unsigned>(std::min<size_t>(hardware, tasks.size()));
+
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for ( unsigned i = 1; i < threads; ++i )
+    pool.emplace_back(worker);
+  worker();
+  for ( std::thread &thread : pool )
+    thread.join();
+
+  msg("REL: Decoded %u relocation streams on %u threads\n", static_cast<uint32_t>(streams.size()), threads);
+}
+
+bool rel_track::decode_self(rel_stream &result, patch_batch &patches) const
+{
+  // Position on the relocations
+  be_cursor stream = m_buffer.cursor(result.m_entry.offset);
+  uint8_t current_section = 0;
+  uint32_t current_offset = 0;
+  ea_t current_base = this->section_address(current_section);   // only changes on R_DOLPHIN_SECTION
+  reloc_kernel const *kernels = reloc_kernels(RELOC_SELF);
+
+  for (;;)
+  {
+    // Read operation
+    rel_entry rel;
+    if (!read_rel_entry(stream, &rel))
+    {
+      result.m_error_offset = static_cast<uint32_t>(stream.tell());
+      return false;
+    }
+
+    ++result.m_operations[rel.type];
+
+    // Kill if it's the end
+    if (rel.type == R_DOLPHIN_END)
+      break;
+
+    current_offset += rel.offset;
+
+    if (rel.type == R_DOLPHIN_SECTION)
+    {
+      current_section = rel.section;
+      current_offset  = 0;
+      current_base    = this->section_address(current_section);
+
+      log_msg(&result.m_log, "REL: Switched to section %u! Section Address = %08X\n", current_section, m_section_addresses[rel.section]);
+      continue;
+    }
+    if (rel.type == R_DOLPHIN_NOP)
+      continue;
+
+    ++result.m_relocations;
+
+    reloc_kernel const &kernel = kernels[rel.type];
+    if (kernel.m_apply == nullptr)
+    {
+      log_msg(&result.m_log, "REL: RELOC TYPE %u UNSUPPORTED\n", rel.type);
+      continue;
+    }
+
+    reloc_args args = { current_section, current_offset, current_base + current_offset,
+      static_cast<uint32_t>(this->section_address(rel.section, rel.addend)), 0, 0 };
+    result.m_unbatched_calls += kernel.m_calls;
+    if (!kernel.m_apply(patches, args))
+      log_msg(&result.m_log, "REL: Relocation site %u:%08X is outside of its section\n", current_section, current_offset);
+    else if (kernel.m_size != 0 && m_section_addresses.valid(rel.section))
+      result.m_fixups.push_back(rel_fixup{ current_offset, rel.addend, rel.type, current_section, rel.section });
+    else if (kernel.m_size != 0)
+      result.m_sites.push_back(reloc_site{ static_cast<uint32_t>(result.m_fixups.size()), current_offset, args.m_value, rel.type, current_section });
+  }
+  return true;
+}
+
+bool rel_track::decode_imports(rel_stream &result) const
+{
+  ext_module const *module = m_imports[result.m_slot].m_module;
+  import_map seen;
+
+  // Read all imports to get the desired size
+  be_cursor stream = m_buffer.cursor(result.m_entry.offset);
+  seen.reserve(result.m_extent / sizeof(rel_entry));
+  for (;;)
+  {
+    // Read operation
+    rel_entry rel;
+    if ( !read_rel_entry(stream, &rel) )
+    {
+      result.m_error_offset = static_cast<uint32_t>(stream.tell());
+      return false;
+    }
+
+    ++result.m_operations[rel.type];
+
+    // Kill if it's the end
+    if (rel.type == R_DOLPHIN_END)
+      break;
+
+    if ( rel.type != R_DOLPHIN_SECTION && rel.type != R_DOLPHIN_NOP )
+    {
+      ++result.m_relocations;
+
+      // Also try to get a unique address for the module offset
+      uint32_t offs = this->get_external_offset(module, rel.addend, rel.section, false, &result.m_log);
+      if ( offs == 0 || offs == 1 )
+        offs = rel.addend + 0x1000000 * rel.section;
+
+      bool inserted;
+      seen.insert(0, offs, 0, &inserted);
+      if ( inserted )
+        result.m_targets.push_back(offs);
+    }
+  }
+  return true;
+}
+
 bool rel_track::apply_relocations(bool dry_run)
 {
+  size_t phase = m_phases.begin("resolvers");
   this->init_resolvers(); // initialize user-names
+  m_phases.end(phase);
 
   // Apply relocations
-  if (m_import_offset > 0)
+  if (m_import_offset == 0)
+    return true;
+
+  msg("Applying REL file relocations! Import table offset: %08X | Relocation entry table offset: %08X\n", m_import_offset, m_rel_offset);
+
+  m_fixups.clear();
+  // A dry run measures and validates the load itself, so it neither reads
+  // nor leaves a cache
+  reloc_result result;
+  if (dry_run || !reloc_cache::enabled())
+  {
+    if (!this->resolve_relocations(&result))
+      return false;
+    if (!dry_run)
+      this->save_fixups(result);
+    return true;
+  }
+
+  // The result only depends on the module, its siblings and where it is loaded
+  phase = m_phases.begin("cache");
+  result.m_key.m_content  = hash_bytes(m_buffer.data(), m_buffer.size());
+  result.m_key.m_siblings = m_external_modules.fingerprint();
+  result.m_key.m_base     = m_base_address;
+  result.m_key.m_stubs    = m_next_seg_offset;
+  reloc_cache cache(this->cache_path());
+  bool cached = cache.find(result.m_key, &result);
+  m_phases.end(phase);
+
+  if (cached)
+  {
+    phase = m_phases.begin("replay");
+    bool replayed = this->replay_relocations(result);
+    m_phases.end(phase);
+    if (!replayed)
+      return false;
+    copy_relocation_stats(result.m_stats, &m_stats);
+    m_fixups.fixups().swap(result.m_fixups);
+    msg("REL: Relocations replayed from %s, %u sites and %u stubs\n", cache.path().c_str(),
+      static_cast<uint32_t>(m_fixups.fixups().size() + result.m_sites.size()), static_cast<uint32_t>(result.m_stubs.size()));
+  }
+  else
+  {
+    if (!this->resolve_relocations(&result))
+      return false;
+    copy_relocation_stats(m_stats, &result.m_stats);
+    result.m_fixups = m_fixups.fixups();
+
+    load_phase_scope store(m_phases, "cache");
+    if (cache.store(result))
+      msg("REL: Relocations cached in %s\n", cache.path().c_str());
+  }
+
+  if (!dry_run)
+    this->save_fixups(result);
+  return true;
+}
+
+void rel_track::add_section_images(patch_batch &patches) const
+{
+  for (size_t i = 0; i < m_sections.size(); ++i)
+  {
+    uint32_t foffset = SECTION_OFF(m_sections[i].file_offset);
+    if (foffset != 0 && m_sections[i].size != 0)
+      patches.add_section(static_cast<uint8_t>(i), this->section_address(static_cast<uint8_t>(i)), m_buffer.data() + foffset, m_sections[i].size);
+  }
+}
+
+bool rel_track::replay_relocations(reloc_result const &result)
+{
+  // The stubs follow the sections
+  uint32_t imp_offset = m_next_seg_offset;
+  m_segment_addresses.set(SECTION_IMPORTS, imp_offset);
+  m_next_seg_offset += result.m_import_size;
+  if (!m_target->add_segment(imp_offset, imp_offset + result.m_import_size, NAME_EXTERN, CLASS_EXTERN))
+    return err_msg("Failed to create XTRN segment");
+  m_phases.count_db(3);
+  m_import_section = static_cast<uint8_t>(m_sections.size());
+
+  patch_batch patches;
+  this->add_section_images(patches);
+  patches.add_region(SECTION_IMPORTS, imp_offset, result.m_import_size);
+
+  // Stubs are named in the order they were, so the names claim the same suffixes
+  name_buffer name_text;
+  std::ostream ss(&name_text);
+  auto stub = result.m_stubs.begin();
+  for (auto const &import : result.m_imports)
   {
-    msg("Applying REL file relocations! Import table offset: %08X | Relocation entry table offset: %08X\n", m_import_offset, m_rel_offset);
-    uint32_t count = m_import_size / sizeof(import_entry);
-    uint32_t desired_import_size = 0;
-    std::map< std::string, std::map<uint32_t, ea_t> > imports_map;
-    std::map< std::string, ea_t > imports_module_starts;
-    std::set<ea_t> described;
+    std::string imp_module_name = this->module_name(import.m_module);
+    m_target->extra_cmt(imp_offset + import.m_start, true, "\nImports from %s\n", imp_module_name.c_str());
+    m_phases.count_db();
+    for (uint32_t i = 0; i < import.m_stubs; ++i, ++stub)
+    {
+      this->describe_stub(imp_module_name, *stub, imp_offset, name_text, ss);
+      if (stub->m_written)
+        patches.write32(SECTION_IMPORTS, stub->m_offset, stub->m_value);
+    }
+  }
 
-    for (unsigned i = 0; i < count; ++i)
+  // Sites without a fixup go between the fixups they were patched between
+  reloc_kernel const *kernels = reloc_kernels(RELOC_SELF);
+  auto site = result.m_sites.begin();
+  std::vector<rel_fixup> const &fixups = result.m_fixups;
+  for (size_t i = 0; i <= fixups.size(); ++i)
+  {
+    for (; site != result.m_sites.end() && site->m_fixup == i; ++site)
     {
-      qlseek(m_input_file, m_import_offset + i*sizeof(import_entry), SEEK_SET);
-
-      // Get the entry
-      import_entry entry;
-      if (qlread(m_input_file, &entry, sizeof(entry)) != sizeof(entry))
-        return err_msg("REL: Failed to read relocation data %u", i);
-      // Endianness
-      entry.offset = swap32(entry.offset);
-      entry.id = swap32(entry.id);
-
-      // Debug info
-      msg("Applying relocations for import %d starting at file offset %08X\n", entry.id, entry.offset);
-
-      // Seek to relocations
-      qlseek(m_input_file, entry.offset, SEEK_SET);
-      uint32_t current_section = 0;
-      uint32_t current_offset = 0;
-      uint32_t value = 0, where = 0, orig = 0;
-
-      // Self-relocations
-      if ( entry.id == m_id )
-      {
-        for (;;)
-        {
-          // Read operation
-          rel_entry rel;
-          if (qlread(m_input_file, &rel, sizeof(rel)) != (sizeof(rel)))
-            return err_msg("REL: Failed to read relocation operation @0x%08X - error code: %d", qltell(m_input_file), get_qerrno());
+      reloc_kernel const &kernel = kernels[site->m_type];
+      reloc_args args = { site->m_section, site->m_offset, this->section_address(site->m_section, site->m_offset), site->m_value, 0, 0 };
+      if (kernel.m_apply == nullptr || !kernel.m_apply(patches, args))
+        return err_msg("REL: Cached relocation site %u:%08X is damaged", site->m_section, site->m_offset);
+    }
+    if (i == fixups.size())
+      break;
+
+    rel_fixup const &fixup = fixups[i];
+    ea_t target = fixup.m_target_section == SECTION_IMPORTS ? imp_offset : this->section_address(fixup.m_target_section);
+    reloc_kernel const &kernel = kernels[fixup.m_type];
+    reloc_args args = { fixup.m_section, fixup.m_offset, this->section_address(fixup.m_section, fixup.m_offset),
+      static_cast<uint32_t>(target + fixup.m_target_offset), 0, 0 };
+    if (kernel.m_apply == nullptr || !kernel.m_apply(patches, args))
+      return err_msg("REL: Cached relocation site %u:%08X is damaged", fixup.m_section, fixup.m_offset);
+  }
+
+  m_phases.count_db(patches.commit(*m_target));
+  return true;
+}
+
+void rel_track::describe_stub(std::string const &module_name, reloc_stub const &stub, ea_t stubs, name_buffer &name_text, std::ostream &ss)
+{
+  ea_t targ_offset = stubs + stub.m_offset;
+  name_text.reset();
+  ss.clear();
+  ss << module_name;
+  if ( stub.m_virtual == 0 )
+  {
+    if ( module_name != BASENAME )
+      ss << "_s" << static_cast<unsigned>(stub.m_section) << '_';
+    ss << reinterpret_cast<void*>(stub.m_addend);
+    m_target->extra_line(targ_offset, true, "addend: %08X; section: %u;", stub.m_addend, static_cast<unsigned>(stub.m_section));
+  }
+  else if ( stub.m_virtual == 1 )
+  {
+    ss << "_s" << static_cast<unsigned>(stub.m_section) << "_bss_" << reinterpret_cast<void*>(stub.m_addend);
+    m_target->extra_line(targ_offset, true, "addend: %08X; section: %u (BSS);", stub.m_addend, static_cast<unsigned>(stub.m_section));
+  }
+  else
+  {
+    ss << '_' << reinterpret_cast<void*>(stub.m_virtual);
+    m_target->extra_line(targ_offset, true, "addend: %08X; section: %u; virtual: 0x%08X;", stub.m_addend, static_cast<unsigned>(stub.m_section), stub.m_virtual);
+  }
+  m_target->set_name(targ_offset, m_names.claim(targ_offset, name_text.c_str()), SN_FORCE | SN_NOWARN);
+  m_phases.count_db(2);
+}
 
-          // endianness
-          rel.addend = swap32(rel.addend);
-          rel.offset = swap16(rel.offset);
+void rel_track::save_fixups(reloc_result const &result)
+{
+  // Every section with its load address, the import stubs included, so a
+  // rebase can tell which of them moved
+  load_phase_scope phase(m_phases, "fixups");
+  for (size_t i = 0; i < m_sections.size(); ++i)
+    m_fixups.add_section(static_cast<uint8_t>(i), this->section_address(static_cast<uint8_t>(i)), m_sections[i].size);
+  ea_t imports = m_segment_addresses[SECTION_IMPORTS];
+  m_fixups.add_section(SECTION_IMPORTS, imports, m_next_seg_offset - imports);
+
+  // The stubs named after an address in a sibling, which moves with the base
+  m_fixups.set_base(m_base_address);
+  for (auto const &stub : result.m_stubs)
+  {
+    if (stub.m_virtual > 1)
+      m_fixups.add_stub({ stub.m_offset, stub.m_virtual, stub.m_addend, stub.m_section });
+  }
 
-          // Kill if it's the end
-          if (rel.type == R_DOLPHIN_END)
-            break;
+  if (m_fixups.save())
+    msg("REL: %u relocation sites kept for rebasing\n", static_cast<uint32_t>(m_fixups.fixups().size()));
+  m_phases.count_db(2);
+}
 
-          current_offset += rel.offset;
+bool rel_track::resolve_relocations(reloc_result *result)
+{
+  size_t phase;
+  uint32_t count = m_import_size / sizeof(import_entry);
+  uint32_t desired_import_size = 0;
+  // Imported modules are interned to slots once per import table entry, so
+  // the relocations only carry the slot into the stub lookup
+  arena_allocator< std::pair<uint32_t const, uint32_t> > slot_allocator(&m_arena);
+  std::map< uint32_t, uint32_t, std::less<uint32_t>, arena_allocator< std::pair<uint32_t const, uint32_t> > > module_slots(slot_allocator);
+  import_map imports(&m_arena);
+  m_imports.clear();
+
+  // Relocations are applied to in-memory copies of the sections, which are
+  // written to the database once everything has been resolved
+  patch_batch patches;
+  this->add_section_images(patches);
+
+  // Number of database calls the per-relocation patching would have issued
+  uint32_t unbatched_calls = 0;
+
+  be_cursor import_table = m_buffer.cursor(m_import_offset);
+
+  // Read the import table, interning the imported modules in table order
+  arena_vector<rel_stream> streams(count, rel_stream(), arena_allocator<rel_stream>(&m_arena));
+  for (unsigned i = 0; i < count; ++i)
+  {
+    // Get the entry
+    if (import_table.remaining() < sizeof(import_entry))
+      return err_msg("REL: Failed to read relocation data %u", i);
 
-          switch (rel.type)
-          {
-          case R_DOLPHIN_SECTION:
-            current_section = rel.section;
-            current_offset  = 0;
-
-            msg("REL: Switched to section %u! Section Address = %08X\n", current_section, m_section_address_map[rel.section]);
-            break;
-          case R_DOLPHIN_NOP:
-            break;
-          case R_PPC_ADDR32:
-            patch_dword( this->section_address(current_section, current_offset), this->section_address(rel.section, rel.addend) );
-            break;
-          case R_PPC_ADDR16_LO:
-            patch_word(this->section_address(current_section, current_offset), this->section_address(rel.section, rel.addend) & 0xFFFF);
-            break;
-          case R_PPC_ADDR16_HA:
-            value = this->section_address(rel.section, rel.addend);
-            if ((value & 0x8000) == 0x8000)
-              value += 0x00010000;
-
-            patch_word(this->section_address(current_section, current_offset), (value >> 16) & 0xFFFF);
-            break;
-          case R_PPC_REL24:
-            where = this->section_address(current_section, current_offset);
-            value = this->section_address(rel.section, rel.addend);
-            value -= where;
-            orig = static_cast<uint32_t>(get_original_dword(where));
-            orig &= 0xFC000003;
-            orig |= value & 0x03FFFFFC;
-            patch_dword(where, orig);
-            break;
-          default:
-            msg("REL: RELOC TYPE %u UNSUPPORTED\n", rel.type);
-          }
+    import_entry_view view(import_table.ptr());
+    rel_stream &stream = streams[i];
+    stream.m_entry.id     = view.id();
+    stream.m_entry.offset = view.offset();
+    import_table.skip(sizeof(import_entry));
 
-        }
-      }
-      else // EXTERNALS
-      {
-        // Retrieve the module name
-        std::string imp_module_name;
-        auto it_modname = m_module_names.find(entry.id);
-        if ( it_modname != m_module_names.end() )
-          imp_module_name = it_modname->second;
-        else if ( entry.id == 0 )
-          imp_module_name = BASENAME;
-        else
-          imp_module_name = std::string("module") + std::to_string(static_cast<unsigned long long>(entry.id));
-
-        // Read all imports to get the desired size
-        for (;;)
-        {
-          // Read operation
-          rel_entry rel;
-          if ( qlread(m_input_file, &rel, sizeof(rel)) != (sizeof(rel)))
-            return err_msg("REL: Failed to read relocation operation @0x%08X, id %u", qltell(m_input_file), entry.id);
+    if ( stream.m_entry.id != m_id )
+    {
+      auto slot_it = module_slots.insert(std::make_pair(stream.m_entry.id, static_cast<uint32_t>(m_imports.size())));
+      if ( slot_it.second )
+        m_imports.push_back(import_module{ stream.m_entry.id, m_external_modules.find(stream.m_entry.id), 0,
+          arena_vector<uint32_t>(arena_allocator<uint32_t>(&m_arena)) });
+      stream.m_slot = slot_it.first->second;
+      m_imports[stream.m_slot].m_streams.push_back(stream.m_entry.offset);
+    }
+  }
 
-          // endianness
-          rel.addend = swap32(rel.addend);
-          rel.offset = swap16(rel.offset);
+  // Self relocations are applied while the imports are decoded
+  phase = m_phases.begin("decode");
+  this->decode_streams(streams, patches);
 
-          // Kill if it's the end
-          if (rel.type == R_DOLPHIN_END)
-            break;
+  // Merge in import table order, so the stubs are laid out exactly as if
+  // the streams had been decoded one after the other
+  for (auto &stream : streams)
+  {
+    // Debug info
+    msg("Applying relocations for import %d starting at file offset %08X\n", stream.m_entry.id, stream.m_entry.offset);
+    if (!stream.m_log.empty())
+      msg("%s", stream.m_log.c_str());
 
-          if ( rel.type != R_DOLPHIN_SECTION && rel.type != R_DOLPHIN_NOP )
-          {
-            // Retrieve target offset for import itself
-            ea_t target_offset = m_next_seg_offset + desired_import_size;
-
-            // Also try to get a unique address for the module offset
-            uint32_t offs = this->get_external_offset(imp_module_name, rel.addend, rel.section);
-            if ( offs == 0 || offs == 1 )
-              offs = rel.addend + 0x1000000 * rel.section;
-
-            // If the address doesn't exist, then add it and get the next import location
-            if ( imports_map[imp_module_name].insert( std::make_pair(offs, target_offset) ).second )
-            {
-              imports_module_starts.insert( std::make_pair(imp_module_name, target_offset) );
-              desired_import_size += 4;
-            }
-          }
+    if (!stream.m_ok)
+    {
+      if (stream.m_entry.id == m_id)
+        return err_msg("REL: Failed to read relocation operation @0x%08X", stream.m_error_offset);
+      return err_msg("REL: Failed to read relocation operation @0x%08X, id %u", stream.m_error_offset, stream.m_entry.id);
+    }
 
-          m_imports[imp_module_name].emplace_back(rel);
-        }
-      }
-    } // for each module
-    
-    // Now create the import/externals section
-    uint32_t imp_offset = m_next_seg_offset;
-    m_segment_address_map[SECTION_IMPORTS] = imp_offset;
-    //section_entry import_section = { m_next_section_offset, desired_import_size };
-    m_next_seg_offset += desired_import_size;
-    
-    if (!add_segm(1, imp_offset, imp_offset + desired_import_size, NAME_EXTERN, CLASS_EXTERN))
-      return err_msg("Failed to create XTRN segment");
-    set_segm_addressing(getseg(imp_offset), 1);
-    
-    m_import_section = static_cast<uint8_t>(m_sections.size());
-    //m_sections.emplace_back(import_section);
+    for (unsigned type = 0; type < 256; ++type)
+      m_stats.m_operations[type] += stream.m_operations[type];
+    m_stats.add_import(stream.m_entry.id, stream.m_relocations);
+    unbatched_calls += stream.m_unbatched_calls;
+
+    if (stream.m_entry.id == m_id)
+    {
+      for (auto &site : stream.m_sites)
+        site.m_fixup += static_cast<uint32_t>(m_fixups.fixups().size());
+      result->m_sites.insert(result->m_sites.end(), stream.m_sites.begin(), stream.m_sites.end());
+      m_fixups.fixups().insert(m_fixups.fixups().end(), stream.m_fixups.begin(), stream.m_fixups.end());
+      std::vector<rel_fixup>().swap(stream.m_fixups);
+      continue;
+    }
+
+    import_module &module = m_imports[stream.m_slot];
+    for (uint32_t offs : stream.m_targets)
+    {
+      // Retrieve target offset for import itself
+      ea_t target_offset = m_next_seg_offset + desired_import_size;
 
-    // Add and parse imports
-    //ea_t targ_offset = this->section_address(m_import_section);
-    for ( auto it = m_imports.begin(); it != m_imports.end(); ++it )
+      // If the address doesn't exist, then add it and get the next import location
+      bool inserted;
+      imports.insert(stream.m_slot, offs, target_offset, &inserted);
+      if ( inserted )
+      {
+        if ( module.m_start == 0 )
+          module.m_start = target_offset;
+        desired_import_size += 4;
+      }
+    }
+    std::vector<uint32_t>().swap(stream.m_targets);
+  } // for each module
+  m_phases.end(phase);
+  
+  // Now create the import/externals section
+  uint32_t imp_offset = m_next_seg_offset;
+  m_segment_addresses.set(SECTION_IMPORTS, imp_offset);
+  //section_entry import_section = { m_next_section_offset, desired_import_size };
+  m_next_seg_offset += desired_import_size;
+  
+  if (!m_target->add_segment(imp_offset, imp_offset + desired_import_size, NAME_EXTERN, CLASS_EXTERN))
+    return err_msg("Failed to create XTRN segment");
+  m_phases.count_db(3);
+  patches.add_region(SECTION_IMPORTS, imp_offset, desired_import_size);
+  
+  m_import_section = static_cast<uint8_t>(m_sections.size());
+  //m_sections.emplace_back(import_section);
+
+  // Add and parse imports
+  phase = m_phases.begin("imports");
+  reloc_kernel const *kernels = reloc_kernels(RELOC_EXTERNAL);
+  //ea_t targ_offset = this->section_address(m_import_section);
+  std::vector<uint32_t> described(desired_import_size / 4, UINT32_MAX);   // index of each stub in result
+  name_buffer name_text;
+  std::ostream ss(&name_text);
+  for ( auto const &slot_entry : module_slots )   // in module id order
+  {
+    uint32_t slot = slot_entry.second;
+    import_module const &module = m_imports[slot];
+    std::string imp_module_name = this->module_name(module.m_id);
+
+    // Add comment for module
+    ea_t target_module_start = module.m_start;
+    if ( target_module_start == 0 )
+      return err_msg("Failed to locate start of module imports.");
+    m_target->extra_cmt( target_module_start, true, "\nImports from %s\n", imp_module_name.c_str() );
+    m_phases.count_db();
+    result->m_imports.push_back(reloc_import{ module.m_id, static_cast<uint32_t>(target_module_start - imp_offset), 0 });
+
+    // Iterate relocation opcodes
+    uint32_t current_offset = 0;
+    uint8_t current_section = 0;
+    ea_t current_base = this->section_address(current_section);
+    for ( uint32_t stream_offset : module.m_streams )
     {
-      // Add comment for module
-      ea_t target_module_start = imports_module_starts[it->first];
-      if ( target_module_start == 0 )
-        return err_msg("Failed to locate start of module imports.");
-      add_extra_cmt( target_module_start, true, "\nImports from %s\n", it->first.c_str() );
-
-      // Iterate relocation opcodes
-      uint32_t current_offset = 0, current_section = 0;
-      for ( auto e = it->second.begin(); e != it->second.end(); ++e )
+      // Decode the stream again, it was validated by the first pass
+      be_cursor stream = m_buffer.cursor(stream_offset);
+      for (;;)
       {
+        rel_entry rel;
+        if ( !read_rel_entry(stream, &rel) )
+          return err_msg("REL: Failed to read relocation operation @0x%08X, id %u", static_cast<uint32_t>(stream.tell()), module.m_id);
+        if ( rel.type == R_DOLPHIN_END )
+          break;
+
         ea_t targ_offset; // this must be initialized for anything that isn't DOLPHIN_SECTION or DOLPHIN_NOP
-        
+    
         // If something is actually going to be done with the target
-        if ( e->type != R_DOLPHIN_SECTION && e->type != R_DOLPHIN_NOP )
+        if ( rel.type != R_DOLPHIN_SECTION && rel.type != R_DOLPHIN_NOP )
         {
           // Retrieve the address that was used to map to the target import
-          uint32_t offs = this->get_external_offset(it->first, e->addend, e->section);
+          uint32_t offs = this->get_external_offset(module.m_module, rel.addend, rel.section);
           if ( offs == 0 || offs == 1 )
-            offs = e->addend + 0x1000000 * e->section;
+            offs = rel.addend + 0x1000000 * rel.section;
 
           // Retrieve the target offset for the import
-          targ_offset = imports_map[it->first][offs];
-          if ( targ_offset == 0 )
-            return err_msg("Import was not mapped correctly. %s %08X", it->first.c_str(), e->addend);
-
-          // Name the import
-          std::ostringstream ss;
-          ss << it->first;
-
-          offs = this->get_external_offset(it->first, e->addend, e->section, true);   // re-obtain offs without the unique address generation
-          if ( offs == 0 )
-          {
-            if ( it->first != BASENAME )
-              ss << "_s" << static_cast<unsigned>(e->section) << '_';
-            ss << reinterpret_cast<void*>(e->addend);
-            if ( described.insert(targ_offset).second )
-              add_extra_line(targ_offset, true, "addend: %08X; section: %u;", e->addend, static_cast<unsigned>(e->section));
-          }
-          else if ( offs == 1 )
+          targ_offset = imports.find(slot, offs);
+          if ( targ_offset == BADADDR )
+            return err_msg("Import was not mapped correctly. %s %08X", imp_module_name.c_str(), rel.addend);
+
+          // Name and describe each import stub the first time it is referenced
+          unbatched_calls += 1;
+          uint32_t stub = static_cast<uint32_t>(targ_offset - imp_offset) / 4;
+          if ( described[stub] == UINT32_MAX )
           {
-            ss << "_s" << static_cast<unsigned>(e->section) << "_bss_" << reinterpret_cast<void*>(e->addend);
-            if ( described.insert(targ_offset).second )
-                add_extra_line(targ_offset, true, "addend: %08X; section: %u (BSS);", e->addend, static_cast<unsigned>(e->section));
+            offs = this->get_external_offset(module.m_module, rel.addend, rel.section, true);   // re-obtain offs without the unique address generation
+            reloc_stub record = { stub * 4, rel.addend, offs, rel.addend, rel.section, false };
+            this->describe_stub(imp_module_name, record, imp_offset, name_text, ss);
+            described[stub] = static_cast<uint32_t>(result->m_stubs.size());
+            result->m_stubs.push_back(record);
+            ++result->m_imports.back().m_stubs;
           }
-          else
-          {
-            ss << '_' << reinterpret_cast<void*>(offs);
-            if ( described.insert(targ_offset).second )
-                add_extra_line(targ_offset, true, "addend: %08X; section: %u; virtual: 0x%08X;", e->addend, static_cast<unsigned>(e->section), offs);
-          }
-          force_name(targ_offset, ss.str().c_str());
         }
 
-        current_offset += e->offset;
-        switch (e->type)
+        current_offset += rel.offset;
+        if ( rel.type == R_DOLPHIN_SECTION )
         {
-        case R_DOLPHIN_SECTION:
-          current_section = e->section;
+          current_section = rel.section;
           current_offset  = 0;
-          break;
-        case R_DOLPHIN_NOP:
-          break;
-        case R_PPC_ADDR32:
-        {
-          patch_dword( this->section_address(current_section, current_offset), targ_offset );
-          put_dword(targ_offset, e->addend);
-          break;
+          current_base    = this->section_address(current_section);
+          continue;
         }
-        case R_PPC_ADDR16_LO:
+        if ( rel.type == R_DOLPHIN_NOP )
+          continue;
+
+        reloc_kernel const &kernel = kernels[rel.type];
+        if ( kernel.m_apply == nullptr )
         {
-          patch_word(this->section_address(current_section, current_offset), targ_offset & 0xFFFF);
-          put_dword(targ_offset, e->addend);
-          break;
+          msg("REL: XTRN RELOC TYPE %u UNSUPPORTED\n", static_cast<unsigned int>(rel.type));
+          continue;
         }
-        case R_PPC_ADDR16_HA:
-        {
-          ea_t value = targ_offset;
-          if ((value & 0x8000) == 0x8000)
-            value += 0x00010000;
 
-          patch_word(this->section_address(current_section, current_offset), (value >> 16) & 0xFFFF);
-          put_dword(targ_offset, e->addend);
-          break;
-        }
-        case R_PPC_REL24:
+        reloc_args args = { current_section, current_offset, current_base + current_offset,
+          static_cast<uint32_t>(targ_offset), static_cast<uint32_t>(targ_offset - imp_offset), rel.addend };
+        unbatched_calls += kernel.m_calls;
+        if ( !kernel.m_apply(patches, args) )
+          msg("REL: Relocation site %u:%08X is outside of its section\n", current_section, current_offset);
+        else if ( kernel.m_size != 0 )
+          m_fixups.fixups().push_back(rel_fixup{ current_offset, targ_offset - imp_offset, rel.type, current_section, SECTION_IMPORTS });
+
+        // The stub is written whether or not the site was
+        if ( kernel.m_size != 0 )
         {
-          ea_t where = this->section_address(current_section, current_offset);
-          ea_t value = targ_offset;
-          value -= where;
-          uint32_t orig = static_cast<uint32_t>(get_original_dword(where));
-          orig &= 0xFC000003;
-          orig |= value & 0x03FFFFFC;
-          patch_dword(where, orig);
-          break;
-        }
-        default:
-          msg("REL: XTRN RELOC TYPE %u UNSUPPORTED\n", static_cast<unsigned int>(e->type));
+          reloc_stub &record = result->m_stubs[described[(targ_offset - imp_offset) / 4]];
+          record.m_written = true;
+          record.m_value = rel.addend;
         }
       }
-    } // for each import
-  }
+    }
+  } // for each import
+  m_phases.end(phase);
+
+  // Write every relocated section back in one go
+  phase = m_phases.begin("commit");
+  uint32_t committed = patches.commit(*m_target);
+  uint32_t batched_calls = committed + static_cast<uint32_t>(imports.size());
+  m_phases.count_db(committed);
+  m_phases.end(phase);
+
+  m_stats.m_bytes_patched = patches.bytes();
+  m_stats.m_patch_writes = patches.writes();
+  m_stats.m_import_stubs = static_cast<uint32_t>(imports.size());
+  msg("REL: %u relocation writes committed with %u database calls (%u calls saved)\n",
+    patches.writes(), batched_calls, unbatched_calls > batched_calls ? unbatched_calls - batched_calls : 0);
+
+  result->m_import_size = desired_import_size;
   return true;
 }
 
 bool rel_track::apply_names(bool dry_run)
 {
   // Describe the binary header
-  add_pgm_cmt("ID: %u", m_id);
-  add_pgm_cmt("Version: %u", m_version);
-  add_pgm_cmt("%u sections @ %08X:", m_num_sections, m_section_offset);
+  m_target->program_cmt("ID: %u", m_id);
+  m_target->program_cmt("Version: %u", m_version);
+  m_target->program_cmt("%u sections @ %08X:", m_num_sections, m_section_offset);
   for ( unsigned i = 0; i < m_sections.size(); ++i )
   {
     if ( i == m_internal_bss_section )
     {
-      add_pgm_cmt("    .bss%u: %u bytes", i, m_sections[i].size);
+      m_target->program_cmt("    .bss%u: %u bytes", i, m_sections[i].size);
+      m_phases.count_db();
     }
     else if ( m_sections[i].file_offset != 0 )
     {
       if ( m_sections[i].file_offset & SECTION_EXEC )
-        add_pgm_cmt("    .text%u: %u bytes @ %08X", i, m_sections[i].size, SECTION_OFF(m_sections[i].file_offset));
+        m_target->program_cmt("    .text%u: %u bytes @ %08X", i, m_sections[i].size, SECTION_OFF(m_sections[i].file_offset));
       else
-        add_pgm_cmt("    .data%u: %u bytes @ %08X", i, m_sections[i].size, SECTION_OFF(m_sections[i].file_offset));
+        m_target->program_cmt("    .data%u: %u bytes @ %08X", i, m_sections[i].size, SECTION_OFF(m_sections[i].file_offset));
+      m_phases.count_db();
     }
   }
-  add_pgm_cmt("Imports: %u bytes @ %08X", m_import_size, m_import_offset);
-  add_pgm_cmt("Relocations @ %08X", m_rel_offset);
+  if ( m_version >= 2 )
+    m_target->program_cmt("Alignment: %u, BSS alignment: %u", m_align, m_bss_align);
+  if ( m_version >= 3 )
+    m_target->program_cmt("Fixed data size: %08X", m_fix_size);
+  m_target->program_cmt("Imports: %u bytes @ %08X", m_import_size, m_import_offset);
+  m_target->program_cmt("Relocations @ %08X", m_rel_offset);
+  m_phases.count_db(5 + (m_version >= 2) + (m_version >= 3));
 
   // Obtain addresses
   ea_t epilog_addr = section_address(m_epilog_prep.m_section_id, m_epilog_prep.m_offset);
@@ -546,59 +1002,26 @@ bool rel_track::apply_names(bool dry_run)
   ea_t unresolved_addr = section_address(m_unresolved_prep.m_section_id, m_unresolved_prep.m_offset);
 
   // Make function exports
-  add_entry(epilog_addr, epilog_addr, "_epilog", true);
-  add_entry(prolog_addr, prolog_addr, "_prolog", true);
-  add_entry(unresolved_addr, unresolved_addr, "_unresolved", true);
+  m_target->add_entry(epilog_addr, "_epilog");
+  m_target->add_entry(prolog_addr, "_prolog");
+  m_target->add_entry(unresolved_addr, "_unresolved");
 
   // Make library functions (emphasis)
-  set_libitem(epilog_addr);
-  set_libitem(prolog_addr);
-  set_libitem(unresolved_addr);
-
-  return true;
-}
-
-int idaapi enum_modules_cb(char const * file, rel_track * owner)
-{
-  // Load the file
-  linput_t * inp = open_linput(file, false);
-
-  // Check if it's a REL file first
-  rel_track rel(inp);
+  m_target->set_libitem(epilog_addr);
+  m_target->set_libitem(prolog_addr);
+  m_target->set_libitem(unresolved_addr);
 
-  // If the file is good
-  if ( rel.is_good() )
+  // Entries name their address. A dry run does not read the names back from
+  // the database, so they are registered here.
+  if ( dry_run )
   {
-    std::string basename(qbasename(file));
-    std::string modulename = basename.substr(0, basename.find_last_of('.'));
-
-    if ( rel.m_id == 0 )
-      msg("%s id is 0\n", modulename.c_str());
-    owner->m_module_names[rel.m_id] = modulename;
-    owner->m_external_modules[modulename] = rel;
-  }
-  else
-  {
-      /*dol_track dol(inp);
-
-      if (dol.is_good())
-      {
-          if (owner->m_dol_file_loaded) // not sure if this is good enough
-          {
-              msg("REL: a DOL file has already been imported! This file will be ignored.");
-              return;
-          }
-          std::string basename(qbasename(file));
-          std::string modulename = basename.substr(0, basename.find_last_of('.'));
-
-          owner->m_module_names[0] = modulename;
-          owner->m_external_modules[modulename] = dol;
-      }*/
+    m_names.add(epilog_addr, "_epilog");
+    m_names.add(prolog_addr, "_prolog");
+    m_names.add(unresolved_addr, "_unresolved");
   }
+  m_phases.count_db(6);
 
-  // close/cleanup
-  close_linput(inp);
-  return 0;
+  return true;
 }
 
 void rel_track::init_resolvers()
@@ -611,9 +1034,40 @@ void rel_track::init_resolvers()
     msg("REL: Unable to get directory of idb file.\n");
   path = dir;
 
-  // Load the module names
-  m_module_names.clear();
-  enumerate_files(nullptr, 0, path.c_str(), "*.rel", reinterpret_cast<int(idaapi*)(char const*,void*)>(&enum_modules_cb), this);
+  // Load the module names from the sibling index, only modules that changed
+  // since the last load are parsed again. The modules of a disc are read
+  // from the image, only their headers and section tables.
+  module_index index(path);
+  size_t phase = m_phases.begin("index");
+  if ( m_disc != nullptr )
+  {
+    index.scan_disc(*m_disc, m_disc_input);
+    msg("REL: Module index: %u modules read from disc %s\n", index.parsed(), m_disc->game_id());
+  }
+  else
+  {
+    index.load();
+    index.refresh();
+    index.save();
+    msg("REL: Module index: %u modules reused, %u parsed\n", index.reused(), index.parsed());
+  }
+  m_phases.end(phase);
+
+  // Its peak heap is the memory the sibling modules take during the load
+  phase = m_phases.begin("modules");
+  m_external_modules.clear();
+  m_external_modules.reserve(index.modules().size());
+  for ( auto const &it : index.modules() )
+  {
+    module_index_entry const &module = it.second;
+    if ( module.m_id == 0 )
+      msg("%s id is 0\n", module.m_name.c_str());
+    m_external_modules.add(module.m_id, module.m_name, module.m_sections);
+  }
+  m_external_modules.finalize();
+  m_phases.end(phase);
+  msg("REL: %u external modules described in %u bytes\n",
+    static_cast<uint32_t>(m_external_modules.size()), static_cast<uint32_t>(m_external_modules.memory_usage()));
 
 
   /*std::ifstream modid(path + "/module_id.txt");
@@ -624,213 +1078,182 @@ void rel_track::init_resolvers()
   // TODO: load map files matching module names
 }
 
-uint32_t rel_track::get_external_offset(std::string const &modulename, uint32_t offset, uint8_t section, bool virt) const
+std::string rel_track::module_name(uint32_t module_id) const
+{
+  ext_module const *module = m_external_modules.find(module_id);
+  if ( module != nullptr )
+    return m_external_modules.name(*module);
+  if ( module_id == 0 )
+    return BASENAME;
+  return std::string("module") + std::to_string(static_cast<unsigned long long>(module_id));
+}
+
+std::string rel_track::cache_path() const
+{
+  char dir[QMAXPATH] = {};
+  char path[QMAXPATH];
+  qdirname(dir, sizeof(dir), get_path(PATH_TYPE_IDB));
+  std::string file = this->module_name(m_id) + RELOC_CACHE_EXTENSION;
+  qmakepath(path, sizeof(path), dir, file.c_str(), nullptr);
+  return path;
+}
+
+uint32_t rel_track::get_external_offset(ext_module const *module, uint32_t offset, uint8_t section, bool virt, std::string *log) const
 {
-  auto it = m_external_modules.find(modulename);
   // Check for existence
-  if ( it == m_external_modules.end() )
+  if ( module == nullptr )
   {
     return 0;
   }
 
   // Check for section validity
-  if ( section >= it->second.m_sections.size() )
+  if ( section >= module->m_num_sections )
   {
-    msg("REL: Module %s had invalid section reference %u\n", modulename.c_str(), static_cast<unsigned int>(section));
+    log_msg(log, "REL: Module %s had invalid section reference %u\n", m_external_modules.name(*module), static_cast<unsigned int>(section));
     return 0;
   }
 
-  uint32_t section_offset = SECTION_OFF(it->second.m_sections[section].file_offset);
+  uint32_t section_offset = SECTION_OFF(m_external_modules.section(*module, section).file_offset);
   if ( section_offset == 0 )
     return 1;
 
-  uint32_t first_offset = 0;
-  for ( unsigned i = 0; i < it->second.m_sections.size() && first_offset == 0; ++i )
-    first_offset = SECTION_OFF(it->second.m_sections[i].file_offset);
-  
   if ( virt )
   {
-    section_offset -= first_offset;
+    section_offset -= module->m_first_offset;
     section_offset += m_base_address;
   }
 
   return section_offset + offset;
 }
 
-qstring rel_track::get_line_map_info(const qstring& line, uint32_t* address, uint32_t* size, uint32_t* vaddress, uint32_t* alignment) {
-    // TODO: handle other column counts (2 & 4, others?)
-    // TODO: Do I want to add the object in the name? If not, I'll have to strip it.
-    size_t length = line.length();
-    char name[512], container[512];
-    size_t isEntry = line.find("(entry of ");
-    if (length > 27 && line[27] != ' ' && isEntry) {
-        *alignment = 0;
-        qsscanf(line.c_str(), "%08x %06x %08x %511s", address, size, vaddress, name);
-        if (isEntry != qstring::npos && line[isEntry + 10] != '\.') {
-            qsscanf(line.c_str() + isEntry + 10, "%511s", container);
-            char* end = qstrchr(container, ')');
-            end[0] = '\0';
-            qstrncat(container, "::", 512);
-            qstrncat(container, name, 512);
-            qstrncpy(name, container, 512);
-        }
+bool rel_track::apply_symbols(bool dry_run) {
+    // Not loading a map is not an error
+    char const* fileLocation;
+    if (dry_run) {
+        if (m_symbol_map.empty())
+            return true;
+        fileLocation = m_symbol_map.c_str();
     }
     else {
-        qsscanf(line.c_str(), "%08x %06x %08x %i %511s", address, size, vaddress, alignment, name);
-        //msg("Symbol Loader: Entry name: %s\n", name);
+        if (ask_yn(ASKBTN_YES, "Would you like to load a Symbol Map for this file?") != ASKBTN_YES)
+            return true;
+
+        fileLocation = ask_file(false, NULL, "FILTER Symbol Map|*.map\nSelect a Symbol Map...");
+        if (fileLocation == NULL)
+            return true;
     }
 
-    return qstring(name);
-}
+    symbol_map symbols;
+    if (!symbols.open(fileLocation))
+        return err_msg("Symbol Loader: Unable to open %s", fileLocation);
+    if (!symbols.parse())
+        return false;
 
-bool rel_track::get_file_map_info(FILE* file, std::map<qstring, uint32_t>* fileMap) {
-    // Check that a symbol map even exists
-    qfseek(file, 0, SEEK_END);
-    uint64_t fileSize = qftell(file);
-    msg("Symbol Loader: Map File Size: %08X\n", fileSize);
+    // Sections with data are laid out back to back from the base address
+    std::map<std::string, uint32_t> fileMap;
+    uint32_t currentOffset = m_base_address;
+    for (auto const& section : symbols.sections()) {
+        if (section.m_size != 0) {
+            fileMap[section.m_name] = currentOffset;
+            currentOffset += section.m_size;
+            msg("Symbol Loader: Added section %s at file address %08X!\n", section.m_name.c_str(), m_base_address + section.m_file_offset);
+        }
+    }
 
-    // If there's less than 0x800 bytes, it's probably not a valid symbol map.
-    if (fileSize < 0x800) {
-        return err_msg("Symbol Loader: Symbol file was too small to be a symbol map!\n");
+    // Resolve every layout block to its load address
+    arena_vector<uint32_t> layoutAddress(symbols.layouts().size(), BADADDR, arena_allocator<uint32_t>(&m_arena));
+    for (size_t i = 0; i < symbols.layouts().size(); ++i) {
+        auto const& layout = symbols.layouts()[i];
+        auto it = fileMap.find(layout.m_name);
+        if (it != fileMap.end()) {
+            layoutAddress[i] = it->second;
+            msg("Symbol Loader: Switched to section %s at offset %08X!\n", layout.m_name.c_str(), it->second);
+        }
+        else {
+            msg("Symbol Loader: Failed to find a file offset for section %s! Skipping section!\n", layout.m_name.c_str());
+        }
     }
 
-    qfseek(file, -0x800, SEEK_END); // Seek to a good spot shortly before the end of the file.
+    // Resolve every name in memory first, seeded with the database names
+    // (including the import stubs), so each address is named exactly once
+    struct planned_name {
+        ea_t address;
+        uint32_t size;
+        bool function;
+        char const* name;
+    };
+    arena_vector<planned_name> plan { arena_allocator<planned_name>(&m_arena) };
+    plan.reserve(symbols.symbols().size());
+    m_names.reserve(symbols.symbols().size());
+    // A dry run plans for a fresh database, which only has the names of this load
+    uint32_t seedCalls = dry_run ? 0 : m_names.seed_database();
+    uint32_t collisions = m_names.collisions();
+    uint32_t skipped = 0;
+    m_phases.count_db(seedCalls);
+
+    char suffix[16];
+    for (auto const& symbol : symbols.symbols()) {
+        uint32_t sectionAddress = layoutAddress[symbol.m_layout];
+        if (sectionAddress == BADADDR) {
+            ++m_stats.m_symbols_unmapped;
+            continue;
+        }
 
-    // Start looking for "Memory map:"
-    qstring line;
-    while (qgetline(&line, file) != -1) {
-        if (line.find("Memory map:") != qstring::npos) break;
-    }
+        auto const& section = symbols.layouts()[symbol.m_layout].m_name;
+        char const* name = symbols.name(symbol);
+        if (name[0] == '\0' || section == name) continue; // We don't want to bother with these objects.
 
-    if (qgetline(&line, file) == -1) return false; // memory map was empty
+        bool textSection = section == ".text";
+        bool bssSection = section == ".bss";
+        uint32_t virtualAddress = sectionAddress + symbol.m_address;
 
-    std::map<qstring, uint32_t> map;
-    uint32_t address, size, fileAddress;
-    uint32_t currentOffset = m_base_address;
-    qstring temp(line.c_str());
-    do {
-        // Skip the next two lines
-        if (line.find("Starting") != qstring::npos || line.find("address") != qstring::npos ||
-            temp.trim2().empty()) continue; // TODO: Find a better way of checking a qstring for empty.
-
-        qsscanf(line.substr(19).c_str(), "%08x %08x %08x", &address, &size, &fileAddress);
-        auto name = line.substr(0, 19).trim2();
-        msg("Symbol Loader: Section found! Name: %s | Address: %08X | Size: %08X | File Address: %08X\n", name.c_str(), address, size, fileAddress);
-
-        // Only add the section if the size is greater than 0.
-        if (size != 0) {
-            map[name] = currentOffset;
-            currentOffset += size;
-            msg("Symbol Loader: Added section %s at file address %08X!\n", name.c_str(), m_base_address + fileAddress);
+        if (!bssSection && (virtualAddress + symbol.m_size < m_base_address || (virtualAddress + symbol.m_size) >= (m_base_address + m_max_filesize))) {
+            msg("Symbol Loader: Failed to import symbol \"%s\"! Address was out of bounds at %08X!\n", name, virtualAddress);
+            ++m_stats.m_symbols_out_of_bounds;
+            continue;
         }
 
-    } while (qgetline(&line, file) != -1);
+        char const* currName = m_names.name_at(virtualAddress);
+        if (currName != nullptr) {
+            msg("Symbol Loader: Attempted to overwrite a name [%s] with [%s] that already existed at offset %08X\n",
+                name, currName, virtualAddress);
+            ++skipped;
+            continue;
+        }
 
-    // Seek back to the beginning of the file
-    qfseek(file, 0, SEEK_SET);
-    *fileMap = map;
-    return true;
-}
+        // A name that is already taken gets the symbol's offset appended
+        qsnprintf(suffix, sizeof(suffix), "_%x", symbol.m_address);
+        plan.push_back({ virtualAddress, symbol.m_size, textSection, m_names.claim(virtualAddress, name, suffix) });
+    }
+    collisions = m_names.collisions() - collisions;
 
-bool rel_track::apply_symbols(bool dry_run) {
-    if (ask_yn(ASKBTN_YES, "Would you like to load a Symbol Map for this file?") != ASKBTN_YES)
-        return false;
+    // One database call per address
+    for (auto const& entry : plan) {
+        if (!m_target->set_name(entry.address, entry.name, SN_NOWARN | SN_FORCE))
+            msg("Symbol Loader: Unable to set name %s for object at address %08X\n", entry.name, entry.address);
 
-    char* fileLocation = ask_file(false, NULL, "FILTER Symbol Map|*.map\nSelect a Symbol Map...");
-    if (fileLocation != NULL) {
-        FILE* symbolFile = fopenRT(fileLocation);
-        if (symbolFile != NULL) {
-            qstring line;
-
-            uint32_t sectionAddress = m_base_address;
-            qstring section;
-
-            uint32_t address, size, vaddress, alignment;
-            qstring name;
-            qstring currName;
-
-            bool skipSection = false;
-            bool textSection = false;
-            bool bssSection = false;
-
-            std::map<qstring, uint32_t> fileMap;
-            if (!get_file_map_info(symbolFile, &fileMap)) return false;
-
-            while (qgetline(&line, symbolFile) != -1) {
-                if (line.find("Memory map:") != qstring::npos) break; // We've reached the end of the symbol map.
-                size_t end = line.find(" section layout");
-                if (end != qstring::npos) {
-                    // Looks like we're starting a new section.
-
-                    section = line.substr(0, end).trim2();
-                    skipSection = false;
-                    textSection = section == ".text";
-                    bssSection = section == ".bss";
-
-                    bool foundSection = false;
-                    for (auto const& entry : fileMap) {
-                        if (entry.first == section) {
-                            sectionAddress = entry.second;
-                            foundSection = true;
-                            msg("Symbol Loader: Switched to section %s at offset %08X!\n", section.c_str(), sectionAddress);
-                            break;
-                        }
-                    }
-
-                    if (!foundSection) {
-                        skipSection = true;
-                        msg("Symbol Loader: Failed to find a file offset for section %s! Skipping section!\n",
-                            section.c_str());
-                    }
-                }
-                else if (skipSection ||
-                    line.find("Starting        Virtual") != qstring::npos ||
-                    line.find("address  Size   address") != qstring::npos ||
-                    line.find("-----------------------") != qstring::npos ||
-                    line.find(section.c_str()) != qstring::npos ||
-                    line.trim2().empty()) continue;
-                else
-                {
-                    name = get_line_map_info(line, &address, &size, &vaddress, &alignment);
-                    uint32_t virtualAddress = sectionAddress + address;
-                    if (name == section || name.empty()) continue; // We don't want to bother with these objects.
-
-                    if (!bssSection && (virtualAddress + size < m_base_address || (virtualAddress + size) >= (m_base_address + m_max_filesize))) {
-                        msg("Symbol Loader: Failed to import symbol \"%s\"! Address was out of bounds at %08X!\n", name.c_str(), virtualAddress);
-                        continue;
-                    }
-
-                    // Set the entry's name
-                    if (get_name(&currName, virtualAddress) < 1) {
-                        if (!set_name(virtualAddress, name.c_str(), SN_NOWARN | SN_FORCE)) {
-                            // The name might already exist. Try it again after appending the address onto it.
-                            msg("Symbol Loader: Unable to set name %s for object at address %08X! Trying again with a modified name!\n",
-                                name.c_str(), virtualAddress);
-                            name.append(qsnprintf("_", 16, "%x", address));
-                            if (!set_name(virtualAddress, name.c_str(), SN_NOWARN | SN_FORCE)) {
-                                msg("Symbol Loader: Unable to set name %s for object at address %08X\n", name.c_str(), virtualAddress);
-                            }
-                        }
-                    }
-                    else {
-                        msg("Symbol Loader: Attempted to overwrite a name [%s] with [%s] that already existed at offset %08X\n",
-                            name.c_str(), currName.c_str(), virtualAddress);
-                        continue;
-                    }
-
-                    // Create a function if in the text section
-                    if (textSection) {
-                        add_func(virtualAddress, virtualAddress + size);
-                    }
-
-                    // TODO: Comments?
-                }
-            }
-
-            msg("Symbol Loader: Symbol file was successfully loaded!\n");
-            qfclose(symbolFile);
-            return true;
+        m_phases.count_db();
+
+        // Create a function if in the text section
+        if (entry.function) {
+            m_target->add_func(entry.address, entry.address + entry.size);
+            m_phases.count_db();
         }
+
+        // TODO: Comments?
     }
-    return false;
-}
\ No newline at end of file
+
+    // The per-symbol lookup issued a get_name for every symbol and a second
+    // set_name for every collision
+    uint32_t namedCalls = static_cast<uint32_t>(plan.size());
+    m_stats.m_symbols_applied = namedCalls;
+    m_stats.m_symbols_named = skipped;
+    m_stats.m_symbol_collisions = collisions;
+    uint32_t previousCalls = namedCalls + skipped + namedCalls + collisions;
+    uint32_t currentCalls = seedCalls + namedCalls;
+    msg("Symbol Loader: %u names set, %u collisions resolved in memory, %u database calls avoided\n",
+        namedCalls, collisions, previousCalls > currentCalls ? previousCalls - currentCalls : 0);
+
+    msg("Symbol Loader: Symbol file was successfully loaded!\n");
+    return true;
+}
@@ -2,6 +2,22 @@
 #define __REL_TRACK_H__
 
 #include "rel.h"
+#include "../loader/disc_image.h"
+#include "../loader/input_buffer.h"
+#include "../loader/load_arena.h"
+#include "../loader/load_phases.h"
+#include "../loader/load_plan.h"
+#include "module_index.h"
+#include "ext_module.h"
+#include "import_map.h"
+#include "name_registry.h"
+#include "patch_batch.h"
+#include "reloc_cache.h"
+#include "rel_fixups.h"
+#include "rel_stats.h"
+#include <bitset>
+#include <iosfwd>
+#include <string>
 #include <vector>
 #include <map>
 
@@ -15,20 +31,97 @@ struct fxn_naming_entry
 
 #define SECTION_IMPORTS 99
 
+// Modules with less relocation data than this are decoded on the calling thread
+#define REL_PARALLEL_THRESHOLD (64 * 1024)
+
+// One import table entry's relocation stream, decoded on a worker thread and
+// merged in import table order
+struct rel_stream
+{
+  rel_stream() : m_slot(0), m_extent(0), m_ok(true), m_error_offset(0), m_relocations(0), m_unbatched_calls(0)
+  {
+    memset(m_operations, 0, sizeof(m_operations));
+  }
+
+  import_entry m_entry;
+  uint32_t m_slot;                  // module slot of external streams
+  uint32_t m_extent;                // bytes up to the next stream or the end of the file
+  bool m_ok;
+  uint32_t m_error_offset;          // where decoding failed
+  std::string m_log;                // output, shown when the stream is merged
+
+  uint32_t m_operations[256];       // by relocation type
+  uint32_t m_relocations;           // operations that patch a location
+  uint32_t m_unbatched_calls;
+  std::vector<uint32_t> m_targets;  // distinct import targets, in order of first reference
+  std::vector<rel_fixup> m_fixups;  // patched sites of self streams
+  std::vector<reloc_site> m_sites;  // and those without a fixup
+};
+
+// Load address of every section id. Ids are a byte, so a flat table with a
+// validity bit per id replaces the map lookups on the relocation path.
+class section_addresses
+{
+public:
+  section_addresses() { clear(); }
+
+  void clear() { memset(m_address, 0, sizeof(m_address)); m_valid.reset(); }
+  void set(uint8_t section, uint32_t address) { m_address[section] = address; m_valid.set(section); }
+
+  bool valid(uint8_t section) const { return m_valid.test(section); }
+  uint32_t operator[](uint8_t section) const { return m_address[section]; }
+
+private:
+  uint32_t m_address[256];
+  std::bitset<256> m_valid;
+};
+
+class name_buffer;
+
 class rel_track
 {
 public:
   rel_track();
   rel_track(linput_t *p_input);
 
+  // A module already in memory, e.g. a file of an archive
+  rel_track(input_buffer const &buffer);
+
+  // A module stored at offset in the input, e.g. a file of a disc image
+  rel_track(linput_t *p_input, uint64_t offset, uint64_t size);
+
   uint32_t get_base_address();
+  uint32_t get_id() const { return m_id; }
+  std::vector<section_entry> const & get_sections() const { return m_sections; }
   bool is_good() const;
 
   //section_entry const * get_section(uint entry_id) const;
-  ea_t section_address(uint8_t section, uint32_t offset = 0) const;
-
+  ea_t section_address(uint8_t section, uint32_t offset = 0) const
+  {
+    return m_section_addresses.valid(section) ? m_section_addresses[section] + offset : BADADDR;
+  }
+
+  // A dry run asks nothing and leaves the database and the relocation cache
+  // untouched: the base address and symbol map come from the setters below
+  // and every database call is recorded into plan() instead
   bool apply_patches(bool dry_run = false);
+
+  void set_base_address(uint32_t base) { m_base_address = base; }
+  void set_symbol_map(std::string const &path) { m_symbol_map = path; }
+
+  // Take the sibling modules from the disc's FST instead of the directory
+  // of the database
+  void set_disc(disc_image const *disc, linput_t *input) { m_disc = disc; m_disc_input = input; }
+
+  // Database calls of the last dry run
+  load_plan const & plan() const { return m_plan; }
+
+  // Time spent in each phase of the last parse and apply_patches
+  load_phases const & phases() const { return m_phases; }
+  rel_stats const & stats() const { return m_stats; }
 private:
+  bool unpack();
+  void parse();
   bool read_header();
   bool read_sections();
   bool verify_section(uint32_t offset, uint32_t size) const;
@@ -36,18 +129,45 @@ private:
   uint32_t get_header_size() const;
   bool validate_header() const;
 
+  bool apply_phases(bool dry_run = false);
   bool create_sections(bool dry_run = false);
   bool apply_relocations(bool dry_run = false);
+
+  // Decodes and resolves the relocations, issuing the calls to m_target.
+  // Returns the size of the import stubs, the sites without a fixup and the
+  // stubs in result.
+  bool resolve_relocations(reloc_result *result);
+
+  // Issues the calls of resolve_relocations again from a cached result
+  bool replay_relocations(reloc_result const &result);
+
+  // Images of the sections with file data, to apply relocations to
+  void add_section_images(patch_batch &patches) const;
+
+  // Names and comments an import stub; stubs is the address of the first one
+  void describe_stub(std::string const &module_name, reloc_stub const &stub, ea_t stubs, name_buffer &name_text, std::ostream &ss);
+
+  // Stores the patched sites and the stubs named after an address in the
+  // database for rel_move_segm
+  void save_fixups(reloc_result const &result);
   bool apply_names(bool dry_run = false);
   bool apply_symbols(bool dry_run = false);
 
-  qstring get_line_map_info(const qstring& line, uint32_t* address, uint32_t* size, uint32_t* vaddress, uint32_t* alignment);
-  bool get_file_map_info(FILE* file, std::map<qstring, uint32_t>* fileMap);
-
   // Initializes the name and module resolvers
   void init_resolvers();
 
-  uint32_t get_external_offset(std::string const &modulename, uint32_t offset, uint8_t section, bool virt = false) const;
+  // Stream decoding, run on worker threads. Only the self relocations write,
+  // to the section images, and they are all decoded by one worker.
+  void decode_streams(arena_vector<rel_stream> &streams, patch_batch &patches) const;
+  bool decode_self(rel_stream &stream, patch_batch &patches) const;
+  bool decode_imports(rel_stream &stream) const;
+
+  // Messages go to log instead of the output window when it is set
+  uint32_t get_external_offset(ext_module const *module, uint32_t offset, uint8_t section, bool virt = false, std::string *log = nullptr) const;
+  std::string module_name(uint32_t module_id) const;
+
+  // <module>.rlc next to the database
+  std::string cache_path() const;
 
   //
   uint32_t m_id;
@@ -67,30 +187,47 @@ private:
   uint32_t m_bss_size;
 
   uint32_t m_rel_offset;
+
+  uint32_t m_align;
+  uint32_t m_bss_align;
+  uint32_t m_fix_size;
   //
 
   uint32_t m_base_address = START_DEFAULT;
+  std::string m_symbol_map;   // dry runs only
+  disc_image const *m_disc = nullptr;
+  linput_t *m_disc_input = nullptr;
   bool m_valid;
   bool m_dol_file_loaded;
   uint32_t m_max_filesize;
-  linput_t * m_input_file;
+
+  // Owns the transient state of the load (import tables, names), released
+  // with the track at the end of load_file
+  load_arena m_arena;
+  input_buffer m_buffer;
 
   //uint32_t m_next_file_offset;
   uint32_t m_next_seg_offset;
   uint8_t m_import_section;
   uint8_t m_internal_bss_section;
-  std::map<std::string, std::vector<rel_entry> > m_imports;
+  arena_vector<import_module> m_imports;   // by slot
 
   std::vector<section_entry> m_sections;
 
-  std::map<uint32_t,std::string> m_module_names;
   std::map<uint32_t, std::map<uint32_t,std::string> > m_function_names;
-  std::map<uint8_t, uint32_t> m_segment_address_map;
-  std::map<uint8_t, uint32_t> m_section_address_map;
-
-  std::map<std::string, rel_track> m_external_modules;
-
-  friend int idaapi enum_modules_cb(char const * file, rel_track * owner);
+  section_addresses m_segment_addresses;
+  section_addresses m_section_addresses;
+
+  ext_module_table m_external_modules;
+  name_registry m_names;
+  rel_fixup_table m_fixups;
+
+  // Where the database calls go, the database or the dry run's plan
+  load_target *m_target;
+  database_target m_database;
+  load_plan m_plan;
+  load_phases m_phases;
+  rel_stats m_stats;
 };
 
 #endif // #ifndef __REL_TRACK_H__
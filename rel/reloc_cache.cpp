@@ -0,0 +1,306 @@
+#include "reloc_cache.h"
+#include "../loader/input_buffer.h"
+
+#define RELOC_CACHE_MAGIC   0x524C5243 // RLRC
+#define RELOC_CACHE_VERSION 4
+
+// Key fields at the start of every record
+#define RELOC_CACHE_KEY_SIZE 24
+
+void copy_relocation_stats(rel_stats const &from, rel_stats *to)
+{
+  memcpy(to->m_operations, from.m_operations, sizeof(to->m_operations));
+  to->m_imports       = from.m_imports;
+  to->m_bytes_patched = from.m_bytes_patched;
+  to->m_patch_writes  = from.m_patch_writes;
+  to->m_import_stubs  = from.m_import_stubs;
+}
+
+static void put_key(std::vector<uint8_t> &out, reloc_cache_key const &key)
+{
+  put_be64(out, key.m_content);
+  put_be64(out, key.m_siblings);
+  put_be32(out, key.m_base);
+  put_be32(out, key.m_stubs);
+}
+
+static bool get_key(be_cursor &in, reloc_cache_key *key)
+{
+  return in.read_u64(&key->m_content) && in.read_u64(&key->m_siblings) && in.read_u32(&key->m_base) && in.read_u32(&key->m_stubs);
+}
+
+static void put_record(std::vector<uint8_t> &out, reloc_result const &result)
+{
+  put_key(out, result.m_key);
+  put_be32(out, result.m_import_size);
+
+  // Counters, only the relocation types that occurred
+  uint32_t types = 0;
+  for ( unsigned type = 0; type < 256; ++type )
+    types += result.m_stats.m_operations[type] != 0;
+  put_be32(out, types);
+  for ( unsigned type = 0; type < 256; ++type )
+  {
+    if ( result.m_stats.m_operations[type] == 0 )
+      continue;
+    out.push_back(static_cast<uint8_t>(type));
+    put_be32(out, result.m_stats.m_operations[type]);
+  }
+  put_be32(out, static_cast<uint32_t>(result.m_stats.m_imports.size()));
+  for ( auto const &import : result.m_stats.m_imports )
+  {
+    put_be32(out, import.m_module);
+    put_be32(out, import.m_relocations);
+  }
+  put_be64(out, result.m_stats.m_bytes_patched);
+  put_be32(out, result.m_stats.m_patch_writes);
+  put_be32(out, result.m_stats.m_import_stubs);
+
+  put_be32(out, static_cast<uint32_t>(result.m_fixups.size()));
+  for ( auto const &fixup : result.m_fixups )
+  {
+    out.push_back(fixup.m_type);
+    out.push_back(fixup.m_section);
+    put_be32(out, fixup.m_offset);
+    out.push_back(fixup.m_target_section);
+    put_be32(out, fixup.m_target_offset);
+  }
+
+  put_be32(out, static_cast<uint32_t>(result.m_sites.size()));
+  for ( auto const &site : result.m_sites )
+  {
+    put_be32(out, site.m_fixup);
+    out.push_back(site.m_type);
+    out.push_back(site.m_section);
+    put_be32(out, site.m_offset);
+    put_be32(out, site.m_value);
+  }
+
+  // Stubs by module, the value only when a later reference changed it
+  put_be32(out, static_cast<uint32_t>(result.m_imports.size()));
+  auto stub = result.m_stubs.begin();
+  for ( auto const &import : result.m_imports )
+  {
+    put_be32(out, import.m_module);
+    put_be32(out, import.m_start);
+    put_be32(out, import.m_stubs);
+    for ( uint32_t i = 0; i < import.m_stubs; ++i, ++stub )
+    {
+      uint8_t flags = (stub->m_written ? 1 : 0) | (stub->m_value != stub->m_addend ? 2 : 0);
+      put_be32(out, stub->m_offset);
+      put_be32(out, stub->m_addend);
+      put_be32(out, stub->m_virtual);
+      out.push_back(stub->m_section);
+      out.push_back(flags);
+      if ( (flags & 2) != 0 )
+        put_be32(out, stub->m_value);
+    }
+  }
+}
+
+// Every count is checked against the bytes left before anything is allocated
+static bool get_record(be_cursor &in, reloc_result *result)
+{
+  if ( !get_key(in, &result->m_key) || !in.read_u32(&result->m_import_size) )
+    return false;
+
+  uint32_t types, imports;
+  if ( !in.read_u32(&types) || types > 256 )
+    return false;
+  memset(result->m_stats.m_operations, 0, sizeof(result->m_stats.m_operations));
+  for ( uint32_t i = 0; i < types; ++i )
+  {
+    uint8_t type;
+    if ( !in.read_u8(&type) || !in.read_u32(&result->m_stats.m_operations[type]) )
+      return false;
+  }
+  if ( !in.read_u32(&imports) || imports > in.remaining() / 8 )
+    return false;
+  result->m_stats.m_imports.resize(imports);
+  for ( auto &import : result->m_stats.m_imports )
+  {
+    if ( !in.read_u32(&import.m_module) || !in.read_u32(&import.m_relocations) )
+      return false;
+  }
+  if ( !in.read_u64(&result->m_stats.m_bytes_patched) || !in.read_u32(&result->m_stats.m_patch_writes) || !in.read_u32(&result->m_stats.m_import_stubs) )
+    return false;
+
+  uint32_t fixups;
+  if ( !in.read_u32(&fixups) || fixups > in.remaining() / 11 )
+    return false;
+  result->m_fixups.resize(fixups);
+  for ( auto &fixup : result->m_fixups )
+  {
+    in.read_u8(&fixup.m_type);
+    in.read_u8(&fixup.m_section);
+    in.read_u32(&fixup.m_offset);
+    in.read_u8(&fixup.m_target_section);
+    in.read_u32(&fixup.m_target_offset);
+  }
+
+  uint32_t sites;
+  if ( !in.read_u32(&sites) || sites > in.remaining() / 14 )
+    return false;
+  result->m_sites.resize(sites);
+  for ( auto &site : result->m_sites )
+  {
+    in.read_u32(&site.m_fixup);
+    in.read_u8(&site.m_type);
+    in.read_u8(&site.m_section);
+    in.read_u32(&site.m_offset);
+    in.read_u32(&site.m_value);
+  }
+
+  uint32_t modules;
+  if ( !in.read_u32(&modules) || modules > in.remaining() / 12 )
+    return false;
+  result->m_imports.resize(modules);
+  result->m_stubs.clear();
+  for ( auto &import : result->m_imports )
+  {
+    if ( !in.read_u32(&import.m_module) || !in.read_u32(&import.m_start) || !in.read_u32(&import.m_stubs) ||
+         import.m_stubs > in.remaining() / 14 )
+      return false;
+    for ( uint32_t i = 0; i < import.m_stubs; ++i )
+    {
+      reloc_stub stub;
+      uint8_t flags;
+      if ( !in.read_u32(&stub.m_offset) || !in.read_u32(&stub.m_addend) || !in.read_u32(&stub.m_virtual) ||
+           !in.read_u8(&stub.m_section) || !in.read_u8(&flags) )
+        return false;
+      stub.m_written = (flags & 1) != 0;
+      stub.m_value = stub.m_addend;
+      if ( (flags & 2) != 0 && !in.read_u32(&stub.m_value) )
+        return false;
+      if ( stub.m_offset >= result->m_import_size || result->m_import_size - stub.m_offset < 4 )
+        return false;
+      result->m_stubs.push_back(stub);
+    }
+  }
+  return in.remaining() == 0;
+}
+
+// Records of a cache file, each with its checksum verified. Empty if the
+// file is missing or damaged.
+struct record_range
+{
+  uint32_t m_offset;
+  uint32_t m_size;
+};
+
+static bool read_records(input_buffer const &buffer, std::vector<record_range> *records)
+{
+  records->clear();
+  be_cursor in = buffer.cursor(0);
+  uint32_t magic, version, count;
+  if ( !in.read_u32(&magic) || !in.read_u32(&version) || !in.read_u32(&count) ||
+       magic != RELOC_CACHE_MAGIC || version != RELOC_CACHE_VERSION )
+    return false;
+
+  for ( uint32_t i = 0; i < count; ++i )
+  {
+    uint32_t size, checksum;
+    if ( !in.read_u32(&size) || !in.read_u32(&checksum) || size < RELOC_CACHE_KEY_SIZE || in.remaining() < size )
+    {
+      records->clear();
+      return false;
+    }
+    if ( static_cast<uint32_t>(hash_bytes(in.ptr(), size)) != checksum )
+    {
+      records->clear();
+      return false;
+    }
+    records->push_back(record_range{ static_cast<uint32_t>(in.tell()), size });
+    in.skip(size);
+  }
+  return true;
+}
+
+reloc_cache::reloc_cache(std::string const &path)
+  : m_path(path)
+{}
+
+bool reloc_cache::enabled()
+{
+  return !qgetenv(RELOC_CACHE_ENV);
+}
+
+bool reloc_cache::find(reloc_cache_key const &key, reloc_result *result) const
+{
+  input_buffer buffer;
+  if ( !qfileexist(m_path.c_str()) || !buffer.map(m_path.c_str()) )
+    return false;
+
+  std::vector<record_range> records;
+  if ( !read_records(buffer, &records) )
+  {
+    msg("REL: Relocation cache %s is damaged, ignoring it\n", m_path.c_str());
+    return false;
+  }
+
+  for ( auto const &record : records )
+  {
+    be_cursor in(buffer.data() + record.m_offset, buffer.data() + record.m_offset + record.m_size, buffer.data() + record.m_offset);
+    reloc_cache_key stored;
+    if ( !get_key(in, &stored) || !(stored == key) )
+      continue;
+
+    in = be_cursor(buffer.data() + record.m_offset, buffer.data() + record.m_offset + record.m_size, buffer.data() + record.m_offset);
+    if ( get_record(in, result) )
+      return true;
+    msg("REL: Relocation cache %s is damaged, ignoring it\n", m_path.c_str());
+    return false;
+  }
+  return false;
+}
+
+bool reloc_cache::store(reloc_result const &result) const
+{
+  std::vector<uint8_t> record;
+  put_record(record, result);
+
+  std::vector<uint8_t> out;
+  put_be32(out, RELOC_CACHE_MAGIC);
+  put_be32(out, RELOC_CACHE_VERSION);
+  put_be32(out, 1);
+  put_be32(out, static_cast<uint32_t>(record.size()));
+  put_be32(out, static_cast<uint32_t>(hash_bytes(record.data(), record.size())));
+  out.insert(out.end(), record.begin(), record.end());
+
+  // Keep the newest of the other results, the file is released before it is
+  // written again
+  {
+    input_buffer buffer;
+    std::vector<record_range> records;
+    if ( qfileexist(m_path.c_str()) && buffer.map(m_path.c_str()) && read_records(buffer, &records) )
+    {
+      uint32_t count = 1;
+      for ( auto const &range : records )
+      {
+        if ( count == RELOC_CACHE_RECORDS )
+          break;
+        be_cursor in(buffer.data() + range.m_offset, buffer.data() + range.m_offset + range.m_size, buffer.data() + range.m_offset);
+        reloc_cache_key stored;
+        if ( !get_key(in, &stored) || stored == result.m_key )
+          continue;
+
+        put_be32(out, range.m_size);
+        put_be32(out, static_cast<uint32_t>(hash_bytes(buffer.data() + range.m_offset, range.m_size)));
+        out.insert(out.end(), buffer.data() + range.m_offset, buffer.data() + range.m_offset + range.m_size);
+        ++count;
+      }
+      out[8] = static_cast<uint8_t>(count >> 24);
+      out[9] = static_cast<uint8_t>(count >> 16);
+      out[10] = static_cast<uint8_t>(count >> 8);
+      out[11] = static_cast<uint8_t>(count);
+    }
+  }
+
+  FILE *fp = fopenWB(m_path.c_str());
+  if ( fp == nullptr )
+    return err_msg("REL: Unable to write the relocation cache %s", m_path.c_str());
+
+  bool ok = qfwrite(fp, out.data(), out.size()) == static_cast<ssize_t>(out.size());
+  qfclose(fp);
+  return ok;
+}
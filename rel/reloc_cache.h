@@ -0,0 +1,105 @@
+#ifndef __RELOC_CACHE_H__
+#define __RELOC_CACHE_H__
+
+#include "rel.h"
+#include "rel_stats.h"
+#include "rel_fixups.h"
+#include <string>
+#include <vector>
+
+// Sidecar next to the database, named after the module
+#define RELOC_CACHE_EXTENSION ".rlc"
+
+// Set this environment variable to resolve the relocations on every load,
+// without reading or writing the cache
+#define RELOC_CACHE_ENV "REL_LOADER_NO_CACHE"
+
+// Results kept per module, so loads at a few different bases all hit
+#define RELOC_CACHE_RECORDS 4
+
+// Everything the resolved relocations of a module depend on
+struct reloc_cache_key
+{
+  uint64_t m_content;    // hash of the unpacked module
+  uint64_t m_siblings;   // ext_module_table::fingerprint()
+  uint32_t m_base;       // base address of the module
+  uint32_t m_stubs;      // address of the import stubs, after the sections
+
+  bool operator==(reloc_cache_key const &other) const
+  {
+    return m_content == other.m_content && m_siblings == other.m_siblings && m_base == other.m_base && m_stubs == other.m_stubs;
+  }
+};
+
+// A site patched against a section that was not loaded. It has no fixup,
+// so the value is kept as it was written.
+struct reloc_site
+{
+  uint32_t m_fixup;     // fixups patched before it
+  uint32_t m_offset;
+  uint32_t m_value;
+  uint8_t  m_type;
+  uint8_t  m_section;
+};
+
+// An import stub, named after its first reference
+struct reloc_stub
+{
+  uint32_t m_offset;    // from the start of the stubs
+  uint32_t m_addend;
+  uint32_t m_virtual;   // address of the symbol, 0 if unknown and 1 in BSS
+  uint32_t m_value;     // addend of the last reference that was patched
+  uint8_t  m_section;
+  bool     m_written;   // false if no reference patched a site
+};
+
+// Module whose stubs were described next, with a comment on the first one
+struct reloc_import
+{
+  uint32_t m_module;
+  uint32_t m_start;     // from the start of the stubs
+  uint32_t m_stubs;
+};
+
+// What resolving the relocations produced, and what the later phases need
+// from it. The patched sections are not kept: a replay applies the fixups
+// and sites to the sections of the file again, and names the stubs.
+struct reloc_result
+{
+  reloc_cache_key m_key;
+  uint32_t m_import_size;   // bytes of import stubs
+  rel_stats m_stats;        // only the relocation counters are kept
+  std::vector<rel_fixup> m_fixups;
+  std::vector<reloc_site> m_sites;
+  std::vector<reloc_import> m_imports;
+  std::vector<reloc_stub> m_stubs;   // by module, in the order they were described
+};
+
+// Relocation counters of a load, from one rel_stats to another
+void copy_relocation_stats(rel_stats const &from, rel_stats *to);
+
+// Persistent results of the relocation phase of one module. A load with the
+// same module, siblings and base patches the recorded sites and stubs instead
+// of decoding and resolving the relocations again. The newest result comes
+// first, a damaged file is treated as empty.
+class reloc_cache
+{
+public:
+  reloc_cache(std::string const &path);
+
+  // Whether the cache is used, see RELOC_CACHE_ENV
+  static bool enabled();
+
+  // Read the result recorded for key
+  bool find(reloc_cache_key const &key, reloc_result *result) const;
+
+  // Add result in front of the others, the oldest beyond RELOC_CACHE_RECORDS are dropped
+  bool store(reloc_result const &result) const;
+
+  std::string const & path() const { return m_path; }
+
+private:
+  std::string m_path;
+};
+
+#endif // #ifndef __RELOC_CACHE_H__
@@ -0,0 +1,101 @@
+#include "reloc_kernels.h"
+#include "rel_track.h"
+#include <array>
+
+// Word at the site before any relocation. On load that is the file's, a
+// rebase reads the original bytes the database kept.
+template <reloc_mode mode>
+static bool original_word(patch_batch const &patches, reloc_args const &args, uint32_t *word)
+{
+  if ( mode == RELOC_REBASE )
+  {
+    *word = static_cast<uint32_t>(get_original_dword(args.m_site));
+    return true;
+  }
+  return patches.original32(args.m_section, args.m_offset, word);
+}
+
+static bool patch_none(patch_batch & /*patches*/, reloc_args const & /*args*/)
+{
+  return true;
+}
+
+static bool patch_word(patch_batch &patches, reloc_args const &args)
+{
+  return patches.write32(args.m_section, args.m_offset, args.m_value);
+}
+
+// 16 bits of the value, HA adjusts the high half for the signed low half
+template <int shift, bool adjust>
+static bool patch_half(patch_batch &patches, reloc_args const &args)
+{
+  uint32_t value = args.m_value;
+  if ( adjust && (value & 0x8000) == 0x8000 )
+    value += 0x00010000;
+  return patches.write16(args.m_section, args.m_offset, (value >> shift) & 0xFFFF);
+}
+
+// The bits in mask of the original word, branches keep their opcode and flags
+template <reloc_mode mode, uint32_t mask, bool relative>
+static bool patch_bits(patch_batch &patches, reloc_args const &args)
+{
+  uint32_t value = args.m_value;
+  if ( relative )
+    value -= static_cast<uint32_t>(args.m_site);
+
+  uint32_t orig;
+  if ( !original_word<mode>(patches, args, &orig) )
+    return false;
+  orig &= ~mask;
+  orig |= value & mask;
+  return patches.write32(args.m_section, args.m_offset, orig);
+}
+
+// The site is patched with the address of the stub, which holds the addend
+template <reloc_apply site>
+static bool patch_external(patch_batch &patches, reloc_args const &args)
+{
+  bool written = site(patches, args);
+  patches.write32(SECTION_IMPORTS, args.m_stub, args.m_addend);
+  return written;
+}
+
+template <reloc_mode mode, reloc_apply site>
+static reloc_kernel make_kernel(uint8_t size, uint8_t calls, bool relative)
+{
+  bool external = mode == RELOC_EXTERNAL && size != 0;
+  return reloc_kernel{ external ? &patch_external<site> : site, size, static_cast<uint8_t>(external ? calls + 1 : calls), relative };
+}
+
+template <reloc_mode mode>
+static std::array<reloc_kernel, 256> build_kernels()
+{
+  std::array<reloc_kernel, 256> kernels = {};
+  kernels[R_PPC_NONE]            = make_kernel<mode, patch_none>(0, 0, false);
+  kernels[R_PPC_ADDR32]          = make_kernel<mode, patch_word>(4, 1, false);
+  kernels[R_PPC_ADDR24]          = make_kernel<mode, patch_bits<mode, 0x03FFFFFC, false> >(4, 2, false);
+  kernels[R_PPC_ADDR16]          = make_kernel<mode, patch_half<0, false> >(2, 1, false);
+  kernels[R_PPC_ADDR16_LO]       = make_kernel<mode, patch_half<0, false> >(2, 1, false);
+  kernels[R_PPC_ADDR16_HI]       = make_kernel<mode, patch_half<16, false> >(2, 1, false);
+  kernels[R_PPC_ADDR16_HA]       = make_kernel<mode, patch_half<16, true> >(2, 1, false);
+  kernels[R_PPC_ADDR14]          = make_kernel<mode, patch_bits<mode, 0x0000FFFC, false> >(4, 2, false);
+  kernels[R_PPC_ADDR14_BRTAKEN]  = make_kernel<mode, patch_bits<mode, 0x0000FFFC, false> >(4, 2, false);
+  kernels[R_PPC_ADDR14_BRNTAKEN] = make_kernel<mode, patch_bits<mode, 0x0000FFFC, false> >(4, 2, false);
+  kernels[R_PPC_REL24]           = make_kernel<mode, patch_bits<mode, 0x03FFFFFC, true> >(4, 2, true);
+  kernels[R_PPC_REL14]           = make_kernel<mode, patch_bits<mode, 0x0000FFFC, true> >(4, 2, true);
+  kernels[R_DOLPHIN_MRKREF]      = make_kernel<mode, patch_none>(0, 0, false);
+  return kernels;
+}
+
+reloc_kernel const * reloc_kernels(reloc_mode mode)
+{
+  static std::array<reloc_kernel, 256> const self     = build_kernels<RELOC_SELF>();
+  static std::array<reloc_kernel, 256> const external = build_kernels<RELOC_EXTERNAL>();
+  static std::array<reloc_kernel, 256> const rebase   = build_kernels<RELOC_REBASE>();
+  switch ( mode )
+  {
+  case RELOC_SELF:     return self.data();
+  case RELOC_EXTERNAL: return external.data();
+  default:             return rebase.data();
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef __RELOC_KERNELS_H__
+#define __RELOC_KERNELS_H__
+
+#include "rel.h"
+#include "patch_batch.h"
+
+// Where a relocation is applied
+enum reloc_mode
+{
+  RELOC_SELF,       // against this module, on load
+  RELOC_EXTERNAL,   // against an import stub, on load; the stub gets the addend
+  RELOC_REBASE,     // again after a rebase, the original word comes from the database
+  RELOC_MODES
+};
+
+// One relocation, decoded
+struct reloc_args
+{
+  uint8_t  m_section;   // of the site
+  uint32_t m_offset;    // of the site in its section
+  ea_t     m_site;      // P, address of the site
+  uint32_t m_value;     // S + A, the target
+  uint32_t m_stub;      // offset of the stub in SECTION_IMPORTS, RELOC_EXTERNAL only
+  uint32_t m_addend;    // written to the stub, RELOC_EXTERNAL only
+};
+
+typedef bool (*reloc_apply)(patch_batch &patches, reloc_args const &args);
+
+// How one relocation type is applied. Every type of rel.h has one, except
+// the R_DOLPHIN_NOP, R_DOLPHIN_SECTION and R_DOLPHIN_END stream operations.
+struct reloc_kernel
+{
+  reloc_apply m_apply;   // false if the site is outside of its section, null for unknown types
+  uint8_t m_size;        // bytes written at the site, 0 for the types that only mark it
+  uint8_t m_calls;       // database calls the site would take when patched on its own
+  bool m_relative;       // the value is relative to the site
+};
+
+// Kernels of a mode, indexed by relocation type
+reloc_kernel const * reloc_kernels(reloc_mode mode);
+
+#endif // #ifndef __RELOC_KERNELS_H__
@@ -0,0 +1,411 @@
+#include "symbol_map.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SYMBOL_MAP_SSE2 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+static inline unsigned lowest_bit(unsigned mask) { unsigned long index; _BitScanForward(&index, mask); return index; }
+#else
+static inline unsigned lowest_bit(unsigned mask) { return static_cast<unsigned>(__builtin_ctz(mask)); }
+#endif
+
+#define MEMORY_MAP_TAG     "Memory map:"
+#define SECTION_LAYOUT_TAG " section layout"
+
+// Find needle in [p, end). Candidates are filtered 16 bytes at a time by
+// comparing the first and last needle characters, then verified.
+static char const * find_text(char const *p, char const *end, char const *needle, size_t length)
+{
+  if ( length == 0 || static_cast<size_t>(end - p) < length )
+    return nullptr;
+
+  char const *last = end - length;
+#ifdef SYMBOL_MAP_SSE2
+  __m128i const first_char = _mm_set1_epi8(needle[0]);
+  __m128i const last_char  = _mm_set1_epi8(needle[length - 1]);
+  for ( ; p + 16 <= last + 1; p += 16 )
+  {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + length - 1));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first_char), _mm_cmpeq_epi8(b, last_char))));
+    while ( mask != 0 )
+    {
+      unsigned bit = lowest_bit(mask);
+      if ( length <= 2 || memcmp(p + bit + 1, needle + 1, length - 2) == 0 )
+        return p + bit;
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for ( ; p <= last; ++p )
+  {
+    if ( *p == needle[0] && memcmp(p, needle, length) == 0 )
+      return p;
+  }
+  return nullptr;
+}
+
+// Find the next '\n' in [p, end), or end
+static char const * find_line_end(char const *p, char const *end)
+{
+#ifdef SYMBOL_MAP_SSE2
+  __m128i const newline = _mm_set1_epi8('\n');
+  for ( ; p + 16 <= end; p += 16 )
+  {
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const *>(p)), newline)));
+    if ( mask != 0 )
+      return p + lowest_bit(mask);
+  }
+#endif
+  char const *nl = static_cast<char const *>(memchr(p, '\n', end - p));
+  return nl != nullptr ? nl : end;
+}
+
+static inline bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Trim a line in place the way qstring::trim2 does
+static inline void trim(char const *&begin, char const *&end)
+{
+  while ( begin < end && is_space(*begin) )
+    ++begin;
+  while ( end > begin && is_space(end[-1]) )
+    --end;
+}
+
+static inline int hex_digit(char c)
+{
+  if ( c >= '0' && c <= '9' ) return c - '0';
+  if ( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+  if ( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+  return -1;
+}
+
+// Decode up to max_digits hex digits after optional blanks, like "%0Nx"
+static inline bool parse_hex(char const *&p, char const *end, int max_digits, uint32_t *value)
+{
+  while ( p < end && is_space(*p) )
+    ++p;
+
+  uint32_t result = 0;
+  int digits = 0;
+  for ( int d; digits < max_digits && p < end && (d = hex_digit(*p)) >= 0; ++p, ++digits )
+    result = (result << 4) | static_cast<uint32_t>(d);
+
+  *value = result;
+  return digits != 0;
+}
+
+static inline bool parse_dec(char const *&p, char const *end, uint32_t *value)
+{
+  while ( p < end && is_space(*p) )
+    ++p;
+
+  uint32_t result = 0;
+  char const *start = p;
+  for ( ; p < end && *p >= '0' && *p <= '9'; ++p )
+    result = result * 10 + static_cast<uint32_t>(*p - '0');
+
+  *value = result;
+  return p != start;
+}
+
+// Next blank separated token, like "%511s"
+static inline bool parse_token(char const *&p, char const *end, char const **begin, size_t *length)
+{
+  while ( p < end && is_space(*p) )
+    ++p;
+
+  *begin = p;
+  while ( p < end && !is_space(*p) && p - *begin < 511 )
+    ++p;
+
+  *length = static_cast<size_t>(p - *begin);
+  return *length != 0;
+}
+
+symbol_map::symbol_map()
+  : m_memory_map(0), m_threads(1)
+{}
+
+bool symbol_map::open(char const *path)
+{
+  return m_buffer.map(path);
+}
+
+bool symbol_map::parse()
+{
+  msg("Symbol Loader: Map File Size: %08X\n", static_cast<uint32_t>(m_buffer.size()));
+
+  // If there's less than 0x800 bytes, it's probably not a valid symbol map.
+  if ( m_buffer.size() < 0x800 )
+    return err_msg("Symbol Loader: Symbol file was too small to be a symbol map!");
+
+  if ( !this->parse_memory_map() )
+    return false;
+
+  this->find_layouts();
+
+  m_symbols.clear();
+  m_names.clear();
+
+  unsigned hardware = std::thread::hardware_concurrency();
+  if ( m_buffer.size() < SYMBOL_MAP_PARALLEL_THRESHOLD || hardware <= 1 )
+  {
+    m_threads = 1;
+    m_symbols.reserve(m_buffer.size() / 64);
+    m_names.reserve(m_buffer.size() / 4);
+    for ( size_t i = 0; i < m_layouts.size(); ++i )
+      this->parse_layout(static_cast<uint16_t>(i), m_layouts[i].m_begin, m_layouts[i].m_end, m_symbols, m_names);
+    return true;
+  }
+
+  // A few chunks per worker keeps the pool busy when blocks differ in density
+  std::vector<map_chunk> chunks;
+  this->split_layouts(chunks, m_memory_map / (hardware * 4) + 1);
+  m_threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(hardware, chunks.size())));
+  this->parse_chunks(chunks, m_threads);
+
+  // Merge in file order, rebasing the name offsets onto the shared arena
+  size_t symbol_count = 0, name_size = 0;
+  for ( map_chunk const &chunk : chunks )
+  {
+    symbol_count += chunk.m_symbols.size();
+    name_size += chunk.m_names.size();
+  }
+
+  m_symbols.reserve(symbol_count);
+  m_names.reserve(name_size);
+  for ( map_chunk &chunk : chunks )
+  {
+    uint32_t name_base = static_cast<uint32_t>(m_names.size());
+    for ( map_symbol symbol : chunk.m_symbols )
+    {
+      symbol.m_name_offset += name_base;
+      m_symbols.push_back(symbol);
+    }
+    m_names.append(chunk.m_names);
+
+    std::vector<map_symbol>().swap(chunk.m_symbols);
+    std::string().swap(chunk.m_names);
+  }
+
+  msg("Symbol Loader: Parsed %u chunks on %u threads\n", static_cast<uint32_t>(chunks.size()), m_threads);
+  return true;
+}
+
+bool symbol_map::parse_memory_map()
+{
+  char const *begin = reinterpret_cast<char const *>(m_buffer.data());
+  char const *end   = begin + m_buffer.size();
+
+  // The memory map is at the very end, look for it there first
+  char const *tag = find_text(end - 0x800, end, MEMORY_MAP_TAG, sizeof(MEMORY_MAP_TAG) - 1);
+  if ( tag == nullptr )
+    tag = find_text(begin, end, MEMORY_MAP_TAG, sizeof(MEMORY_MAP_TAG) - 1);
+  if ( tag == nullptr )
+    return err_msg("Symbol Loader: The symbol map has no memory map");
+
+  m_memory_map = static_cast<size_t>(tag - begin);
+  m_sections.clear();
+
+  char const *line = find_line_end(tag, end);
+  while ( line < end )
+  {
+    char const *line_begin = line + 1;
+    char const *line_end = find_line_end(line_begin, end);
+    line = line_end;
+
+    char const *text_begin = line_begin, *text_end = line_end;
+    trim(text_begin, text_end);
+
+    // Skip the column headers and blank lines
+    if ( text_begin == text_end ||
+         find_text(line_begin, line_end, "Starting", 8) != nullptr ||
+         find_text(line_begin, line_end, "address", 7) != nullptr ||
+         line_end - line_begin < 19 )
+      continue;
+
+    map_section section;
+    char const *name_begin = line_begin, *name_end = line_begin + 19;
+    trim(name_begin, name_end);
+    section.m_name.assign(name_begin, name_end);
+
+    char const *p = line_begin + 19;
+    if ( !parse_hex(p, line_end, 8, &section.m_address) || !parse_hex(p, line_end, 8, &section.m_size) ||
+         !parse_hex(p, line_end, 8, &section.m_file_offset) )
+      continue;
+
+    msg("Symbol Loader: Section found! Name: %s | Address: %08X | Size: %08X | File Address: %08X\n",
+      section.m_name.c_str(), section.m_address, section.m_size, section.m_file_offset);
+    m_sections.emplace_back(std::move(section));
+  }
+
+  return !m_sections.empty() || err_msg("Symbol Loader: The memory map was empty");
+}
+
+void symbol_map::find_layouts()
+{
+  char const *begin = reinterpret_cast<char const *>(m_buffer.data());
+  char const *end   = begin + m_memory_map;
+
+  m_layouts.clear();
+  char const *p = begin;
+  while ( (p = find_text(p, end, SECTION_LAYOUT_TAG, sizeof(SECTION_LAYOUT_TAG) - 1)) != nullptr )
+  {
+    // The section name is the start of the line
+    char const *line_begin = p;
+    while ( line_begin > begin && line_begin[-1] != '\n' )
+      --line_begin;
+
+    char const *name_begin = line_begin, *name_end = p;
+    trim(name_begin, name_end);
+
+    // The previous block ends where this header starts
+    if ( !m_layouts.empty() )
+      m_layouts.back().m_end = static_cast<size_t>(line_begin - begin);
+
+    map_layout layout;
+    layout.m_name.assign(name_begin, name_end);
+    layout.m_begin = static_cast<size_t>(find_line_end(p, end) - begin);
+    layout.m_end   = m_memory_map;
+    m_layouts.emplace_back(std::move(layout));
+
+    p = begin + layout.m_begin;
+  }
+}
+
+void symbol_map::split_layouts(std::vector<map_chunk> &chunks, size_t chunk_size) const
+{
+  char const *base = reinterpret_cast<char const *>(m_buffer.data());
+
+  for ( size_t i = 0; i < m_layouts.size(); ++i )
+  {
+    map_layout const &layout = m_layouts[i];
+    size_t begin = layout.m_begin;
+    while ( begin < layout.m_end )
+    {
+      // Cut after the newline ending the line that crosses the chunk size
+      size_t end = layout.m_end;
+      if ( end - begin > chunk_size )
+      {
+        char const *cut = find_line_end(base + begin + chunk_size, base + layout.m_end);
+        end = std::min(static_cast<size_t>(cut - base) + 1, layout.m_end);
+      }
+
+      map_chunk chunk;
+      chunk.m_begin = begin;
+      chunk.m_end = end;
+      chunk.m_layout = static_cast<uint16_t>(i);
+      chunks.emplace_back(std::move(chunk));
+      begin = end;
+    }
+  }
+}
+
+// Workers only touch the mapped file and their own chunks; nothing here may
+// call into the kernel.
+void symbol_map::parse_chunks(std::vector<map_chunk> &chunks, unsigned threads) const
+{
+  std::atomic<size_t> next(0);
+  auto worker = [&]()
+  {
+    for ( size_t i; (i = next.fetch_add(1)) < chunks.size(); )
+    {
+      map_chunk &chunk = chunks[i];
+      chunk.m_symbols.reserve((chunk.m_end - chunk.m_begin) / 64);
+      chunk.m_names.reserve((chunk.m_end - chunk.m_begin) / 4);
+      this->parse_layout(chunk.m_layout, chunk.m_begin, chunk.m_end, chunk.m_symbols, chunk.m_names);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for ( unsigned i = 1; i < threads; ++i )
+    pool.emplace_back(worker);
+  worker();
+  for ( std::thread &thread : pool )
+    thread.join();
+}
+
+void symbol_map::parse_layout(uint16_t index, size_t begin, size_t end_offset, std::vector<map_symbol> &symbols, std::string &names) const
+{
+  map_layout const &layout = m_layouts[index];
+  char const *base = reinterpret_cast<char const *>(m_buffer.data());
+  char const *end  = base + end_offset;
+
+  char const *line = base + begin;
+  while ( line < end )
+  {
+    char const *line_begin = line + (*line == '\n' ? 1 : 0);
+    char const *line_end = find_line_end(line_begin, end);
+    line = line_end;
+
+    char const *text = line_begin, *text_end = line_end;
+    trim(text, text_end);
+    if ( text == text_end || hex_digit(*text) < 0 )
+      continue; // blank lines and column headers
+
+    // Rows mentioning the section itself describe objects, not symbols
+    if ( find_text(text, text_end, layout.m_name.c_str(), layout.m_name.size()) != nullptr )
+      continue;
+
+    map_symbol symbol;
+    symbol.m_layout = index;
+
+    char const *p = text;
+    if ( !parse_hex(p, text_end, 8, &symbol.m_address) || !parse_hex(p, text_end, 6, &symbol.m_size) ||
+         !parse_hex(p, text_end, 8, &symbol.m_vaddress) )
+      continue;
+
+    char const *token;
+    size_t token_length;
+    char const *container = nullptr;
+    size_t container_length = 0;
+
+    size_t length = static_cast<size_t>(text_end - text);
+    if ( length > 27 && text[27] != ' ' )
+    {
+      // Three columns, the name may be an entry of another symbol
+      symbol.m_alignment = 0;
+      if ( !parse_token(p, text_end, &token, &token_length) )
+        continue;
+
+      char const *entry = find_text(p, text_end, "(entry of ", 10);
+      if ( entry != nullptr && entry + 10 < text_end && entry[10] != '.' )
+      {
+        char const *q = entry + 10;
+        if ( parse_token(q, text_end, &container, &container_length) )
+        {
+          char const *close = static_cast<char const *>(memchr(container, ')', container_length));
+          if ( close != nullptr )
+            container_length = static_cast<size_t>(close - container);
+        }
+      }
+    }
+    else
+    {
+      if ( !parse_dec(p, text_end, &symbol.m_alignment) || !parse_token(p, text_end, &token, &token_length) )
+        continue;
+    }
+
+    symbol.m_name_offset = static_cast<uint32_t>(names.size());
+    if ( container != nullptr )
+    {
+      names.append(container, container_length);
+      names.append("::");
+    }
+    names.append(token, token_length);
+    names.push_back('\0');
+    symbols.push_back(symbol);
+  }
+}
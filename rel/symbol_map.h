@@ -0,0 +1,89 @@
+#ifndef __SYMBOL_MAP_H__
+#define __SYMBOL_MAP_H__
+
+#include "rel.h"
+#include "../loader/input_buffer.h"
+#include <string>
+#include <vector>
+
+// Maps smaller than this are parsed on the calling thread
+#define SYMBOL_MAP_PARALLEL_THRESHOLD (8 * 1024 * 1024)
+
+// Section listed in the "Memory map:" table at the end of a map file
+struct map_section
+{
+  std::string m_name;
+  uint32_t m_address;
+  uint32_t m_size;
+  uint32_t m_file_offset;
+};
+
+// A "<section> section layout" block
+struct map_layout
+{
+  std::string m_name;
+  size_t m_begin;   // byte range of the block body
+  size_t m_end;
+};
+
+// One symbol row of a section layout block
+struct map_symbol
+{
+  uint32_t m_address;
+  uint32_t m_size;
+  uint32_t m_vaddress;
+  uint32_t m_alignment;
+  uint32_t m_name_offset;   // into the name arena
+  uint16_t m_layout;        // index into layouts()
+};
+
+// A run of whole lines of one layout block, parsed independently
+struct map_chunk
+{
+  size_t m_begin;
+  size_t m_end;
+  uint16_t m_layout;
+  std::vector<map_symbol> m_symbols;
+  std::string m_names;
+};
+
+// Single pass parser for CodeWarrior linker maps. The file is memory-mapped,
+// lines and block headers are found with vectorized scans and the hex
+// columns are decoded by hand. Large maps are cut into chunks on layout and
+// line boundaries which are parsed on a pool of worker threads and merged
+// back in file order.
+class symbol_map
+{
+public:
+  symbol_map();
+
+  bool open(char const *path);
+  bool parse();
+
+  std::vector<map_section> const & sections() const { return m_sections; }
+  std::vector<map_layout> const & layouts() const { return m_layouts; }
+  std::vector<map_symbol> const & symbols() const { return m_symbols; }
+
+  char const * name(map_symbol const &symbol) const { return m_names.c_str() + symbol.m_name_offset; }
+
+  size_t file_size() const { return m_buffer.size(); }
+  unsigned threads() const { return m_threads; }
+
+private:
+  bool parse_memory_map();
+  void find_layouts();
+  void split_layouts(std::vector<map_chunk> &chunks, size_t chunk_size) const;
+  void parse_chunks(std::vector<map_chunk> &chunks, unsigned threads) const;
+  void parse_layout(uint16_t index, size_t begin, size_t end, std::vector<map_symbol> &symbols, std::string &names) const;
+
+  input_buffer m_buffer;
+  size_t m_memory_map;   // offset of the "Memory map:" line
+  unsigned m_threads;     // workers used by the last parse()
+
+  std::vector<map_section> m_sections;
+  std::vector<map_layout> m_layouts;
+  std::vector<map_symbol> m_symbols;
+  std::string m_names;   // zero separated
+};
+
+#endif // #ifndef __SYMBOL_MAP_H__
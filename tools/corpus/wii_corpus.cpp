@@ -0,0 +1,1012 @@
+// Synthetic corpus for the loaders: a DOL that uses every text and data slot,
+// REL modules (v1 to v3) that relocate against themselves, each other and the
+// DOL, and a CodeWarrior symbol map for every REL. The DOL and the RELs can
+// be written Yaz0 or Yay0 compressed instead (main.dol.szs, modN.rel.szs),
+// and packed into a GameCube disc image (game.iso) with the RELs in the FST,
+// or into an encrypted Wii disc image (game.iso and game.wbfs). The RELs can
+// also be packed into a U8 archive (rels.arc, rels.arc.szs when compressed)
+// instead of being written on their own.
+//
+//   wii_corpus --out <dir> [options]
+//
+// The output is deterministic for a given seed and set of options, so the
+// files can be regenerated on any machine instead of being checked in.
+#include "../../rel/rel.h"
+#include "../../dol/dol.h"
+#include "../../loader/compression.h"
+#include "../../loader/aes.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#define DOL_TEXT_SLOTS 7
+#define DOL_DATA_SLOTS 11
+#define DOL_BASE       0x80003100
+#define REL_ALIGN      32
+
+#define LZ_WINDOW      0x1000
+#define LZ_MIN_MATCH   3
+#define LZ_HASH_BITS   15
+#define LZ_MAX_CHAIN   64
+
+// Disc image layout, files are aligned like on retail discs
+#define DISC_ID         "GWCE01"
+#define DISC_DOL_AT     0x20000
+#define DISC_ALIGN      0x8000
+
+// Wii disc layout: one data partition, its data right after the header.
+// The common key is made up from the seed and written next to the image,
+// it only has to match the one the image was encrypted with.
+#define WII_GROUPS_AT   0x40000
+#define WII_TABLE_AT    0x40020
+#define WII_PARTITION_AT 0x50000
+#define WII_DATA_AT     0x20000   // from the partition
+#define WII_CLUSTER     0x8000
+#define WII_HASHES      0x400
+#define WBFS_HD_SHIFT   9
+#define WBFS_SHIFT      21
+#define WBFS_SECTORS    ((143432u * 2 * WII_CLUSTER) >> WBFS_SHIFT)
+
+// U8 archive, file data aligned like in Nintendo's archives
+#define ARC_ALIGN       0x20
+
+struct corpus_options
+{
+  std::string m_out;
+  uint32_t m_seed = 1;
+  uint32_t m_modules = 4;
+  uint32_t m_version = 0;          // 0 cycles through 1, 2 and 3
+  uint32_t m_sections = 8;         // including the null and .bss sections
+  uint32_t m_section_size = 0x10000;
+  uint32_t m_relocs = 20000;       // self relocations per module
+  uint32_t m_imports = 3;          // imported modules per module, the DOL included
+  uint32_t m_import_relocs = 5000; // relocations per imported module
+  uint32_t m_symbols = 4000;       // symbols per map
+  uint32_t m_dol_slot_size = 0x20000;
+  bool m_maps = true;
+  compression_format m_compress = COMPRESSION_NONE;
+  bool m_disc = false;
+  bool m_wii = false;
+  bool m_arc = false;
+
+  // relocation mix: ADDR32, ADDR16_LO, ADDR16_HA, REL24, DOLPHIN_NOP, and
+  // the other types of rel.h picked evenly
+  uint32_t m_mix[6] = { 2, 3, 3, 4, 0, 0 };
+};
+
+// xorshift32, good enough to spread offsets and addends
+class corpus_random
+{
+public:
+  explicit corpus_random(uint32_t seed) : m_state(seed != 0 ? seed : 0x9E3779B9) {}
+
+  uint32_t next()
+  {
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return m_state;
+  }
+
+  uint32_t below(uint32_t limit) { return limit == 0 ? 0 : next() % limit; }
+
+private:
+  uint32_t m_state;
+};
+
+class be_writer
+{
+public:
+  size_t pos() const { return m_data.size(); }
+  std::vector<uint8_t> const & data() const { return m_data; }
+
+  void u8(uint8_t value) { m_data.push_back(value); }
+  void u16(uint16_t value) { u8(static_cast<uint8_t>(value >> 8)); u8(static_cast<uint8_t>(value)); }
+  void u32(uint32_t value) { u16(static_cast<uint16_t>(value >> 16)); u16(static_cast<uint16_t>(value)); }
+
+  void zeros(size_t count) { m_data.resize(m_data.size() + count, 0); }
+  void align(size_t alignment) { zeros((alignment - m_data.size() % alignment) % alignment); }
+
+  void random(corpus_random &rnd, size_t count)
+  {
+    for ( size_t i = 0; i < count; ++i )
+      u8(static_cast<uint8_t>(rnd.next()));
+  }
+
+  uint8_t & data_at(size_t offset) { return m_data[offset]; }
+
+  void patch32(size_t offset, uint32_t value)
+  {
+    m_data[offset + 0] = static_cast<uint8_t>(value >> 24);
+    m_data[offset + 1] = static_cast<uint8_t>(value >> 16);
+    m_data[offset + 2] = static_cast<uint8_t>(value >> 8);
+    m_data[offset + 3] = static_cast<uint8_t>(value);
+  }
+
+  void bytes(uint8_t const *data, size_t count) { m_data.insert(m_data.end(), data, data + count); }
+
+  bool save(std::string const &path) const
+  {
+    FILE *fp = fopen(path.c_str(), "wb");
+    if ( fp == nullptr )
+      return false;
+    bool ok = fwrite(m_data.data(), 1, m_data.size(), fp) == m_data.size();
+    return fclose(fp) == 0 && ok;
+  }
+
+private:
+  std::vector<uint8_t> m_data;
+};
+
+struct corpus_section
+{
+  std::string m_name;
+  uint32_t m_size;
+  bool m_exec;
+  bool m_bss;
+};
+
+struct corpus_dol
+{
+  uint32_t m_begin;   // loaded address range, text and data
+  uint32_t m_end;
+};
+
+//--------------------------------------------------------------------------
+// Greedy LZ matcher with hash chains, emitting Yaz0 (flags, references and
+// literals interleaved) or Yay0 (three streams). Not as tight as Nintendo's
+// encoder, but any valid stream exercises the decoders the same way.
+static std::vector<uint8_t> lz_compress(std::vector<uint8_t> const &data, compression_format format)
+{
+  uint32_t const size = static_cast<uint32_t>(data.size());
+  std::vector<int32_t> head(1u << LZ_HASH_BITS, -1);
+  std::vector<int32_t> chain(size, -1);
+  auto hash = [&](uint32_t pos)
+  {
+    uint32_t value = (data[pos] << 16) | (data[pos + 1] << 8) | data[pos + 2];
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+  };
+  auto insert = [&](uint32_t pos)
+  {
+    if ( pos + LZ_MIN_MATCH > size )
+      return;
+    uint32_t h = hash(pos);
+    chain[pos] = head[h];
+    head[h] = static_cast<int32_t>(pos);
+  };
+
+  be_writer flags, links, chunks;   // Yaz0 puts everything into chunks
+  size_t flag_pos = 0;
+  uint32_t flag_bits = 0;
+  uint32_t flag_count = 0;
+  uint32_t const group = format == COMPRESSION_YAZ0 ? 8 : 32;
+  auto next_flag = [&](bool literal)
+  {
+    if ( flag_count == 0 && format == COMPRESSION_YAZ0 )
+    {
+      flag_pos = chunks.pos();
+      chunks.u8(0);
+    }
+    if ( literal )
+      flag_bits |= 1u << (group - 1 - flag_count);
+    if ( ++flag_count == group )
+    {
+      if ( format == COMPRESSION_YAZ0 )
+        chunks.data_at(flag_pos) = static_cast<uint8_t>(flag_bits);
+      else
+        flags.u32(flag_bits);
+      flag_bits = 0;
+      flag_count = 0;
+    }
+  };
+
+  uint32_t pos = 0;
+  while ( pos < size )
+  {
+    uint32_t best_length = 0;
+    uint32_t best_distance = 0;
+    if ( pos + LZ_MIN_MATCH <= size )
+    {
+      uint32_t limit = std::min<uint32_t>(COMPRESSION_MAX_MATCH, size - pos);
+      int32_t candidate = head[hash(pos)];
+      for ( uint32_t steps = 0; candidate >= 0 && steps < LZ_MAX_CHAIN; ++steps, candidate = chain[candidate] )
+      {
+        uint32_t distance = pos - static_cast<uint32_t>(candidate);
+        if ( distance > LZ_WINDOW )
+          break;
+        uint32_t length = 0;
+        while ( length < limit && data[candidate + length] == data[pos + length] )
+          ++length;
+        if ( length > best_length )
+        {
+          best_length = length;
+          best_distance = distance;
+          if ( length == limit )
+            break;
+        }
+      }
+    }
+
+    if ( best_length < LZ_MIN_MATCH )
+    {
+      next_flag(true);
+      chunks.u8(data[pos]);
+      insert(pos++);
+      continue;
+    }
+
+    // Lengths up to 0x11 fit the top nibble, longer ones take a third byte,
+    // which Yay0 keeps with the literals
+    next_flag(false);
+    be_writer &link = format == COMPRESSION_YAZ0 ? chunks : links;
+    uint32_t reference = best_distance - 1;
+    if ( best_length <= 0x11 )
+      link.u16(static_cast<uint16_t>(((best_length - 2) << 12) | reference));
+    else
+    {
+      link.u16(static_cast<uint16_t>(reference));
+      chunks.u8(static_cast<uint8_t>(best_length - 0x12));
+    }
+    for ( uint32_t end = pos + best_length; pos < end; )
+      insert(pos++);
+  }
+  if ( flag_count != 0 )
+  {
+    if ( format == COMPRESSION_YAZ0 )
+      chunks.data_at(flag_pos) = static_cast<uint8_t>(flag_bits);
+    else
+      flags.u32(flag_bits);
+  }
+
+  be_writer out;
+  out.bytes(reinterpret_cast<uint8_t const *>(format == COMPRESSION_YAZ0 ? "Yaz0" : "Yay0"), 4);
+  out.u32(size);
+  if ( format == COMPRESSION_YAZ0 )
+  {
+    out.zeros(8);
+    out.bytes(chunks.data().data(), chunks.pos());
+  }
+  else
+  {
+    uint32_t link_offset = static_cast<uint32_t>(COMPRESSION_HEADER_SIZE + flags.pos());
+    out.u32(link_offset);
+    out.u32(static_cast<uint32_t>(link_offset + links.pos()));
+    out.bytes(flags.data().data(), flags.pos());
+    out.bytes(links.data().data(), links.pos());
+    out.bytes(chunks.data().data(), chunks.pos());
+  }
+  return out.data();
+}
+
+struct disc_entry
+{
+  std::string m_name;
+  std::vector<uint8_t> m_data;
+};
+
+// Files for the disc image: the boot DOL uncompressed, then the RELs as written
+static std::vector<disc_entry> s_disc_files;
+
+// RELs for the archive, uncompressed: the archive is compressed as a whole
+static std::vector<disc_entry> s_arc_files;
+
+// Writes the file as is, or compressed with .szs appended to its name
+static bool save_file(corpus_options const &opts, std::string const &name, std::vector<uint8_t> const &data)
+{
+  be_writer out;
+  std::string path = name;
+  if ( opts.m_compress == COMPRESSION_NONE )
+    out.bytes(data.data(), data.size());
+  else
+  {
+    std::vector<uint8_t> packed = lz_compress(data, opts.m_compress);
+    out.bytes(packed.data(), packed.size());
+    path += ".szs";
+  }
+
+  if ( opts.m_disc )
+    s_disc_files.push_back(disc_entry{ name == "main.dol" ? name : path, name == "main.dol" ? data : out.data() });
+  if ( opts.m_arc && name != "main.dol" )
+  {
+    s_arc_files.push_back(disc_entry{ name, data });
+    return true;
+  }
+  return out.save(opts.m_out + "/" + path);
+}
+
+// U8 archive: root, the rels directory and its files, then the names and
+// the file data. Compressed as a whole with --compress.
+static bool write_arc(corpus_options const &opts)
+{
+  auto align = [](uint32_t value) { return (value + ARC_ALIGN - 1) & ~(ARC_ALIGN - 1); };
+
+  uint32_t count = static_cast<uint32_t>(s_arc_files.size()) + 2;
+  std::string names("\0rels", 6);
+  for ( disc_entry const &file : s_arc_files )
+    names.append(file.m_name.c_str(), file.m_name.size() + 1);
+  uint32_t table_size = count * 12 + static_cast<uint32_t>(names.size());
+  uint32_t data_offset = align(0x20 + table_size);
+
+  be_writer out;
+  out.u32(0x55AA382D);
+  out.u32(0x20);
+  out.u32(table_size);
+  out.u32(data_offset);
+  out.zeros(16);
+  out.u32(0x01000000);
+  out.u32(0);
+  out.u32(count);
+  out.u32(0x01000001);
+  out.u32(0);
+  out.u32(count);
+
+  uint32_t name_offset = 6;
+  uint32_t offset = data_offset;
+  for ( disc_entry const &file : s_arc_files )
+  {
+    out.u32(name_offset);
+    out.u32(offset);
+    out.u32(static_cast<uint32_t>(file.m_data.size()));
+    name_offset += static_cast<uint32_t>(file.m_name.size() + 1);
+    offset = align(offset + static_cast<uint32_t>(file.m_data.size()));
+  }
+  out.bytes(reinterpret_cast<uint8_t const *>(names.data()), names.size());
+  for ( disc_entry const &file : s_arc_files )
+  {
+    out.align(ARC_ALIGN);
+    out.bytes(file.m_data.data(), file.m_data.size());
+  }
+
+  if ( opts.m_compress == COMPRESSION_NONE )
+    return out.save(opts.m_out + "/rels.arc");
+  be_writer packed;
+  std::vector<uint8_t> data = lz_compress(out.data(), opts.m_compress);
+  packed.bytes(data.data(), data.size());
+  return packed.save(opts.m_out + "/rels.arc.szs");
+}
+
+// Disc header, boot DOL, FST with the RELs in /rels. The apploader area is
+// left empty, the loaders do not read it. A Wii partition has the same
+// layout with its own magic and the offsets shifted right by 2.
+static std::vector<uint8_t> disc_contents(bool wii)
+{
+  auto align = [](uint32_t value) { return (value + DISC_ALIGN - 1) & ~(DISC_ALIGN - 1); };
+  uint32_t shift = wii ? 2 : 0;
+
+  // FST: root, the rels directory and its files, then the names
+  uint32_t count = static_cast<uint32_t>(s_disc_files.size()) + 1;
+  std::string names("rels", 5);
+  be_writer fst;
+  fst.u32(0x01000000);
+  fst.u32(0);
+  fst.u32(count);
+  fst.u32(0x01000000);
+  fst.u32(0);
+  fst.u32(count);
+
+  uint32_t dol_size = static_cast<uint32_t>(s_disc_files.front().m_data.size());
+  uint32_t fst_offset = align(DISC_DOL_AT + dol_size);
+  uint32_t fst_size = count * 12 + static_cast<uint32_t>(names.size());
+  for ( size_t i = 1; i < s_disc_files.size(); ++i )
+    fst_size += static_cast<uint32_t>(s_disc_files[i].m_name.size() + 1);
+  fst_size = (fst_size + (1u << shift) - 1) & ~((1u << shift) - 1);
+
+  uint32_t offset = align(fst_offset + fst_size);
+  std::vector<uint32_t> offsets;
+  for ( size_t i = 1; i < s_disc_files.size(); ++i )
+  {
+    fst.u32(static_cast<uint32_t>(names.size()));
+    fst.u32(offset >> shift);
+    fst.u32(static_cast<uint32_t>(s_disc_files[i].m_data.size()));
+    names.append(s_disc_files[i].m_name.c_str(), s_disc_files[i].m_name.size() + 1);
+    offsets.push_back(offset);
+    offset = align(offset + static_cast<uint32_t>(s_disc_files[i].m_data.size()));
+  }
+  fst.bytes(reinterpret_cast<uint8_t const *>(names.data()), names.size());
+
+  be_writer out;
+  out.bytes(reinterpret_cast<uint8_t const *>(DISC_ID), 6);
+  out.zeros(0x18 - out.pos());
+  out.u32(wii ? 0x5D1C9EA3 : 0);
+  out.u32(wii ? 0 : 0xC2339F3D);
+  out.bytes(reinterpret_cast<uint8_t const *>("wii_corpus"), 10);
+  out.zeros(0x420 - out.pos());
+  out.u32(DISC_DOL_AT >> shift);
+  out.u32(fst_offset >> shift);
+  out.u32(fst_size >> shift);
+  out.u32(fst_size >> shift);
+  out.zeros(DISC_DOL_AT - out.pos());
+  out.bytes(s_disc_files.front().m_data.data(), dol_size);
+  out.zeros(fst_offset - out.pos());
+  out.bytes(fst.data().data(), fst.pos());
+  for ( size_t i = 1; i < s_disc_files.size(); ++i )
+  {
+    out.zeros(offsets[i - 1] - out.pos());
+    out.bytes(s_disc_files[i].m_data.data(), s_disc_files[i].m_data.size());
+  }
+  out.zeros(align(static_cast<uint32_t>(out.pos())) - out.pos());
+  return out.data();
+}
+
+static void random_key(corpus_random &rnd, uint8_t key[AES_BLOCK_SIZE])
+{
+  for ( size_t i = 0; i < AES_BLOCK_SIZE; ++i )
+    key[i] = static_cast<uint8_t>(rnd.next());
+}
+
+// Wii disc image: the partition contents are split into clusters of 0x7C00
+// bytes, each encrypted with the title key behind a hash area whose last
+// 16 encrypted bytes are its IV. The hashes are left zero, the loaders do
+// not check them.
+static bool write_wii_disc(corpus_options const &opts, std::vector<uint8_t> const &contents)
+{
+  corpus_random rnd(opts.m_seed ^ 0x5D1C9EA3);
+  uint8_t common_key[AES_BLOCK_SIZE], title_key[AES_BLOCK_SIZE];
+  random_key(rnd, common_key);
+  random_key(rnd, title_key);
+  uint8_t title_id[8] = { 0x00, 0x01, 0x00, 0x00, 'G', 'W', 'C', 'E' };
+
+  be_writer key_file;
+  key_file.bytes(common_key, sizeof(common_key));
+  if ( !key_file.save(opts.m_out + "/common-key.bin") )
+    return false;
+
+  aes128 common, title;
+  common.set_key(common_key);
+  title.set_key(title_key);
+
+  uint32_t data_size = WII_CLUSTER - WII_HASHES;
+  uint32_t clusters = static_cast<uint32_t>((contents.size() + data_size - 1) / data_size);
+
+  be_writer out;
+  out.bytes(contents.data(), 0x20 + 10);
+  out.zeros(WII_GROUPS_AT - out.pos());
+  out.u32(1);
+  out.u32(WII_TABLE_AT >> 2);
+  out.zeros(WII_TABLE_AT - out.pos());
+  out.u32(WII_PARTITION_AT >> 2);
+  out.u32(0);
+
+  // Ticket with the title key encrypted with the common key, then the
+  // partition header
+  out.zeros(WII_PARTITION_AT - out.pos());
+  out.u32(0x00010001);
+  out.zeros(WII_PARTITION_AT + 0x1BF - out.pos());
+  uint8_t iv[AES_BLOCK_SIZE] = {};
+  std::copy(title_id, title_id + 8, iv);
+  uint8_t encrypted_key[AES_BLOCK_SIZE];
+  common.encrypt_cbc(iv, title_key, encrypted_key, sizeof(encrypted_key));
+  out.bytes(encrypted_key, sizeof(encrypted_key));
+  out.zeros(WII_PARTITION_AT + 0x1DC - out.pos());
+  out.bytes(title_id, sizeof(title_id));
+  out.zeros(WII_PARTITION_AT + 0x2B8 - out.pos());
+  out.u32(WII_DATA_AT >> 2);
+  out.u32((clusters * WII_CLUSTER) >> 2);
+  out.zeros(WII_PARTITION_AT + WII_DATA_AT - out.pos());
+
+  std::vector<uint8_t> plain(WII_CLUSTER), cluster(WII_CLUSTER);
+  for ( uint32_t i = 0; i < clusters; ++i )
+  {
+    std::fill(plain.begin(), plain.end(), 0);
+    size_t from = size_t(i) * data_size;
+    size_t count = std::min<size_t>(data_size, contents.size() - from);
+    std::copy(contents.begin() + from, contents.begin() + from + count, plain.begin() + WII_HASHES);
+
+    // Hashes under a zero IV, so the data IVs differ between clusters the
+    // cluster number goes into the otherwise unused hashes
+    uint8_t zero_iv[AES_BLOCK_SIZE] = {};
+    plain[0x3D0] = static_cast<uint8_t>(i >> 8);
+    plain[0x3D1] = static_cast<uint8_t>(i);
+    title.encrypt_cbc(zero_iv, plain.data(), cluster.data(), WII_HASHES);
+    title.encrypt_cbc(&cluster[0x3D0], plain.data() + WII_HASHES, cluster.data() + WII_HASHES, data_size);
+    out.bytes(cluster.data(), cluster.size());
+  }
+  if ( !out.save(opts.m_out + "/game.iso") )
+    return false;
+
+  // The same disc in a WBFS container, sectors of zeros are not stored
+  std::vector<uint8_t> const &iso = out.data();
+  size_t sector_size = size_t(1) << WBFS_SHIFT;
+  be_writer wbfs;
+  wbfs.u32(0x57424653);
+  wbfs.u32(0);
+  wbfs.u8(WBFS_HD_SHIFT);
+  wbfs.u8(WBFS_SHIFT);
+  wbfs.zeros(2);
+  wbfs.u8(1);
+  wbfs.zeros((size_t(1) << WBFS_HD_SHIFT) - wbfs.pos());
+  wbfs.bytes(iso.data(), 0x100);
+  size_t table = wbfs.pos();
+  wbfs.zeros(WBFS_SECTORS * 2);
+  wbfs.zeros(sector_size - wbfs.pos());
+
+  uint16_t stored = 0;
+  for ( size_t sector = 0; sector * sector_size < iso.size(); ++sector )
+  {
+    size_t from = sector * sector_size;
+    size_t count = std::min(sector_size, iso.size() - from);
+    if ( std::all_of(iso.begin() + from, iso.begin() + from + count, [](uint8_t b) { return b == 0; }) )
+      continue;
+    ++stored;
+    wbfs.data_at(table + sector * 2) = static_cast<uint8_t>(stored >> 8);
+    wbfs.data_at(table + sector * 2 + 1) = static_cast<uint8_t>(stored);
+    wbfs.bytes(iso.data() + from, count);
+    wbfs.zeros(sector_size - count);
+  }
+  wbfs.patch32(4, static_cast<uint32_t>(wbfs.pos() >> WBFS_HD_SHIFT));
+  return wbfs.save(opts.m_out + "/game.wbfs");
+}
+
+static bool write_disc(corpus_options const &opts)
+{
+  std::vector<uint8_t> contents = disc_contents(opts.m_wii);
+  if ( opts.m_wii )
+    return write_wii_disc(opts, contents);
+
+  be_writer out;
+  out.bytes(contents.data(), contents.size());
+  return out.save(opts.m_out + "/game.iso");
+}
+
+//--------------------------------------------------------------------------
+static bool write_dol(corpus_options const &opts, corpus_random &rnd, corpus_dol *layout)
+{
+  uint32_t slot = (opts.m_dol_slot_size + 0x1F) & ~0x1F;
+  uint32_t offsets[DOL_TEXT_SLOTS + DOL_DATA_SLOTS];
+  uint32_t addresses[DOL_TEXT_SLOTS + DOL_DATA_SLOTS];
+
+  // Text and data follow each other in the file and in memory
+  for ( uint32_t i = 0; i < DOL_TEXT_SLOTS + DOL_DATA_SLOTS; ++i )
+  {
+    offsets[i] = 0x100 + i * slot;
+    addresses[i] = DOL_BASE + i * slot;
+  }
+
+  be_writer out;
+  for ( uint32_t i = 0; i < DOL_TEXT_SLOTS + DOL_DATA_SLOTS; ++i )
+    out.u32(offsets[i]);
+  for ( uint32_t i = 0; i < DOL_TEXT_SLOTS + DOL_DATA_SLOTS; ++i )
+    out.u32(addresses[i]);
+  for ( uint32_t i = 0; i < DOL_TEXT_SLOTS + DOL_DATA_SLOTS; ++i )
+    out.u32(slot);
+
+  layout->m_begin = DOL_BASE;
+  layout->m_end = DOL_BASE + (DOL_TEXT_SLOTS + DOL_DATA_SLOTS) * slot;
+  out.u32(layout->m_end);   // .bss
+  out.u32(slot * 2);
+  out.u32(DOL_BASE);        // entry point
+  out.zeros(0x100 - out.pos());
+
+  out.random(rnd, (DOL_TEXT_SLOTS + DOL_DATA_SLOTS) * slot);
+  return save_file(opts, "main.dol", out.data());
+}
+
+//--------------------------------------------------------------------------
+static std::vector<corpus_section> rel_sections(corpus_options const &opts)
+{
+  static char const *const data_names[] = { ".ctors", ".dtors", ".rodata", ".data", ".sdata", ".sdata2" };
+
+  std::vector<corpus_section> sections;
+  sections.push_back({ "", 0, false, false });
+  sections.push_back({ ".text", opts.m_section_size, true, false });
+  for ( uint32_t i = 2; i + 1 < opts.m_sections; ++i )
+  {
+    uint32_t k = i - 2;
+    std::string name = k < 6 ? data_names[k] : ".data" + std::to_string(static_cast<unsigned long long>(k));
+    uint32_t size = std::max<uint32_t>(0x40, (opts.m_section_size >> (k % 4)) & ~3);
+    sections.push_back({ name, size, false, false });
+  }
+  sections.push_back({ ".bss", std::max<uint32_t>(0x40, opts.m_section_size / 2), false, true });
+  return sections;
+}
+
+// One relocation target: an (import id, section, addend) triple
+static void pick_target(corpus_random &rnd, uint32_t target_id, std::vector<corpus_section> const &sections,
+                        corpus_dol const &dol, uint8_t *section, uint32_t *addend)
+{
+  if ( target_id == 0 )
+  {
+    // The DOL is addressed absolutely
+    *section = 0;
+    *addend = (dol.m_begin + rnd.below(dol.m_end - dol.m_begin)) & ~3;
+    return;
+  }
+
+  uint32_t s = 1 + rnd.below(static_cast<uint32_t>(sections.size() - 1));
+  *section = static_cast<uint8_t>(s);
+  *addend = rnd.below(sections[s].m_size) & ~3;
+}
+
+static uint8_t pick_type(corpus_options const &opts, corpus_random &rnd, bool exec)
+{
+  static uint8_t const types[] = { R_PPC_ADDR32, R_PPC_ADDR16_LO, R_PPC_ADDR16_HA, R_PPC_REL24, R_DOLPHIN_NOP, R_PPC_NONE };
+  static uint8_t const others[] = { R_PPC_ADDR24, R_PPC_ADDR16, R_PPC_ADDR16_HI, R_PPC_ADDR14, R_PPC_ADDR14_BRTAKEN,
+                                    R_PPC_ADDR14_BRNTAKEN, R_DOLPHIN_MRKREF, R_PPC_REL14 };
+
+  uint32_t total = 0;
+  for ( int i = 0; i < 6; ++i )
+    total += (types[i] == R_PPC_REL24 && !exec) ? 0 : opts.m_mix[i];
+  if ( total == 0 )
+    return R_PPC_ADDR32;
+
+  uint32_t pick = rnd.below(total);
+  for ( int i = 0; i < 6; ++i )
+  {
+    uint32_t weight = (types[i] == R_PPC_REL24 && !exec) ? 0 : opts.m_mix[i];
+    if ( pick < weight )
+    {
+      if ( types[i] != R_PPC_NONE )
+        return types[i];
+      // R_PPC_NONE stands for the others; REL14 is last, it only goes in code
+      return others[rnd.below(exec ? 8 : 7)];
+    }
+    pick -= weight;
+  }
+  return R_PPC_ADDR32;
+}
+
+static void rel_op(be_writer &out, uint16_t offset, uint8_t type, uint8_t section, uint32_t addend)
+{
+  out.u16(offset);
+  out.u8(type);
+  out.u8(section);
+  out.u32(addend);
+}
+
+// Relocation stream against one imported module, spread over the sections
+// with file data in proportion to their size
+static uint32_t write_relocations(be_writer &out, corpus_options const &opts, corpus_random &rnd, uint32_t target_id,
+                                  uint32_t count, std::vector<corpus_section> const &sections, corpus_dol const &dol)
+{
+  uint64_t total_size = 0;
+  for ( corpus_section const &section : sections )
+    total_size += section.m_bss ? 0 : section.m_size;
+
+  uint32_t written = 0;
+  for ( size_t s = 1; s < sections.size() && total_size != 0; ++s )
+  {
+    corpus_section const &section = sections[s];
+    uint32_t quota = section.m_bss ? 0 : static_cast<uint32_t>(uint64_t(count) * section.m_size / total_size);
+    if ( quota == 0 )
+      continue;
+
+    rel_op(out, 0, R_DOLPHIN_SECTION, static_cast<uint8_t>(s), 0);
+
+    uint32_t step = std::max<uint32_t>(4, section.m_size / quota);
+    uint32_t offset = 0, previous = 0;
+    for ( uint32_t i = 0; i < quota; ++i )
+    {
+      offset += 2 + rnd.below(2 * step - 2);
+      uint8_t type = pick_type(opts, rnd, section.m_exec);
+      uint32_t alignment = type == R_PPC_ADDR16 || type == R_PPC_ADDR16_LO || type == R_PPC_ADDR16_HI || type == R_PPC_ADDR16_HA ? 2 : 4;
+      offset = (offset + alignment - 1) & ~(alignment - 1);
+      if ( offset + 4 > section.m_size )
+        break;
+
+      // Gaps wider than an entry can express are bridged with NOPs
+      uint32_t delta = offset - previous;
+      for ( ; delta > 0xFFFF; delta -= 0xFFFF )
+        rel_op(out, 0xFFFF, R_DOLPHIN_NOP, 0, 0);
+      previous = offset;
+
+      if ( type == R_DOLPHIN_NOP )
+      {
+        rel_op(out, static_cast<uint16_t>(delta), R_DOLPHIN_NOP, 0, 0);
+        continue;
+      }
+
+      uint8_t target_section;
+      uint32_t addend;
+      pick_target(rnd, target_id, sections, dol, &target_section, &addend);
+      rel_op(out, static_cast<uint16_t>(delta), type, target_section, addend);
+      ++written;
+    }
+  }
+
+  rel_op(out, 0, R_DOLPHIN_END, 0, 0);
+  return written;
+}
+
+static bool write_rel(corpus_options const &opts, corpus_random &rnd, uint32_t index, corpus_dol const &dol,
+                      std::vector<corpus_section> const &sections, uint32_t *relocations)
+{
+  uint32_t id = index + 1;
+  uint32_t version = opts.m_version != 0 ? opts.m_version : index % 3 + 1;
+  uint32_t num_sections = static_cast<uint32_t>(sections.size());
+
+  // Imported modules: other modules first, then this one, then the DOL
+  std::vector<uint32_t> imports;
+  for ( uint32_t k = 1; k < opts.m_modules && imports.size() + 1 < opts.m_imports; ++k )
+    imports.push_back((index + k) % opts.m_modules + 1);
+  std::sort(imports.begin(), imports.end());
+  imports.push_back(id);
+  if ( opts.m_imports != 0 )
+    imports.push_back(0);
+
+  be_writer out;
+  out.zeros(relhdr_view::header_size(version));
+
+  size_t section_table = out.pos();
+  out.zeros(num_sections * 8);
+
+  std::vector<uint32_t> file_offsets(num_sections, 0);
+  for ( uint32_t s = 1; s < num_sections; ++s )
+  {
+    if ( sections[s].m_bss )
+      continue;
+    out.align(REL_ALIGN);
+    file_offsets[s] = static_cast<uint32_t>(out.pos());
+    out.random(rnd, sections[s].m_size);
+  }
+
+  out.align(4);
+  size_t import_offset = out.pos();
+  out.zeros(imports.size() * 8);
+
+  size_t rel_offset = out.pos();
+  *relocations = 0;
+  for ( size_t i = 0; i < imports.size(); ++i )
+  {
+    uint32_t count = imports[i] == id ? opts.m_relocs : opts.m_import_relocs;
+    out.patch32(import_offset + i * 8, imports[i]);
+    out.patch32(import_offset + i * 8 + 4, static_cast<uint32_t>(out.pos()));
+    *relocations += write_relocations(out, opts, rnd, imports[i], count, sections, dol);
+  }
+
+  for ( uint32_t s = 0; s < num_sections; ++s )
+  {
+    out.patch32(section_table + s * 8, file_offsets[s] | (sections[s].m_exec ? SECTION_EXEC : 0));
+    out.patch32(section_table + s * 8 + 4, sections[s].m_size);
+  }
+
+  // Header
+  be_writer header;
+  header.u32(id);
+  header.u32(0);                      // prev
+  header.u32(0);                      // next
+  header.u32(num_sections);
+  header.u32(static_cast<uint32_t>(section_table));
+  header.u32(0);                      // name offset
+  header.u32(0);                      // name size
+  header.u32(version);
+  header.u32(sections.back().m_size); // bss size
+  header.u32(static_cast<uint32_t>(rel_offset));
+  header.u32(static_cast<uint32_t>(import_offset));
+  header.u32(static_cast<uint32_t>(imports.size() * 8));
+  header.u8(1);                       // prolog, epilog and unresolved live in .text
+  header.u8(1);
+  header.u8(1);
+  header.u8(0);                       // bss section, only set once linked
+  header.u32(0);
+  header.u32(4);
+  header.u32(8);
+  if ( version >= 2 )
+  {
+    header.u32(REL_ALIGN);
+    header.u32(REL_ALIGN);
+  }
+  if ( version >= 3 )
+    header.u32(static_cast<uint32_t>(rel_offset));
+
+  std::vector<uint8_t> data = out.data();
+  std::copy(header.data().begin(), header.data().end(), data.begin());
+
+  char name[32];
+  snprintf(name, sizeof(name), "mod%u.rel", id);
+  return save_file(opts, name, data);
+}
+
+//--------------------------------------------------------------------------
+static bool write_map(corpus_options const &opts, corpus_random &rnd, uint32_t index, std::vector<corpus_section> const &sections)
+{
+  uint32_t id = index + 1;
+  char path[64];
+  snprintf(path, sizeof(path), "/mod%u.map", id);
+  FILE *fp = fopen((opts.m_out + path).c_str(), "w");
+  if ( fp == nullptr )
+    return false;
+
+  fprintf(fp, "Link map of _prolog\n");
+  fprintf(fp, " 1] _prolog (func,global) found in mod%u.o \n", id);
+
+  uint64_t total_size = 0;
+  for ( corpus_section const &section : sections )
+    total_size += section.m_size;
+
+  static uint32_t const symbol_sizes[] = { 4, 8, 0x10, 0x20, 0x40, 0x80, 0x100 };
+  for ( size_t s = 1; s < sections.size(); ++s )
+  {
+    corpus_section const &section = sections[s];
+    std::string tag = section.m_name.substr(1);
+    uint32_t quota = total_size == 0 ? 0 : static_cast<uint32_t>(uint64_t(opts.m_symbols) * section.m_size / total_size);
+
+    fprintf(fp, "\n\n%s section layout\n", section.m_name.c_str());
+    fprintf(fp, "  Starting        Virtual\n");
+    fprintf(fp, "  address  Size   address\n");
+    fprintf(fp, "  -----------------------\n");
+    fprintf(fp, "  %08x %06x %08x %2u %s \tmod%u.o \n", 0u, section.m_size, 0u, 4u, section.m_name.c_str(), id);
+
+    // Read-only data uses the three column form with entries
+    bool three_columns = section.m_name == ".rodata";
+    uint32_t address = 0;
+    for ( uint32_t i = 0; i < quota; ++i )
+    {
+      uint32_t size = symbol_sizes[rnd.below(7)];
+      if ( address + size > section.m_size )
+        break;
+
+      // A few shared names produce collisions
+      char name[64];
+      if ( i % 64 == 63 )
+        snprintf(name, sizeof(name), "__sinit_%s", tag.c_str());
+      else
+        snprintf(name, sizeof(name), "mod%u_%s_%u", id, tag.c_str(), i);
+
+      if ( !three_columns )
+        fprintf(fp, "  %08x %06x %08x %2u %s \tmod%u.o \n", address, size, address, 4u, name, id);
+      else if ( i % 5 == 4 )
+        fprintf(fp, "  %08x %06x %08x %s (entry of mod%u_%s_%u) \tmod%u.o \n", address, size, address, name, id, tag.c_str(), i - 1, id);
+      else
+        fprintf(fp, "  %08x %06x %08x %s \tmod%u.o \n", address, size, address, name, id);
+      address += size;
+    }
+  }
+
+  fprintf(fp, "\n\nMemory map:\n");
+  fprintf(fp, "                   Starting Size     File\n");
+  fprintf(fp, "                   address           Offset\n");
+  uint32_t file_offset = 0x100;
+  for ( size_t s = 1; s < sections.size(); ++s )
+  {
+    fprintf(fp, "%19s %08x %08x %08x\n", sections[s].m_name.c_str(), 0u, sections[s].m_size, sections[s].m_bss ? 0u : file_offset);
+    file_offset += sections[s].m_bss ? 0 : sections[s].m_size;
+  }
+  fprintf(fp, "\n\n");
+
+  return fclose(fp) == 0;
+}
+
+//--------------------------------------------------------------------------
+static void usage()
+{
+  fprintf(stderr,
+    "usage: wii_corpus --out <dir> [options]\n"
+    "  --seed <n>            random seed (default 1)\n"
+    "  --modules <n>         REL modules to generate (default 4)\n"
+    "  --version <1|2|3>     REL version, default cycles through all three\n"
+    "  --sections <n>        sections per REL, null and .bss included (default 8, min 3)\n"
+    "  --section-size <n>    size of .text, data sections are smaller (default 0x10000)\n"
+    "  --relocs <n>          self relocations per REL (default 20000)\n"
+    "  --imports <n>         imported modules per REL, the DOL included (default 3)\n"
+    "  --import-relocs <n>   relocations per imported module (default 5000)\n"
+    "  --mix <a:l:h:r:n[:o]> weights of ADDR32, ADDR16_LO, ADDR16_HA, REL24, NOP and of the\n"
+    "                        other relocation types together (default 2:3:3:4:0:0)\n"
+    "  --symbols <n>         symbols per map (default 4000)\n"
+    "  --dol-slot-size <n>   size of every DOL text and data slot (default 0x20000)\n"
+    "  --no-maps             do not write symbol maps\n"
+    "  --compress <format>   write the DOL and RELs as yaz0 or yay0 (.szs)\n"
+    "  --disc                also pack the DOL and RELs into a disc image, game.iso\n"
+    "  --wii                 make the disc an encrypted Wii disc, game.iso and game.wbfs,\n"
+    "                        with a made up common-key.bin\n"
+    "  --arc                 pack the RELs into a U8 archive, rels.arc, instead of\n"
+    "                        writing them on their own\n");
+}
+
+static uint32_t parse_number(char const *text)
+{
+  return static_cast<uint32_t>(strtoul(text, nullptr, 0));
+}
+
+int main(int argc, char **argv)
+{
+  corpus_options opts;
+  for ( int i = 1; i < argc; ++i )
+  {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if ( arg == "--out" && has_value )
+      opts.m_out = argv[++i];
+    else if ( arg == "--seed" && has_value )
+      opts.m_seed = parse_number(argv[++i]);
+    else if ( arg == "--modules" && has_value )
+      opts.m_modules = parse_number(argv[++i]);
+    else if ( arg == "--version" && has_value )
+      opts.m_version = parse_number(argv[++i]);
+    else if ( arg == "--sections" && has_value )
+      opts.m_sections = parse_number(argv[++i]);
+    else if ( arg == "--section-size" && has_value )
+      opts.m_section_size = parse_number(argv[++i]);
+    else if ( arg == "--relocs" && has_value )
+      opts.m_relocs = parse_number(argv[++i]);
+    else if ( arg == "--imports" && has_value )
+      opts.m_imports = parse_number(argv[++i]);
+    else if ( arg == "--import-relocs" && has_value )
+      opts.m_import_relocs = parse_number(argv[++i]);
+    else if ( arg == "--symbols" && has_value )
+      opts.m_symbols = parse_number(argv[++i]);
+    else if ( arg == "--dol-slot-size" && has_value )
+      opts.m_dol_slot_size = parse_number(argv[++i]);
+    else if ( arg == "--compress" && has_value )
+    {
+      std::string format = argv[++i];
+      if ( format == "yaz0" )
+        opts.m_compress = COMPRESSION_YAZ0;
+      else if ( format == "yay0" )
+        opts.m_compress = COMPRESSION_YAY0;
+      else
+      {
+        usage();
+        return 2;
+      }
+    }
+    else if ( arg == "--disc" )
+      opts.m_disc = true;
+    else if ( arg == "--wii" )
+      opts.m_disc = opts.m_wii = true;
+    else if ( arg == "--arc" )
+      opts.m_arc = true;
+    else if ( arg == "--no-maps" )
+      opts.m_maps = false;
+    else if ( arg == "--mix" && has_value )
+    {
+      unsigned a, l, h, r, n, o = 0;
+      if ( sscanf(argv[++i], "%u:%u:%u:%u:%u:%u", &a, &l, &h, &r, &n, &o) < 5 )
+      {
+        usage();
+        return 2;
+      }
+      uint32_t mix[6] = { a, l, h, r, n, o };
+      std::copy(mix, mix + 6, opts.m_mix);
+    }
+    else
+    {
+      usage();
+      return arg == "--help" || arg == "-h" ? 0 : 2;
+    }
+  }
+
+  if ( opts.m_out.empty() || opts.m_sections < 3 || opts.m_sections > 255 || opts.m_version > 3 || opts.m_section_size < 0x40 )
+  {
+    usage();
+    return 2;
+  }
+  mkdir(opts.m_out.c_str(), 0755);
+
+  corpus_random rnd(opts.m_seed);
+  corpus_dol dol;
+  if ( !write_dol(opts, rnd, &dol) )
+  {
+    fprintf(stderr, "wii_corpus: unable to write %s/main.dol\n", opts.m_out.c_str());
+    return 1;
+  }
+
+  std::vector<corpus_section> sections = rel_sections(opts);
+  for ( uint32_t m = 0; m < opts.m_modules; ++m )
+  {
+    uint32_t relocations;
+    if ( !write_rel(opts, rnd, m, dol, sections, &relocations) || (opts.m_maps && !write_map(opts, rnd, m, sections)) )
+    {
+      fprintf(stderr, "wii_corpus: unable to write module %u to %s\n", m + 1, opts.m_out.c_str());
+      return 1;
+    }
+    printf("mod%u.rel: version %u, %u sections, %u relocations\n", m + 1,
+      opts.m_version != 0 ? opts.m_version : m % 3 + 1, static_cast<uint32_t>(sections.size()), relocations);
+  }
+
+  if ( opts.m_arc && !write_arc(opts) )
+  {
+    fprintf(stderr, "wii_corpus: unable to write the archive to %s\n", opts.m_out.c_str());
+    return 1;
+  }
+
+  if ( opts.m_disc && !write_disc(opts) )
+  {
+    fprintf(stderr, "wii_corpus: unable to write %s/game.iso\n", opts.m_out.c_str());
+    return 1;
+  }
+  return 0;
+}
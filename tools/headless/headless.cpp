@@ -0,0 +1,403 @@
+#include "headless.h"
+#include "heap_meter.h"
+#include "sdk/standin_db.hpp"
+#include "../../loader/disc_image.h"
+#include "../../loader/u8_archive.h"
+#include "../../loader/probe.h"
+#include "../../rel/rel_track.h"
+#include "../../dol/dol_track.h"
+#include "../../apploader/apploader_track.h"
+
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <memory>
+#include <strings.h>
+
+// Times a phase and records the database and I/O calls it issued
+class phase_timer
+{
+public:
+  phase_timer(load_result &result, char const *name)
+    : m_result(result), m_name(name), m_db(g_db.calls.db), m_io(g_db.calls.io),
+      m_wall(std::chrono::steady_clock::now()), m_cpu_ms(process_cpu_ms())
+  {
+    heap_begin();
+    m_allocations = heap_allocations();
+  }
+
+  ~phase_timer()
+  {
+    phase_result phase;
+    phase.m_name = m_name;
+    phase.m_depth = 0;
+    phase.m_wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_wall).count();
+    phase.m_cpu_ms = process_cpu_ms() - m_cpu_ms;
+    phase.m_db_calls = g_db.calls.db - m_db;
+    phase.m_io_calls = g_db.calls.io - m_io;
+    phase.m_peak_bytes = heap_end();
+    phase.m_allocations = heap_allocations() - m_allocations;
+    phase.m_counted = true;
+    m_result.m_phases.push_back(phase);
+  }
+
+private:
+  load_result &m_result;
+  char const *m_name;
+  uint64 m_db;
+  uint64 m_io;
+  uint64 m_allocations;
+  std::chrono::steady_clock::time_point m_wall;
+  double m_cpu_ms;
+};
+
+static std::string directory_of(std::string const &path)
+{
+  size_t slash = path.rfind('/');
+  return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+}
+
+static bool has_extension(std::string const &file, char const *ext)
+{
+  size_t length = strlen(ext);
+  return file.size() > length && strcasecmp(file.c_str() + file.size() - length, ext) == 0;
+}
+
+// Compressed inputs are named after what they contain, e.g. mod.rel.szs
+static std::string unpacked_name(std::string const &file)
+{
+  return has_extension(file, ".szs") ? file.substr(0, file.size() - 4) : file;
+}
+
+// Fresh database for every input, the dialogs are answered from the options
+static void reset_database(load_options const &opts, std::string const &file)
+{
+  g_db.reset();
+  g_db.quiet = !opts.m_verbose;
+  g_db.base_address = opts.m_base;
+  g_db.map_file = opts.m_map;
+  g_db.answer = opts.m_disc_file;
+  g_db.idb_path = directory_of(file) + "/" + qbasename(file.c_str()) + ".idb";
+  inf = idainfo();
+  load_memory_probe_instance() = heap_probe();
+
+  if ( opts.m_sibling_maps )
+  {
+    std::string name = unpacked_name(file);
+    std::string map = name.substr(0, name.rfind('.')) + ".map";
+    g_db.map_file = qfileexist(map.c_str()) ? map : opts.m_map;
+  }
+}
+
+// Append the phases a loader timed itself, nested below the current phase
+static void add_loader_phases(load_result &result, load_phases const &phases, size_t first)
+{
+  for ( size_t i = first; i < phases.phases().size(); ++i )
+  {
+    load_phase const &phase = phases.phases()[i];
+    phase_result nested = { phase.m_name, phase.m_depth + 1, phase.m_wall_ms, phase.m_cpu_ms, phase.m_db_calls, 0, phase.m_peak_bytes, phase.m_allocations, false };
+    result.m_phases.push_back(nested);
+  }
+}
+
+load_result load_dol(load_options const &opts, std::string const &file)
+{
+  load_result result = { file, "DOL", false, {} };
+  reset_database(opts, file);
+
+  linput_t *li = open_linput(file.c_str(), false);
+  if ( li == nullptr )
+    return result;
+
+  bool accepted;
+  bool from_disc;
+  {
+    phase_timer timer(result, "probe");
+    uint8_t block[PROBE_BLOCK_SIZE];
+    size_t size = probe_read(li, block);
+    uint8_t unpacked[PROBE_UNPACK_SIZE];
+    uint64_t unpacked_size;
+    size_t unpacked_count = probe_unpack(li, block, size, unpacked, &unpacked_size);
+    from_disc = probe_disc(block, size, qlsize(li));
+    if ( from_disc )
+      accepted = true;
+    else if ( unpacked_count != 0 )
+      accepted = probe_dol(unpacked, unpacked_count, unpacked_size);
+    else
+      accepted = probe_dol(block, size, qlsize(li));
+  }
+
+  disc_image disc;
+  if ( accepted && from_disc )
+  {
+    phase_timer timer(result, "disc");
+    result.m_format = "DOL disc";
+    accepted = disc.open(li);
+  }
+
+  if ( accepted )
+  {
+    std::unique_ptr<dol_track> track;
+    {
+      phase_timer timer(result, "parse");
+      track.reset(from_disc ? new dol_track(disc.input(), disc.dol().m_offset, disc.dol().m_size, !disc.encrypted()) : new dol_track(li));
+    }
+    if ( track->is_good() )
+    {
+      phase_timer timer(result, "segments");
+      inf.start_ea = inf.start_ip = track->header.entrypoint;
+      result.m_ok = track->create_segments();
+    }
+  }
+
+  close_linput(li);
+  return result;
+}
+
+load_result load_apploader(load_options const &opts, std::string const &file)
+{
+  load_result result = { file, "Apploader", false, {} };
+  reset_database(opts, file);
+
+  linput_t *li = open_linput(file.c_str(), false);
+  if ( li == nullptr )
+    return result;
+
+  bool accepted;
+  {
+    phase_timer timer(result, "probe");
+    uint8_t block[PROBE_BLOCK_SIZE];
+    size_t size = probe_read(li, block);
+    accepted = probe_apploader(block, size, qlsize(li));
+  }
+
+  if ( accepted )
+  {
+    std::unique_ptr<apploader_track> track;
+    {
+      phase_timer timer(result, "parse");
+      track.reset(new apploader_track(li));
+    }
+    if ( track->is_good() )
+    {
+      phase_timer timer(result, "segments");
+      inf.start_ea = APPLOADER_BASE;
+      result.m_ok = track->create_segments(inf.start_ea);
+    }
+  }
+
+  close_linput(li);
+  return result;
+}
+
+load_result load_rel(load_options const &opts, std::string const &file)
+{
+  load_result result = { file, "REL", false, {} };
+  reset_database(opts, file);
+  g_db.move_segm = rel_move_segm;
+
+  linput_t *li = open_linput(file.c_str(), false);
+  if ( li == nullptr )
+    return result;
+
+  bool accepted;
+  bool from_disc;
+  bool from_archive;
+  {
+    phase_timer timer(result, "probe");
+    uint8_t block[PROBE_BLOCK_SIZE];
+    size_t size = probe_read(li, block);
+    uint8_t unpacked[PROBE_UNPACK_SIZE];
+    uint64_t unpacked_size;
+    size_t unpacked_count = probe_unpack(li, block, size, unpacked, &unpacked_size);
+    from_disc = probe_disc(block, size, qlsize(li));
+    from_archive = unpacked_count != 0 ? probe_archive(unpacked, unpacked_count, unpacked_size) : probe_archive(block, size, qlsize(li));
+    if ( from_disc || from_archive )
+      accepted = true;
+    else if ( unpacked_count != 0 )
+      accepted = probe_rel(nullptr, unpacked, unpacked_count, unpacked_size);
+    else
+      accepted = probe_rel(li, block, size, qlsize(li));
+  }
+
+  // A disc image loads the module picked by the dialog, named after it
+  disc_image disc;
+  disc_file const *member = nullptr;
+  if ( accepted && from_disc )
+  {
+    phase_timer timer(result, "disc");
+    result.m_format = "REL disc";
+    if ( disc.open(li) )
+      member = ask_disc_file(disc, ".rel;.rel.szs", "REL");
+    accepted = member != nullptr;
+    if ( accepted )
+      result.m_file = file + ":" + member->m_path;
+  }
+
+  // An archive is read whole, the module is a part of it in memory
+  u8_archive archive;
+  if ( accepted && from_archive )
+  {
+    phase_timer timer(result, "archive");
+    result.m_format = "REL arc";
+    input_buffer buffer;
+    if ( buffer.read(li) && archive.open(buffer, qbasename(file.c_str())) )
+      member = ask_archive_file(archive, ".rel;.rel.szs", "REL");
+    accepted = member != nullptr;
+    if ( accepted )
+      result.m_file = file + ":" + member->m_path;
+  }
+
+  if ( accepted )
+  {
+    std::unique_ptr<rel_track> track;
+    {
+      phase_timer timer(result, "parse");
+      if ( from_archive )
+        track.reset(new rel_track(archive.contents(*member)));
+      else
+        track.reset(member != nullptr ? new rel_track(disc.input(), member->m_offset, member->m_size) : new rel_track(li));
+      if ( from_disc )
+        track->set_disc(&disc, disc.input());
+    }
+    add_loader_phases(result, track->phases(), 0);
+
+    if ( track->is_good() && opts.m_dry_run )
+    {
+      result.m_format = from_disc ? "REL disc dry" : from_archive ? "REL arc dry" : "REL dry";
+      if ( opts.m_base != BADADDR )
+        track->set_base_address(opts.m_base);
+      track->set_symbol_map(g_db.map_file);
+
+      size_t first = track->phases().phases().size();
+      {
+        phase_timer timer(result, "plan");
+        result.m_ok = track->apply_patches(true);
+      }
+      add_loader_phases(result, track->phases(), first);
+
+      if ( !opts.m_plan_dir.empty() )
+      {
+        std::string path = opts.m_plan_dir + "/" + qbasename(result.m_file.c_str()) + ".plan";
+        FILE *fp = fopenWT(path.c_str());
+        if ( fp == nullptr )
+          result.m_ok = false;
+        else
+        {
+          track->plan().write(fp);
+          qfclose(fp);
+        }
+      }
+    }
+    else if ( track->is_good() )
+    {
+      size_t first = track->phases().phases().size();
+      {
+        phase_timer timer(result, "load");
+        inf.start_ea = track->get_base_address();
+        result.m_ok = track->apply_patches();
+      }
+      add_loader_phases(result, track->phases(), first);
+
+      // Moved like IDA's rebase does, the loader patches the relocations
+      if ( result.m_ok && opts.m_rebase != BADADDR )
+      {
+        phase_timer timer(result, "rebase");
+        result.m_ok = rebase_program(static_cast<adiff_t>(opts.m_rebase - track->get_base_address()), MSF_FIXONCE) == MOVE_SEGM_OK;
+      }
+    }
+  }
+
+  close_linput(li);
+  return result;
+}
+
+bool load_any(load_options const &opts, std::string const &file, load_result *result)
+{
+  std::string name = unpacked_name(file);
+  if ( has_extension(name, ".dol") || has_extension(name, ".iso") || has_extension(name, ".gcm") || has_extension(name, ".wbfs") )
+    *result = load_dol(opts, file);
+  else if ( has_extension(name, ".img") )
+    *result = load_apploader(opts, file);
+  else if ( has_extension(name, ".rel") || has_extension(name, ".arc") )
+    *result = load_rel(opts, file);
+  else
+    return false;
+  return true;
+}
+
+bool list_files(std::string const &dir, char const *exts, std::vector<std::string> *files)
+{
+  DIR *handle = opendir(dir.c_str());
+  if ( handle == nullptr )
+    return false;
+
+  std::vector<std::string> found;
+  while ( dirent *entry = readdir(handle) )
+  {
+    std::string name = entry->d_name;
+    if ( *exts == '\0' )
+    {
+      if ( entry->d_type == DT_REG )
+        found.push_back(dir + "/" + name);
+      continue;
+    }
+    for ( char const *ext = exts; *ext != '\0'; )
+    {
+      char const *next = strchr(ext, ';');
+      std::string current = next != nullptr ? std::string(ext, next) : std::string(ext);
+      if ( has_extension(name, current.c_str()) )
+      {
+        found.push_back(dir + "/" + name);
+        break;
+      }
+      ext = next != nullptr ? next + 1 : ext + current.size();
+    }
+  }
+  closedir(handle);
+
+  std::sort(found.begin(), found.end());
+  files->insert(files->end(), found.begin(), found.end());
+  return true;
+}
+
+bool list_disc_files(std::string const &image, char const *exts, std::vector<std::string> *files)
+{
+  linput_t *li = open_linput(image.c_str(), false);
+  if ( li == nullptr )
+    return false;
+
+  bool quiet = g_db.quiet;
+  g_db.quiet = true;
+  disc_image disc;
+  bool ok = disc.open(li);
+  g_db.quiet = quiet;
+  close_linput(li);
+
+  if ( ok )
+  {
+    for ( disc_file const *file : disc.files(exts) )
+      files->push_back(file->m_path);
+  }
+  return ok;
+}
+
+bool list_archive_files(std::string const &archive, char const *exts, std::vector<std::string> *files)
+{
+  input_buffer buffer;
+  if ( !buffer.map(archive.c_str()) )
+    return false;
+
+  bool quiet = g_db.quiet;
+  g_db.quiet = true;
+  u8_archive index;
+  bool ok = index.open(buffer, qbasename(archive.c_str()));
+  g_db.quiet = quiet;
+
+  if ( ok )
+  {
+    for ( disc_file const *file : index.files(exts) )
+      files->push_back(file->m_path);
+  }
+  return ok;
+}
@@ -0,0 +1,65 @@
+// Loads inputs into the stand-in database the same way the plugins'
+// load_file does, recording the time and calls spent in every phase.
+#ifndef __HEADLESS_H__
+#define __HEADLESS_H__
+
+#include "sdk/ida_standin.hpp"
+
+#include <string>
+#include <vector>
+
+struct phase_result
+{
+  std::string m_name;
+  unsigned m_depth;     // nested phases are reported by the loader itself
+  double m_wall_ms;
+  double m_cpu_ms;      // only measured for the outer phases
+  uint64 m_db_calls;
+  uint64 m_io_calls;
+  uint64 m_peak_bytes;  // peak heap growth during the phase
+  uint64 m_allocations; // heap allocations during the phase
+  bool m_counted;       // measured by the driver; loader phases only carry their own cpu time and db calls
+};
+
+struct load_result
+{
+  std::string m_file;
+  std::string m_format;
+  bool m_ok;
+  std::vector<phase_result> m_phases;
+};
+
+struct load_options
+{
+  std::string m_map;        // symbol map answered to the REL loader
+  bool m_sibling_maps;      // use <file>.map next to each REL when it exists
+  ea_t m_base;              // REL base address, BADADDR for the default
+  bool m_dry_run;           // RELs are planned without touching the database
+  std::string m_plan_dir;   // where dry runs write <file>.plan
+  std::string m_disc_file;  // REL of a disc image or archive answered to the REL loader
+  ea_t m_rebase;            // RELs are rebased to this address after loading, BADADDR to keep them
+  bool m_verbose;
+
+  load_options() : m_sibling_maps(false), m_base(BADADDR), m_dry_run(false), m_rebase(BADADDR), m_verbose(false) {}
+};
+
+load_result load_dol(load_options const &opts, std::string const &file);
+load_result load_apploader(load_options const &opts, std::string const &file);
+load_result load_rel(load_options const &opts, std::string const &file);
+
+// Load a file with the loader matching its extension (.dol, .img, .rel), a
+// .szs after it is a compressed file of that kind. Disc images (.iso, .gcm,
+// .wbfs) load their boot DOL, U8 archives (.arc) the REL answered in opts.
+bool load_any(load_options const &opts, std::string const &file, load_result *result);
+
+// Files in dir whose extension is one of exts (".rel;.dol"), every file if
+// exts is empty, sorted
+bool list_files(std::string const &dir, char const *exts, std::vector<std::string> *files);
+
+// The same for the files of a disc image, as paths inside the image
+bool list_disc_files(std::string const &image, char const *exts, std::vector<std::string> *files);
+
+// The same for the files of a U8 archive
+bool list_archive_files(std::string const &archive, char const *exts, std::vector<std::string> *files);
+
+#endif // #ifndef __HEADLESS_H__
@@ -0,0 +1,119 @@
+#include "heap_meter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Every block carries its size in front of it; 16 bytes keeps the alignment
+// malloc guarantees
+#define HEADER_SIZE 16
+#define MAX_MARKS 64
+
+static std::atomic<uint64_t> s_live(0);
+static std::atomic<uint64_t> s_peak(0);
+static std::atomic<uint64_t> s_allocations(0);
+
+// Live size and outer peak at every open heap_begin(), only touched by the
+// thread driving the load
+struct heap_mark
+{
+  uint64_t m_live;
+  uint64_t m_peak;
+};
+static heap_mark s_marks[MAX_MARKS];
+static unsigned s_depth = 0;
+
+static void *heap_alloc(size_t size)
+{
+  void *block = malloc(size + HEADER_SIZE);
+  if ( block == nullptr )
+    return nullptr;
+  *static_cast<size_t *>(block) = size;
+  s_allocations.fetch_add(1, std::memory_order_relaxed);
+
+  uint64_t live = s_live.fetch_add(size) + size;
+  uint64_t peak = s_peak.load();
+  while ( live > peak && !s_peak.compare_exchange_weak(peak, live) )
+    ;
+  return static_cast<char *>(block) + HEADER_SIZE;
+}
+
+static void heap_free(void *ptr)
+{
+  if ( ptr == nullptr )
+    return;
+  void *block = static_cast<char *>(ptr) - HEADER_SIZE;
+  s_live.fetch_sub(*static_cast<size_t *>(block));
+  free(block);
+}
+
+uint64_t heap_live()
+{
+  return s_live.load();
+}
+
+uint64_t heap_allocations()
+{
+  return s_allocations.load();
+}
+
+void heap_begin()
+{
+  uint64_t live = s_live.load();
+  if ( s_depth < MAX_MARKS )
+    s_marks[s_depth] = heap_mark{ live, s_peak.load() };
+  ++s_depth;
+  s_peak.store(live);
+}
+
+uint64_t heap_end()
+{
+  if ( s_depth == 0 )
+    return 0;
+  --s_depth;
+  if ( s_depth >= MAX_MARKS )
+    return 0;
+
+  // The enclosing measurement keeps the higher of both peaks
+  heap_mark const &mark = s_marks[s_depth];
+  uint64_t peak = s_peak.load();
+  s_peak.store(std::max(peak, mark.m_peak));
+  return peak > mark.m_live ? peak - mark.m_live : 0;
+}
+
+load_memory_probe const * heap_probe()
+{
+  static load_memory_probe const probe = { heap_begin, heap_end, heap_allocations };
+  return &probe;
+}
+
+void *operator new(size_t size)
+{
+  void *ptr = heap_alloc(size);
+  if ( ptr == nullptr )
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void *operator new(size_t size, std::nothrow_t const &) noexcept
+{
+  return heap_alloc(size);
+}
+
+void *operator new[](size_t size, std::nothrow_t const &) noexcept
+{
+  return heap_alloc(size);
+}
+
+void operator delete(void *ptr) noexcept { heap_free(ptr); }
+void operator delete[](void *ptr) noexcept { heap_free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { heap_free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { heap_free(ptr); }
+void operator delete(void *ptr, std::nothrow_t const &) noexcept { heap_free(ptr); }
+void operator delete[](void *ptr, std::nothrow_t const &) noexcept { heap_free(ptr); }
@@ -0,0 +1,24 @@
+// Counts the heap bytes allocated through operator new, so the driver can
+// report the peak memory of every phase.
+#ifndef __HEAP_METER_H__
+#define __HEAP_METER_H__
+
+#include "../../loader/load_phases.h"
+
+#include <cstdint>
+
+// Bytes currently allocated
+uint64_t heap_live();
+
+// Number of allocations so far
+uint64_t heap_allocations();
+
+// Nested peak measurements: heap_end() returns the peak above the live size
+// at the matching heap_begin()
+void heap_begin();
+uint64_t heap_end();
+
+// Probe reporting the same for the phases the loaders time themselves
+load_memory_probe const * heap_probe();
+
+#endif // #ifndef __HEAP_METER_H__
@@ -0,0 +1,249 @@
+// Symbol map parser throughput (see wii_corpus --symbols).
+//
+//   map_bench [options] <file.map>...
+//
+// Every map is parsed with the REL loader's symbol_map and with a reference
+// parser that reads it line by line with qgetline and qsscanf, the way the
+// loader did before symbol_map. Both must find the same sections and rows;
+// the best time of each is reported with the throughput in MB/s.
+#include "sdk/standin_db.hpp"
+#include "../../rel/symbol_map.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static void usage()
+{
+  fprintf(stderr,
+    "usage: map_bench [options] <file.map>...\n"
+    "  --iterations <n>   timed parses per file and parser (default 3)\n");
+}
+
+// One symbol row, as both parsers report it
+struct map_row
+{
+  std::string m_layout;
+  uint32_t m_address;
+  uint32_t m_size;
+  uint32_t m_vaddress;
+  uint32_t m_alignment;
+  std::string m_name;
+
+  bool operator==(map_row const &other) const
+  {
+    return m_layout == other.m_layout && m_address == other.m_address && m_size == other.m_size &&
+      m_vaddress == other.m_vaddress && m_alignment == other.m_alignment && m_name == other.m_name;
+  }
+};
+
+struct map_result
+{
+  std::vector<map_section> m_sections;
+  std::vector<map_row> m_rows;
+};
+
+// Three or four columns, the name of a three column row is scoped to the
+// symbol it is an entry of
+static bool reference_row(qstring const &line, map_row *row)
+{
+  char name[512], container[512];
+  size_t entry = line.find("(entry of ");
+  if ( line.length() > 27 && line[27] != ' ' )
+  {
+    row->m_alignment = 0;
+    if ( qsscanf(line.c_str(), "%08x %06x %08x %511s", &row->m_address, &row->m_size, &row->m_vaddress, name) != 4 )
+      return false;
+    if ( entry != qstring::npos && line[entry + 10] != '.' && qsscanf(line.c_str() + entry + 10, "%511s", container) == 1 )
+    {
+      char *end = qstrchr(container, ')');
+      if ( end != nullptr )
+        *end = '\0';
+      qstrncat(container, "::", sizeof(container));
+      qstrncat(container, name, sizeof(container));
+      qstrncpy(name, container, sizeof(name));
+    }
+  }
+  else
+  {
+    int alignment;
+    if ( qsscanf(line.c_str(), "%08x %06x %08x %i %511s", &row->m_address, &row->m_size, &row->m_vaddress, &alignment, name) != 5 )
+      return false;
+    row->m_alignment = static_cast<uint32_t>(alignment);
+  }
+
+  row->m_name = name;
+  return true;
+}
+
+static bool reference_parse(char const *path, map_result *result)
+{
+  FILE *file = fopenRT(path);
+  if ( file == nullptr )
+    return false;
+
+  // The memory map is at the end, past the symbol rows
+  qfseek(file, 0, SEEK_END);
+  if ( qftell(file) < 0x800 )
+  {
+    qfclose(file);
+    return false;
+  }
+  qfseek(file, -0x800, SEEK_END);
+
+  qstring line;
+  while ( qgetline(&line, file) != -1 && line.find("Memory map:") == qstring::npos )
+    ;
+  while ( qgetline(&line, file) != -1 )
+  {
+    qstring text = line;
+    if ( line.find("Starting") != qstring::npos || line.find("address") != qstring::npos || text.trim2().empty() || line.length() < 19 )
+      continue;
+
+    map_section section;
+    if ( qsscanf(line.substr(19).c_str(), "%08x %08x %08x", &section.m_address, &section.m_size, &section.m_file_offset) != 3 )
+      continue;
+    section.m_name = line.substr(0, 19).trim2().c_str();
+    result->m_sections.push_back(section);
+  }
+
+  // Then every section layout block from the top
+  qfseek(file, 0, SEEK_SET);
+  qstring layout;
+  while ( qgetline(&line, file) != -1 )
+  {
+    if ( line.find("Memory map:") != qstring::npos )
+      break;
+
+    size_t end = line.find(" section layout");
+    if ( end != qstring::npos )
+    {
+      layout = line.substr(0, end).trim2();
+      continue;
+    }
+
+    map_row row;
+    if ( layout.empty() || line.find(layout.c_str()) != qstring::npos || line.trim2().empty() || !reference_row(line, &row) )
+      continue;
+    row.m_layout = layout.c_str();
+    result->m_rows.push_back(row);
+  }
+  qfclose(file);
+  return true;
+}
+
+static bool symbol_map_parse(char const *path, map_result *result)
+{
+  symbol_map map;
+  if ( !map.open(path) || !map.parse() )
+    return false;
+
+  result->m_sections = map.sections();
+  result->m_rows.reserve(map.symbols().size());
+  for ( map_symbol const &symbol : map.symbols() )
+  {
+    result->m_rows.push_back(map_row{ map.layouts()[symbol.m_layout].m_name, symbol.m_address, symbol.m_size,
+      symbol.m_vaddress, symbol.m_alignment, map.name(symbol) });
+  }
+  return true;
+}
+
+static bool same_sections(std::vector<map_section> const &a, std::vector<map_section> const &b)
+{
+  if ( a.size() != b.size() )
+    return false;
+  for ( size_t i = 0; i < a.size(); ++i )
+  {
+    if ( a[i].m_name != b[i].m_name || a[i].m_address != b[i].m_address || a[i].m_size != b[i].m_size ||
+         a[i].m_file_offset != b[i].m_file_offset )
+      return false;
+  }
+  return true;
+}
+
+// Best wall time in seconds of a number of parses, the last result is kept
+template <typename Parse>
+static double best_time(unsigned iterations, map_result *result, Parse parse)
+{
+  double best = 0;
+  for ( unsigned i = 0; i < iterations; ++i )
+  {
+    *result = map_result();
+    auto start = std::chrono::steady_clock::now();
+    if ( !parse(result) )
+      return -1;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if ( i == 0 || seconds < best )
+      best = seconds;
+  }
+  return best;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned iterations = 3;
+  std::vector<std::string> files;
+  for ( int i = 1; i < argc; ++i )
+  {
+    std::string arg = argv[i];
+    if ( arg == "--iterations" && i + 1 < argc )
+      iterations = std::max(1, atoi(argv[++i]));
+    else if ( arg[0] == '-' )
+    {
+      usage();
+      return arg == "--help" || arg == "-h" ? 0 : 2;
+    }
+    else
+      files.push_back(arg);
+  }
+  if ( files.empty() )
+  {
+    usage();
+    return 2;
+  }
+
+  g_db.quiet = true;
+  int status = 0;
+  printf("%-24s %10s %9s %10s %10s %10s %10s %7s\n", "file", "size", "symbols", "map ms", "ref ms", "map MB/s", "ref MB/s", "speedup");
+  for ( std::string const &path : files )
+  {
+    map_result parsed, reference;
+    double map_time = best_time(iterations, &parsed, [&](map_result *result) { return symbol_map_parse(path.c_str(), result); });
+    double reference_time = best_time(iterations, &reference, [&](map_result *result) { return reference_parse(path.c_str(), result); });
+    if ( map_time < 0 || reference_time < 0 )
+    {
+      fprintf(stderr, "map_bench: %s is not a symbol map\n", path.c_str());
+      status = 1;
+      continue;
+    }
+
+    if ( !same_sections(parsed.m_sections, reference.m_sections) || parsed.m_rows != reference.m_rows )
+    {
+      size_t row = 0;
+      while ( row < parsed.m_rows.size() && row < reference.m_rows.size() && parsed.m_rows[row] == reference.m_rows[row] )
+        ++row;
+      fprintf(stderr, "map_bench: %s parses differently (%zu and %zu sections, %zu and %zu rows, first difference at row %zu)\n",
+        path.c_str(), parsed.m_sections.size(), reference.m_sections.size(), parsed.m_rows.size(), reference.m_rows.size(), row);
+      status = 1;
+      continue;
+    }
+
+    FILE *fp = fopen(path.c_str(), "rb");
+    long size = 0;
+    if ( fp != nullptr )
+    {
+      fseek(fp, 0, SEEK_END);
+      size = ftell(fp);
+      fclose(fp);
+    }
+
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    double mb = size / (1024.0 * 1024.0);
+    printf("%-24s %10ld %9zu %10.1f %10.1f %10.1f %10.1f %6.2fx\n", name.c_str(), size, parsed.m_rows.size(),
+      map_time * 1000, reference_time * 1000, mb / map_time, mb / reference_time, reference_time / map_time);
+  }
+  return status;
+}
@@ -0,0 +1,3 @@
+// Stand-in for the IDA SDK header of the same name
+#pragma once
+#include "ida_standin.hpp"
@@ -0,0 +1,826 @@
+// In-process stand-in for the IDA kernel: an in-memory database that is
+// just complete enough to run the loaders outside of IDA.
+#include "ida_standin.hpp"
+#include "standin_db.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <map>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+
+idainfo inf;
+processor_t ph;
+standin_db g_db;
+
+//--------------------------------------------------------------------------
+size_t qstring::sprnt(const char *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  char buf[4096];
+  vsnprintf(buf, sizeof(buf), format, va);
+  va_end(va);
+  m_str = buf;
+  return m_str.size();
+}
+
+size_t qstring::cat_sprnt(const char *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  char buf[4096];
+  vsnprintf(buf, sizeof(buf), format, va);
+  va_end(va);
+  m_str += buf;
+  return m_str.size();
+}
+
+//--------------------------------------------------------------------------
+int vmsg(const char *format, va_list va)
+{
+  if ( g_db.quiet )
+    return 0;
+  return vprintf(format, va);
+}
+
+int msg(const char *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  int n = vmsg(format, va);
+  va_end(va);
+  return n;
+}
+
+void qexit(int code)
+{
+  exit(code);
+}
+
+int qsnprintf(char *buf, size_t size, const char *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  int n = vsnprintf(buf, size, format, va);
+  va_end(va);
+  return n;
+}
+
+int qvsnprintf(char *buf, size_t size, const char *format, va_list va)
+{
+  return vsnprintf(buf, size, format, va);
+}
+
+int qsscanf(const char *input, const char *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  int n = vsscanf(input, format, va);
+  va_end(va);
+  return n;
+}
+
+char *qstrncpy(char *dst, const char *src, size_t dstsize)
+{
+  if ( dstsize == 0 )
+    return dst;
+  strncpy(dst, src, dstsize - 1);
+  dst[dstsize - 1] = '\0';
+  return dst;
+}
+
+char *qstrncat(char *dst, const char *src, size_t dstsize)
+{
+  size_t len = strlen(dst);
+  if ( len < dstsize )
+    qstrncpy(dst + len, src, dstsize - len);
+  return dst;
+}
+
+const char *qbasename(const char *path)
+{
+  const char *slash = strrchr(path, '/');
+  return slash != nullptr ? slash + 1 : path;
+}
+
+char *qdirname(char *buf, size_t bufsize, const char *path)
+{
+  if ( path == nullptr )
+    return nullptr;
+  const char *slash = strrchr(path, '/');
+  std::string dir = slash != nullptr ? std::string(path, slash) : std::string(".");
+  qstrncpy(buf, dir.c_str(), bufsize);
+  return buf;
+}
+
+char *qmakepath(char *buf, size_t bufsize, const char *s1, ...)
+{
+  std::string path = s1;
+  va_list va;
+  va_start(va, s1);
+  while ( const char *s = va_arg(va, const char *) )
+  {
+    if ( !path.empty() && path.back() != '/' )
+      path += '/';
+    path += s;
+  }
+  va_end(va);
+  qstrncpy(buf, path.c_str(), bufsize);
+  return buf;
+}
+
+bool qfileexist(const char *file)
+{
+  struct stat st;
+  return stat(file, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+int get_qerrno()
+{
+  return errno;
+}
+
+bool qgetenv(const char *varname, qstring *buf)
+{
+  const char *value = getenv(varname);
+  if ( value == nullptr )
+    return false;
+  if ( buf != nullptr )
+    *buf = value;
+  return true;
+}
+
+int ask_yn(int deflt, const char *format, ...)
+{
+  ++g_db.calls.ui;
+  return g_db.map_file.empty() ? ASKBTN_NO : ASKBTN_YES;
+}
+
+bool ask_addr(ea_t *addr, const char *format, ...)
+{
+  ++g_db.calls.ui;
+  if ( g_db.base_address == BADADDR )
+    return false;
+  *addr = g_db.base_address;
+  return true;
+}
+
+char *ask_file(bool for_saving, const char *defval, const char *format, ...)
+{
+  ++g_db.calls.ui;
+  static char path[QMAXPATH];
+  if ( g_db.map_file.empty() )
+    return nullptr;
+  qstrncpy(path, g_db.map_file.c_str(), sizeof(path));
+  return path;
+}
+
+bool ask_str(qstring *str, int hist, const char *format, ...)
+{
+  ++g_db.calls.ui;
+  if ( g_db.answer.empty() )
+    return !str->empty();
+  *str = g_db.answer.c_str();
+  return true;
+}
+
+const char *get_path(path_type_t pt)
+{
+  return g_db.idb_path.c_str();
+}
+
+// The database is named after the input, <input>.idb
+ssize_t get_root_filename(char *buf, size_t bufsize)
+{
+  std::string name = qbasename(g_db.idb_path.c_str());
+  if ( name.size() > 4 && name.compare(name.size() - 4, 4, ".idb") == 0 )
+    name.resize(name.size() - 4);
+  qstrncpy(buf, name.c_str(), bufsize);
+  return static_cast<ssize_t>(name.size());
+}
+
+int enumerate_files(char *answer, size_t answer_size, const char *path, const char *fname,
+                    int (idaapi *func)(const char *file, void *ud), void *ud)
+{
+  DIR *dir = opendir(path);
+  if ( dir == nullptr )
+    return 0;
+
+  std::vector<std::string> files;
+  while ( dirent *entry = readdir(dir) )
+  {
+    if ( fnmatch(fname, entry->d_name, FNM_CASEFOLD) == 0 )
+      files.push_back(std::string(path) + "/" + entry->d_name);
+  }
+  closedir(dir);
+  std::sort(files.begin(), files.end());
+
+  for ( auto const &file : files )
+  {
+    int code = func(file.c_str(), ud);
+    if ( code != 0 )
+      return code;
+  }
+  return 0;
+}
+
+//--------------------------------------------------------------------------
+struct linput_t
+{
+  FILE *fp;
+  generic_linput_t *gl;  // instead of fp for create_generic_linput
+  qoff64_t pos;
+  char buffer[BUFSIZ];   // allocated up front so the first read does not hit malloc
+};
+
+linput_t *open_linput(const char *file, bool remote)
+{
+  FILE *fp = fopen(file, "rb");
+  if ( fp == nullptr )
+    return nullptr;
+  linput_t *li = new linput_t;
+  li->fp = fp;
+  li->gl = nullptr;
+  li->pos = 0;
+  setvbuf(fp, li->buffer, _IOFBF, sizeof(li->buffer));
+  return li;
+}
+
+linput_t *create_generic_linput(generic_linput_t *gl)
+{
+  if ( gl == nullptr )
+    return nullptr;
+  linput_t *li = new linput_t;
+  li->fp = nullptr;
+  li->gl = gl;
+  li->pos = 0;
+  return li;
+}
+
+void close_linput(linput_t *li)
+{
+  if ( li == nullptr )
+    return;
+  if ( li->gl != nullptr )
+    delete li->gl;
+  else
+    fclose(li->fp);
+  delete li;
+}
+
+int64 qlsize(linput_t *li)
+{
+  if ( li->gl != nullptr )
+    return static_cast<int64>(li->gl->filesize);
+  long pos = ftell(li->fp);
+  fseek(li->fp, 0, SEEK_END);
+  long size = ftell(li->fp);
+  fseek(li->fp, pos, SEEK_SET);
+  return size;
+}
+
+qoff64_t qlseek(linput_t *li, qoff64_t pos, int whence)
+{
+  ++g_db.calls.io;
+  if ( li->gl != nullptr )
+  {
+    qoff64_t base = whence == SEEK_CUR ? li->pos : whence == SEEK_END ? static_cast<qoff64_t>(li->gl->filesize) : 0;
+    if ( base + pos >= 0 )
+      li->pos = base + pos;
+    return li->pos;
+  }
+  fseek(li->fp, static_cast<long>(pos), whence);
+  return ftell(li->fp);
+}
+
+qoff64_t qltell(linput_t *li)
+{
+  if ( li->gl != nullptr )
+    return li->pos;
+  return ftell(li->fp);
+}
+
+ssize_t qlread(linput_t *li, void *buf, size_t size)
+{
+  ++g_db.calls.io;
+  if ( li->gl != nullptr )
+  {
+    ssize_t n = li->gl->read(li->pos, buf, size);
+    if ( n > 0 )
+      li->pos += n;
+    return n;
+  }
+  return static_cast<ssize_t>(fread(buf, 1, size, li->fp));
+}
+
+FILE *fopenRT(const char *file) { return fopen(file, "r"); }
+FILE *fopenRB(const char *file) { return fopen(file, "rb"); }
+FILE *fopenWB(const char *file) { return fopen(file, "wb"); }
+FILE *fopenWT(const char *file) { return fopen(file, "w"); }
+int qfclose(FILE *fp) { return fp != nullptr ? fclose(fp) : 0; }
+int qfseek(FILE *fp, int64 offset, int whence) { return fseek(fp, static_cast<long>(offset), whence); }
+int64 qftell(FILE *fp) { return ftell(fp); }
+ssize_t qfread(FILE *fp, void *buf, size_t n) { return static_cast<ssize_t>(fread(buf, 1, n, fp)); }
+ssize_t qfwrite(FILE *fp, const void *buf, size_t n) { return static_cast<ssize_t>(fwrite(buf, 1, n, fp)); }
+
+ssize_t qgetline(qstring *buf, FILE *fp)
+{
+  buf->clear();
+  int c;
+  ssize_t n = 0;
+  while ( (c = fgetc(fp)) != EOF )
+  {
+    ++n;
+    if ( c == '\n' )
+      break;
+    buf->append(static_cast<char>(c));
+  }
+  if ( n == 0 )
+    return -1;
+  if ( !buf->empty() && (*buf)[buf->length() - 1] == '\r' )
+    buf->resize(buf->length() - 1);
+  return static_cast<ssize_t>(buf->length());
+}
+
+int qfprintf(FILE *fp, const char *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  int n = vfprintf(fp, format, va);
+  va_end(va);
+  return n;
+}
+
+//--------------------------------------------------------------------------
+const char *processor_t::set_idp_options(const char *keyword, int value_type, const void *value)
+{
+  return nullptr;
+}
+
+bool set_processor_type(const char *procname, setproc_level_t level)
+{
+  return true;
+}
+
+bool set_compiler_id(uchar id)
+{
+  return true;
+}
+
+//--------------------------------------------------------------------------
+standin_segment *standin_db::find(ea_t ea)
+{
+  auto it = segments.upper_bound(ea);
+  if ( it == segments.begin() )
+    return nullptr;
+  --it;
+  if ( ea >= it->second.seg.end_ea )
+    return nullptr;
+  return &it->second;
+}
+
+void standin_db::reset()
+{
+  segments.clear();
+  names.clear();
+  ++names_version;
+  name_eas.clear();
+  functions.clear();
+  entries.clear();
+  comments.clear();
+  extra_cmts.clear();
+  nodes.clear();
+  blobs.clear();
+  move_segm = nullptr;
+  calls = standin_calls();
+}
+
+bool add_segm(ea_t para, ea_t start, ea_t end, const char *name, const char *sclass)
+{
+  ++g_db.calls.db;
+  if ( end < start )
+    return false;
+
+  standin_segment &seg = g_db.segments[start];
+  seg.seg.start_ea = start;
+  seg.seg.end_ea = end;
+  seg.seg.bitness = 0;
+  seg.name = name != nullptr ? name : "";
+  seg.sclass = sclass != nullptr ? sclass : "";
+  seg.bytes.assign(end - start, 0);
+  seg.original.assign(end - start, 0);
+  return true;
+}
+
+segment_t *getseg(ea_t ea)
+{
+  standin_segment *seg = g_db.find(ea);
+  return seg != nullptr ? &seg->seg : nullptr;
+}
+
+bool set_segm_addressing(segment_t *s, size_t bitness)
+{
+  ++g_db.calls.db;
+  if ( s == nullptr )
+    return false;
+  s->bitness = static_cast<uchar>(bitness);
+  return true;
+}
+
+sel_t set_selector(sel_t selector, ea_t paragraph)
+{
+  return selector;
+}
+
+// Keys of an address keyed map moved by delta, BADADDR (the file header
+// comment) stays where it is
+template <class T>
+static std::map<ea_t, T> moved_by(std::map<ea_t, T> const &from, adiff_t delta)
+{
+  std::map<ea_t, T> to;
+  for ( auto const &it : from )
+    to.emplace(it.first == BADADDR ? BADADDR : it.first + delta, it.second);
+  return to;
+}
+
+int rebase_program(adiff_t delta, int flags)
+{
+  ++g_db.calls.db;
+  std::map<ea_t, standin_segment> segments;
+  for ( auto &it : g_db.segments )
+  {
+    standin_segment &seg = segments[it.first + delta];
+    seg = std::move(it.second);
+    seg.seg.start_ea += delta;
+    seg.seg.end_ea += delta;
+  }
+  g_db.segments.swap(segments);
+
+  // Names, functions and comments move with their addresses
+  std::unordered_map<ea_t, std::string> names;
+  for ( auto const &it : g_db.names )
+    names.emplace(it.first + delta, it.second);
+  g_db.names.swap(names);
+  for ( auto &it : g_db.name_eas )
+    it.second += delta;
+  ++g_db.names_version;
+  std::map<ea_t, ea_t> functions;
+  for ( auto const &it : g_db.functions )
+    functions.emplace(it.first + delta, it.second + delta);
+  g_db.functions.swap(functions);
+  g_db.entries = moved_by(g_db.entries, delta);
+  g_db.comments = moved_by(g_db.comments, delta);
+  g_db.extra_cmts = moved_by(g_db.extra_cmts, delta);
+
+  // The bytes were moved as they were, the loader patches its relocations
+  if ( g_db.move_segm != nullptr && g_db.move_segm(BADADDR, static_cast<ea_t>(delta), 0, "") == 0 )
+    return MOVE_SEGM_LOADER;
+  return MOVE_SEGM_OK;
+}
+
+//--------------------------------------------------------------------------
+static bool write_bytes(ea_t ea, const void *buf, size_t size, bool original)
+{
+  const uchar *p = static_cast<const uchar *>(buf);
+  while ( size != 0 )
+  {
+    standin_segment *seg = g_db.find(ea);
+    if ( seg == nullptr )
+      return false;
+
+    size_t offset = ea - seg->seg.start_ea;
+    size_t count = std::min<size_t>(size, seg->bytes.size() - offset);
+    memcpy(&seg->bytes[offset], p, count);
+    if ( original )
+      memcpy(&seg->original[offset], p, count);
+    ea += static_cast<ea_t>(count);
+    p += count;
+    size -= count;
+  }
+  return true;
+}
+
+int file2base(linput_t *li, qoff64_t pos, ea_t ea1, ea_t ea2, int patchable)
+{
+  ++g_db.calls.db;
+  std::vector<uchar> buf(ea2 - ea1);
+  qlseek(li, pos, SEEK_SET);
+  if ( qlread(li, buf.data(), buf.size()) != static_cast<ssize_t>(buf.size()) )
+    return 0;
+  return write_bytes(ea1, buf.data(), buf.size(), true) ? 1 : 0;
+}
+
+int mem2base(const void *memptr, ea_t ea1, ea_t ea2, qoff64_t fpos)
+{
+  ++g_db.calls.db;
+  return write_bytes(ea1, memptr, ea2 - ea1, true) ? 1 : 0;
+}
+
+bool patch_byte(ea_t ea, uint64 x)
+{
+  ++g_db.calls.db;
+  uchar b = static_cast<uchar>(x);
+  return write_bytes(ea, &b, 1, false);
+}
+
+bool patch_word(ea_t ea, uint64 x)
+{
+  ++g_db.calls.db;
+  uchar b[2] = { uchar(x >> 8), uchar(x) };
+  return write_bytes(ea, b, 2, false);
+}
+
+bool patch_dword(ea_t ea, uint64 x)
+{
+  ++g_db.calls.db;
+  uchar b[4] = { uchar(x >> 24), uchar(x >> 16), uchar(x >> 8), uchar(x) };
+  return write_bytes(ea, b, 4, false);
+}
+
+void patch_bytes(ea_t ea, const void *buf, size_t size)
+{
+  ++g_db.calls.db;
+  write_bytes(ea, buf, size, false);
+}
+
+void put_dword(ea_t ea, uint64 x)
+{
+  ++g_db.calls.db;
+  uchar b[4] = { uchar(x >> 24), uchar(x >> 16), uchar(x >> 8), uchar(x) };
+  write_bytes(ea, b, 4, true);
+}
+
+void put_bytes(ea_t ea, const void *buf, size_t size)
+{
+  ++g_db.calls.db;
+  write_bytes(ea, buf, size, true);
+}
+
+static uint32 read_dword(ea_t ea, bool original)
+{
+  uint32 value = 0;
+  for ( int i = 0; i < 4; ++i )
+  {
+    standin_segment *seg = g_db.find(ea + i);
+    uchar b = 0;
+    if ( seg != nullptr )
+      b = original ? seg->original[ea + i - seg->seg.start_ea] : seg->bytes[ea + i - seg->seg.start_ea];
+    value = (value << 8) | b;
+  }
+  return value;
+}
+
+uint64 get_original_dword(ea_t ea)
+{
+  ++g_db.calls.db;
+  return read_dword(ea, true);
+}
+
+uint32 get_dword(ea_t ea)
+{
+  ++g_db.calls.db;
+  return read_dword(ea, false);
+}
+
+ssize_t get_bytes(void *buf, ssize_t size, ea_t ea)
+{
+  ++g_db.calls.db;
+  uchar *p = static_cast<uchar *>(buf);
+  for ( ssize_t i = 0; i < size; ++i )
+  {
+    standin_segment *seg = g_db.find(ea + static_cast<ea_t>(i));
+    p[i] = seg != nullptr ? seg->bytes[ea + i - seg->seg.start_ea] : 0;
+  }
+  return size;
+}
+
+bool set_libitem(ea_t ea)
+{
+  ++g_db.calls.db;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+netnode::netnode(const char *name, size_t namlen, bool do_create)
+  : m_index(BADNODE)
+{
+  ++g_db.calls.db;
+  std::string key = namlen != 0 ? std::string(name, namlen) : std::string(name);
+  auto it = g_db.nodes.find(key);
+  if ( it != g_db.nodes.end() )
+    m_index = it->second;
+  else if ( do_create )
+    m_index = g_db.nodes[key] = static_cast<nodeidx_t>(g_db.nodes.size());
+}
+
+size_t netnode::blobsize(nodeidx_t start, uchar tag)
+{
+  ++g_db.calls.db;
+  auto it = g_db.blobs.find(std::make_pair(m_index, tag));
+  return it != g_db.blobs.end() ? it->second.size() : 0;
+}
+
+void *netnode::getblob(void *buf, size_t *bufsize, nodeidx_t start, uchar tag)
+{
+  ++g_db.calls.db;
+  auto it = g_db.blobs.find(std::make_pair(m_index, tag));
+  if ( it == g_db.blobs.end() || buf == nullptr || *bufsize < it->second.size() )
+    return nullptr;
+  memcpy(buf, it->second.data(), it->second.size());
+  *bufsize = it->second.size();
+  return buf;
+}
+
+bool netnode::setblob(const void *buf, size_t size, nodeidx_t start, uchar tag)
+{
+  ++g_db.calls.db;
+  if ( m_index == BADNODE )
+    return false;
+  const uchar *p = static_cast<const uchar *>(buf);
+  g_db.blobs[std::make_pair(m_index, tag)].assign(p, p + size);
+  return true;
+}
+
+int netnode::delblob(nodeidx_t start, uchar tag)
+{
+  ++g_db.calls.db;
+  return static_cast<int>(g_db.blobs.erase(std::make_pair(m_index, tag)));
+}
+
+//--------------------------------------------------------------------------
+static bool name_address(ea_t ea, const char *name, int flags)
+{
+  std::string wanted = name;
+
+  auto used = g_db.name_eas.find(wanted);
+  if ( used != g_db.name_eas.end() && used->second != ea )
+  {
+    if ( (flags & SN_FORCE) == 0 )
+      return false;
+    for ( int i = 0; ; ++i )
+    {
+      std::string candidate = wanted + "_" + std::to_string(i);
+      if ( g_db.name_eas.find(candidate) == g_db.name_eas.end() )
+      {
+        wanted = candidate;
+        break;
+      }
+    }
+  }
+
+  auto old = g_db.names.find(ea);
+  if ( old != g_db.names.end() )
+    g_db.name_eas.erase(old->second);
+  g_db.names[ea] = wanted;
+  g_db.name_eas[wanted] = ea;
+  ++g_db.names_version;
+  return true;
+}
+
+bool set_name(ea_t ea, const char *name, int flags)
+{
+  ++g_db.calls.db;
+  return name_address(ea, name, flags);
+}
+
+// The name list is sorted by address; rebuilt when names change
+static std::vector<std::pair<ea_t, std::string>> const &nlist()
+{
+  static std::vector<std::pair<ea_t, std::string>> list;
+  static uint64 version = ~uint64(0);
+  if ( version != g_db.names_version )
+  {
+    list.assign(g_db.names.begin(), g_db.names.end());
+    std::sort(list.begin(), list.end());
+    version = g_db.names_version;
+  }
+  return list;
+}
+
+size_t get_nlist_size(void)
+{
+  ++g_db.calls.db;
+  return nlist().size();
+}
+
+ea_t get_nlist_ea(size_t idx)
+{
+  ++g_db.calls.db;
+  return idx < nlist().size() ? nlist()[idx].first : BADADDR;
+}
+
+const char *get_nlist_name(size_t idx)
+{
+  ++g_db.calls.db;
+  return idx < nlist().size() ? nlist()[idx].second.c_str() : nullptr;
+}
+
+ssize_t get_name(qstring *out, ea_t ea, int gtn_flags)
+{
+  ++g_db.calls.db;
+  auto it = g_db.names.find(ea);
+  if ( it == g_db.names.end() )
+  {
+    out->clear();
+    return 0;
+  }
+  *out = it->second.c_str();
+  return static_cast<ssize_t>(it->second.size());
+}
+
+ea_t get_name_ea(ea_t from, const char *name)
+{
+  ++g_db.calls.db;
+  auto it = g_db.name_eas.find(name);
+  return it != g_db.name_eas.end() ? it->second : BADADDR;
+}
+
+bool add_func(ea_t ea1, ea_t ea2)
+{
+  ++g_db.calls.db;
+  g_db.functions[ea1] = ea2;
+  return true;
+}
+
+bool add_entry(uval_t ord, ea_t ea, const char *name, bool makecode)
+{
+  ++g_db.calls.db;
+  g_db.entries[ea] = name;
+
+  // Like in IDA the entry names its address, unless the name is taken
+  name_address(ea, name, SN_NOWARN);
+  return true;
+}
+
+static bool add_comment(ea_t ea, const char *format, va_list va)
+{
+  ++g_db.calls.db;
+  char buf[1024];
+  vsnprintf(buf, sizeof(buf), format, va);
+  g_db.comments[ea] += buf;
+  g_db.extra_cmts[ea].push_back(buf);
+  return true;
+}
+
+bool add_extra_cmt(ea_t ea, bool isprev, const char *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  bool ok = add_comment(ea, format, va);
+  va_end(va);
+  return ok;
+}
+
+bool add_extra_line(ea_t ea, bool isprev, const char *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  bool ok = add_comment(ea, format, va);
+  va_end(va);
+  return ok;
+}
+
+// Previous and next lines share one list, numbered from either E_PREV or E_NEXT
+static size_t extra_cmt_index(int what)
+{
+  return static_cast<size_t>(what >= E_NEXT ? what - E_NEXT : what - E_PREV);
+}
+
+ssize_t get_extra_cmt(qstring *buf, ea_t ea, int what)
+{
+  ++g_db.calls.db;
+  auto it = g_db.extra_cmts.find(ea);
+  size_t index = extra_cmt_index(what);
+  if ( it == g_db.extra_cmts.end() || index >= it->second.size() )
+    return -1;
+  *buf = it->second[index].c_str();
+  return static_cast<ssize_t>(it->second[index].size());
+}
+
+bool update_extra_cmt(ea_t ea, int what, const char *str)
+{
+  ++g_db.calls.db;
+  std::vector<std::string> &lines = g_db.extra_cmts[ea];
+  size_t index = extra_cmt_index(what);
+  if ( index >= lines.size() )
+    lines.resize(index + 1);
+  lines[index] = str;
+
+  std::string &joined = g_db.comments[ea];
+  joined.clear();
+  for ( std::string const &line : lines )
+    joined += line;
+  return true;
+}
+
+void add_pgm_cmt(const char *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  add_comment(BADADDR, format, va);
+  va_end(va);
+}
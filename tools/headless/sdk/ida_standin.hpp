@@ -0,0 +1,262 @@
+// Minimal stand-in for the subset of the IDA SDK used by the loaders.
+#ifndef __IDA_STANDIN_HPP__
+#define __IDA_STANDIN_HPP__
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <strings.h>
+
+#define idaapi
+#define IDP_INTERFACE_VERSION 700
+
+typedef unsigned char  uchar;
+typedef unsigned short ushort;
+typedef unsigned int   uint;
+typedef uint8_t  uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef int64_t  int64;
+typedef uint32_t ea_t;
+typedef uint32_t asize_t;
+typedef uint32_t uval_t;
+typedef int32_t  sval_t;
+typedef int32_t  adiff_t;
+typedef int64_t  qoff64_t;
+typedef uint32_t sel_t;
+typedef uint32_t flags_t;
+typedef int      error_t;
+
+#define BADADDR ea_t(-1)
+#define QMAXPATH 260
+#define MAXSTR 1024
+
+// pro.h maps these to the POSIX names on Unix
+#define stricmp  strcasecmp
+#define strnicmp strncasecmp
+
+inline uint16 swap16(uint16 x) { return uint16((x >> 8) | (x << 8)); }
+inline uint32 swap32(uint32 x) { return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24); }
+
+//--------------------------------------------------------------------------
+class qstring
+{
+public:
+  static const size_t npos = size_t(-1);
+  qstring() {}
+  qstring(const char *s) : m_str(s != nullptr ? s : "") {}
+  qstring(const char *s, size_t n) : m_str(s, n) {}
+  const char *c_str() const { return m_str.c_str(); }
+  const char *begin() const { return m_str.data(); }
+  const char *end() const { return m_str.data() + m_str.size(); }
+  size_t length() const { return m_str.length(); }
+  size_t size() const { return m_str.size(); }
+  bool empty() const { return m_str.empty(); }
+  void clear() { m_str.clear(); }
+  void resize(size_t n) { m_str.resize(n); }
+  char &operator[](size_t i) { return m_str[i]; }
+  const char &operator[](size_t i) const { return m_str[i]; }
+  size_t find(const char *s, size_t pos = 0) const { return m_str.find(s, pos); }
+  size_t find(char c, size_t pos = 0) const { return m_str.find(c, pos); }
+  qstring substr(size_t pos, size_t n = npos) const { return pos >= m_str.size() ? qstring() : qstring(m_str.substr(pos, n).c_str()); }
+  qstring &trim2() { size_t b = m_str.find_first_not_of(" \t\r\n"); size_t e = m_str.find_last_not_of(" \t\r\n"); m_str = b == std::string::npos ? std::string() : m_str.substr(b, e - b + 1); return *this; }
+  qstring &append(const char *s) { m_str += s; return *this; }
+  qstring &append(const char *s, size_t n) { m_str.append(s, n); return *this; }
+  qstring &append(char c) { m_str += c; return *this; }
+  qstring &append(const qstring &s) { m_str += s.m_str; return *this; }
+  qstring &operator+=(const char *s) { return append(s); }
+  qstring &operator+=(char c) { return append(c); }
+  qstring &operator+=(const qstring &s) { return append(s); }
+  bool operator==(const qstring &o) const { return m_str == o.m_str; }
+  bool operator!=(const qstring &o) const { return m_str != o.m_str; }
+  bool operator<(const qstring &o) const { return m_str < o.m_str; }
+  bool operator==(const char *o) const { return m_str == o; }
+  bool operator!=(const char *o) const { return m_str != o; }
+  size_t sprnt(const char *format, ...);
+  size_t cat_sprnt(const char *format, ...);
+private:
+  std::string m_str;
+};
+
+//--------------------------------------------------------------------------
+// kernwin / pro
+int msg(const char *format, ...);
+int vmsg(const char *format, va_list va);
+void qexit(int code);
+int qsnprintf(char *buf, size_t size, const char *format, ...);
+int qvsnprintf(char *buf, size_t size, const char *format, va_list va);
+int qsscanf(const char *input, const char *format, ...);
+char *qstrncpy(char *dst, const char *src, size_t dstsize);
+char *qstrncat(char *dst, const char *src, size_t dstsize);
+inline char *qstrchr(char *s, char c) { return strchr(s, c); }
+inline const char *qstrchr(const char *s, char c) { return strchr(s, c); }
+const char *qbasename(const char *path);
+char *qdirname(char *buf, size_t bufsize, const char *path);
+char *qmakepath(char *buf, size_t bufsize, const char *s1, ...);
+bool qfileexist(const char *file);
+int get_qerrno();
+bool qgetenv(const char *varname, qstring *buf = nullptr);
+
+#define ASKBTN_YES     1
+#define ASKBTN_NO      0
+#define ASKBTN_CANCEL -1
+int ask_yn(int deflt, const char *format, ...);
+bool ask_addr(ea_t *addr, const char *format, ...);
+char *ask_file(bool for_saving, const char *defval, const char *format, ...);
+bool ask_str(qstring *str, int hist, const char *format, ...);
+#define HIST_FILE 3
+
+enum path_type_t { PATH_TYPE_CMD, PATH_TYPE_IDB, PATH_TYPE_ID0 };
+const char *get_path(path_type_t pt);
+ssize_t get_root_filename(char *buf, size_t bufsize);
+
+int enumerate_files(char *answer, size_t answer_size, const char *path, const char *fname,
+                    int (idaapi *func)(const char *file, void *ud), void *ud);
+
+//--------------------------------------------------------------------------
+// diskio / fpro
+struct linput_t;
+linput_t *open_linput(const char *file, bool remote);
+void close_linput(linput_t *li);
+int64 qlsize(linput_t *li);
+qoff64_t qlseek(linput_t *li, qoff64_t pos, int whence = SEEK_SET);
+qoff64_t qltell(linput_t *li);
+ssize_t qlread(linput_t *li, void *buf, size_t size);
+
+// Input backed by a reader of the caller, e.g. a decrypted disc partition.
+// close_linput deletes the reader.
+struct generic_linput_t
+{
+  uint64 filesize;
+  uint32 blocksize;
+  virtual ssize_t idaapi read(qoff64_t off, void *buffer, size_t nbytes) = 0;
+  virtual ~generic_linput_t() {}
+};
+linput_t *create_generic_linput(generic_linput_t *gl);
+
+FILE *fopenRT(const char *file);
+FILE *fopenRB(const char *file);
+FILE *fopenWB(const char *file);
+FILE *fopenWT(const char *file);
+int qfclose(FILE *fp);
+int qfseek(FILE *fp, int64 offset, int whence);
+int64 qftell(FILE *fp);
+ssize_t qfread(FILE *fp, void *buf, size_t n);
+ssize_t qfwrite(FILE *fp, const void *buf, size_t n);
+ssize_t qgetline(qstring *buf, FILE *fp);
+int qfprintf(FILE *fp, const char *format, ...);
+
+//--------------------------------------------------------------------------
+// ida / idp
+struct idainfo { ea_t start_ea = BADADDR; ea_t start_ip = BADADDR; };
+extern idainfo inf;
+
+#define IDPOPT_BIT 4
+struct processor_t
+{
+  const char *set_idp_options(const char *keyword, int value_type, const void *value);
+};
+extern processor_t ph;
+
+enum setproc_level_t { SETPROC_IDB, SETPROC_LOADER, SETPROC_LOADER_NON_FATAL, SETPROC_USER };
+bool set_processor_type(const char *procname, setproc_level_t level);
+#define COMP_GNU 0x06
+bool set_compiler_id(uchar id);
+
+//--------------------------------------------------------------------------
+// segment
+struct segment_t
+{
+  ea_t start_ea;
+  ea_t end_ea;
+  uchar bitness;
+};
+bool add_segm(ea_t para, ea_t start, ea_t end, const char *name, const char *sclass);
+segment_t *getseg(ea_t ea);
+bool set_segm_addressing(segment_t *s, size_t bitness);
+sel_t set_selector(sel_t selector, ea_t paragraph);
+
+// Moves every segment by delta, then lets the loader fix its relocations
+#define MSF_FIXONCE      0x0008
+#define MOVE_SEGM_OK      0
+#define MOVE_SEGM_LOADER -5
+int rebase_program(adiff_t delta, int flags);
+
+//--------------------------------------------------------------------------
+// bytes / loader
+#define FILEREG_PATCHABLE 1
+#define FILEREG_NOTPATCHABLE 0
+int file2base(linput_t *li, qoff64_t pos, ea_t ea1, ea_t ea2, int patchable);
+int mem2base(const void *memptr, ea_t ea1, ea_t ea2, qoff64_t fpos);
+bool patch_byte(ea_t ea, uint64 x);
+bool patch_word(ea_t ea, uint64 x);
+bool patch_dword(ea_t ea, uint64 x);
+void patch_bytes(ea_t ea, const void *buf, size_t size);
+void put_dword(ea_t ea, uint64 x);
+void put_bytes(ea_t ea, const void *buf, size_t size);
+uint64 get_original_dword(ea_t ea);
+uint32 get_dword(ea_t ea);
+ssize_t get_bytes(void *buf, ssize_t size, ea_t ea);
+bool set_libitem(ea_t ea);
+
+//--------------------------------------------------------------------------
+// name / lines / entry / funcs
+#define SN_NOWARN 0x80
+#define SN_FORCE  0x800
+bool set_name(ea_t ea, const char *name, int flags = 0);
+inline bool force_name(ea_t ea, const char *name, int flags = 0) { return set_name(ea, name, flags | SN_FORCE | SN_NOWARN); }
+ssize_t get_name(qstring *out, ea_t ea, int gtn_flags = 0);
+ea_t get_name_ea(ea_t from, const char *name);
+size_t get_nlist_size(void);
+ea_t get_nlist_ea(size_t idx);
+const char *get_nlist_name(size_t idx);
+bool add_func(ea_t ea1, ea_t ea2 = BADADDR);
+bool add_entry(uval_t ord, ea_t ea, const char *name, bool makecode);
+bool add_extra_cmt(ea_t ea, bool isprev, const char *format, ...);
+bool add_extra_line(ea_t ea, bool isprev, const char *format, ...);
+#define E_PREV 1000
+#define E_NEXT 2000
+ssize_t get_extra_cmt(qstring *buf, ea_t ea, int what);
+bool update_extra_cmt(ea_t ea, int what, const char *str);
+void add_pgm_cmt(const char *format, ...);
+
+//--------------------------------------------------------------------------
+// netnode, only named nodes and their blobs
+typedef uint32 nodeidx_t;
+#define BADNODE nodeidx_t(-1)
+class netnode
+{
+public:
+  netnode() : m_index(BADNODE) {}
+  netnode(const char *name, size_t namlen = 0, bool do_create = false);
+  operator nodeidx_t() const { return m_index; }
+
+  size_t blobsize(nodeidx_t start, uchar tag);
+  void *getblob(void *buf, size_t *bufsize, nodeidx_t start, uchar tag);
+  bool setblob(const void *buf, size_t size, nodeidx_t start, uchar tag);
+  int delblob(nodeidx_t start, uchar tag);
+
+private:
+  nodeidx_t m_index;
+};
+
+//--------------------------------------------------------------------------
+// loader
+#define ACCEPT_FIRST    0x8000
+#define ACCEPT_CONTINUE 0x4000
+struct loader_t
+{
+  uint32 version;
+  uint32 flags;
+  int (idaapi *accept_file)(qstring *fileformatname, qstring *processor, linput_t *li, const char *filename);
+  void (idaapi *load_file)(linput_t *li, ushort neflags, const char *fileformatname);
+  int (idaapi *save_file)(FILE *fp, const char *fileformatname);
+  int (idaapi *move_segm)(ea_t from, ea_t to, asize_t size, const char *fileformatname);
+  void *process_archive;
+};
+
+#endif
@@ -0,0 +1,58 @@
+// State of the stand-in database, exposed to the headless driver
+#ifndef __STANDIN_DB_HPP__
+#define __STANDIN_DB_HPP__
+
+#include "ida_standin.hpp"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct standin_segment
+{
+  segment_t seg;
+  std::string name;
+  std::string sclass;
+  std::vector<uchar> bytes;
+  std::vector<uchar> original;
+};
+
+struct standin_calls
+{
+  uint64 db = 0;   // database mutations and queries
+  uint64 io = 0;   // linput reads and seeks
+  uint64 ui = 0;   // dialogs
+};
+
+struct standin_db
+{
+  // answers for the dialogs the loaders show
+  ea_t base_address = BADADDR;
+  std::string map_file;
+  std::string answer;
+  std::string idb_path;
+  bool quiet = false;
+
+  std::map<ea_t, standin_segment> segments;
+  std::unordered_map<ea_t, std::string> names;
+  std::unordered_map<std::string, ea_t> name_eas;
+  uint64 names_version = 0;
+  std::map<ea_t, ea_t> functions;
+  std::map<ea_t, std::string> entries;
+  std::map<ea_t, std::string> comments;                 // every comment of an address, joined
+  std::map<ea_t, std::vector<std::string> > extra_cmts;  // the same by line, previous and next alike
+  std::map<std::string, nodeidx_t> nodes;
+  std::map<std::pair<nodeidx_t, uchar>, std::vector<uchar> > blobs;
+  standin_calls calls;
+
+  // move_segm of the loader that created the database, called by rebase_program
+  int (idaapi *move_segm)(ea_t from, ea_t to, asize_t size, const char *fileformatname) = nullptr;
+
+  standin_segment *find(ea_t ea);
+  void reset();
+};
+
+extern standin_db g_db;
+
+#endif
@@ -0,0 +1,337 @@
+// Phase level benchmark over a corpus directory (see tools/corpus).
+//
+//   wii_bench [options] <corpus dir>
+//
+// Every .dol, .img and .rel in the directory, compressed .szs ones included,
+// is loaded a number of times and the median and minimum wall time and the
+// peak heap growth of each phase are reported. Results can be appended to a
+// CSV history, which is also used to show the change against the previous
+// run of the same file and phase. The relocation cache is off unless asked
+// for, so every iteration resolves the relocations.
+//
+// With --probe every file in the directory, whatever its kind, goes through
+// the checks the REL, DOL and apploader loaders make in accept_file instead,
+// and the time and heap allocations per file are reported.
+#include "headless.h"
+#include "heap_meter.h"
+#include "../../loader/probe.h"
+#include "../../rel/reloc_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct phase_samples
+{
+  std::string m_key;    // file:phase/subphase
+  std::string m_file;
+  std::string m_phase;
+  std::vector<double> m_wall_ms;
+  uint64 m_peak_bytes;  // highest over the iterations
+};
+
+static void usage()
+{
+  fprintf(stderr,
+    "usage: wii_bench [options] <corpus dir>\n"
+    "  --iterations <n>   measured loads per file (default 5)\n"
+    "  --warmup <n>       unmeasured loads per file first (default 1)\n"
+    "  --base <hex>       base address answered to the REL loader\n"
+    "  --history <file>   CSV file to compare with and append the results to\n"
+    "  --label <name>     label of this run in the history (default: run)\n"
+    "  --fail-over <pct>  exit with 3 when a phase median regressed by more than pct\n"
+    "  --cache            replay the REL relocations from the relocation cache\n"
+    "  --probe            time the accept_file checks of every loader on every file\n"
+    "                     instead, each iteration probes every file PROBE_ROUNDS times\n"
+    "  --verbose          show the loader output\n");
+}
+
+// Phase names qualified by the phases they are nested in
+static std::vector<std::string> phase_paths(load_result const &result)
+{
+  std::vector<std::string> paths, stack;
+  for ( phase_result const &phase : result.m_phases )
+  {
+    stack.resize(phase.m_depth);
+    stack.push_back(phase.m_name);
+
+    std::string path;
+    for ( std::string const &name : stack )
+      path += (path.empty() ? "" : "/") + name;
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+static double median(std::vector<double> values)
+{
+  std::sort(values.begin(), values.end());
+  size_t mid = values.size() / 2;
+  return values.size() % 2 != 0 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+// Probes per file and iteration in --probe mode, enough to time them in ns
+#define PROBE_ROUNDS 1000
+
+// The checks of accept_file of each loader, see rel.cpp, dol.cpp and
+// apploader.cpp. IDA asks every loader in turn, each reads the header again.
+static bool accept_rel(linput_t *li)
+{
+  uint8_t block[PROBE_BLOCK_SIZE];
+  size_t size = probe_read(li, block);
+  if ( probe_disc(block, size, qlsize(li)) )
+    return true;
+
+  uint8_t unpacked[PROBE_UNPACK_SIZE];
+  uint64_t unpacked_size;
+  size_t unpacked_count = probe_unpack(li, block, size, unpacked, &unpacked_size);
+  if ( unpacked_count != 0 ? probe_archive(unpacked, unpacked_count, unpacked_size) : probe_archive(block, size, qlsize(li)) )
+    return true;
+  if ( unpacked_count != 0 )
+    return probe_rel(nullptr, unpacked, unpacked_count, unpacked_size);
+  return probe_rel(li, block, size, qlsize(li));
+}
+
+static bool accept_dol(linput_t *li)
+{
+  uint8_t block[PROBE_BLOCK_SIZE];
+  size_t size = probe_read(li, block);
+  if ( probe_disc(block, size, qlsize(li)) )
+    return true;
+
+  uint8_t unpacked[PROBE_UNPACK_SIZE];
+  uint64_t unpacked_size;
+  size_t unpacked_count = probe_unpack(li, block, size, unpacked, &unpacked_size);
+  if ( unpacked_count != 0 )
+    return probe_dol(unpacked, unpacked_count, unpacked_size);
+  return probe_dol(block, size, qlsize(li));
+}
+
+static bool accept_apploader(linput_t *li)
+{
+  uint8_t block[PROBE_BLOCK_SIZE];
+  size_t size = probe_read(li, block);
+  return probe_apploader(block, size, qlsize(li));
+}
+
+// Median ns per file of each loader's checks and of all three, over the
+// iterations. Returns false if a file could not be opened.
+static bool bench_probes(std::vector<std::string> const &files, unsigned iterations, unsigned warmup)
+{
+  typedef bool (*accept_fn)(linput_t *li);
+  static accept_fn const accepts[] = { accept_rel, accept_dol, accept_apploader };
+  static char const * const names[] = { "REL", "DOL", "apploader" };
+
+  bool ok = true;
+  double total_ns = 0;
+  printf("%-32s %10s %10s %10s %10s %8s  %s\n", "file", "REL ns", "DOL ns", "app ns", "total ns", "allocs", "accepted by");
+  for ( std::string const &file : files )
+  {
+    linput_t *li = open_linput(file.c_str(), false);
+    if ( li == nullptr )
+    {
+      fprintf(stderr, "wii_bench: unable to open %s\n", file.c_str());
+      ok = false;
+      continue;
+    }
+
+    std::vector<double> samples[3];
+    bool accepted[3] = {};
+    uint64_t allocations = 0;
+    for ( unsigned i = 0; i < warmup + iterations; ++i )
+    {
+      for ( int p = 0; p < 3; ++p )
+      {
+        uint64_t first_allocation = heap_allocations();
+        auto start = std::chrono::steady_clock::now();
+        for ( unsigned round = 0; round < PROBE_ROUNDS; ++round )
+          accepted[p] = accepts[p](li);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        allocations += heap_allocations() - first_allocation;
+        if ( i >= warmup )
+          samples[p].push_back(ns / PROBE_ROUNDS);
+      }
+    }
+    close_linput(li);
+
+    std::string accepted_by;
+    for ( int p = 0; p < 3; ++p )
+    {
+      if ( accepted[p] )
+        accepted_by += (accepted_by.empty() ? "" : ", ") + std::string(names[p]);
+    }
+    double ns[3] = { median(samples[0]), median(samples[1]), median(samples[2]) };
+    double file_ns = ns[0] + ns[1] + ns[2];
+    total_ns += file_ns;
+    printf("%-32s %10.1f %10.1f %10.1f %10.1f %8llu  %s\n", qbasename(file.c_str()), ns[0], ns[1], ns[2], file_ns,
+      static_cast<unsigned long long>(allocations), accepted_by.empty() ? "-" : accepted_by.c_str());
+  }
+  if ( !files.empty() )
+    printf("%u files, %.1f ns per file\n", static_cast<uint32_t>(files.size()), total_ns / files.size());
+  return ok;
+}
+
+// Latest median per file:phase in the history
+static std::map<std::string, double> read_history(std::string const &path)
+{
+  std::map<std::string, double> previous;
+  std::ifstream in(path);
+  std::string line;
+  while ( std::getline(in, line) )
+  {
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while ( std::getline(ss, field, ',') )
+      fields.push_back(field);
+
+    // label,time,file,phase,median_ms,min_ms[,peak_kb]
+    if ( (fields.size() != 6 && fields.size() != 7) || fields[0] == "label" )
+      continue;
+    previous[fields[2] + ":" + fields[3]] = atof(fields[4].c_str());
+  }
+  return previous;
+}
+
+int main(int argc, char **argv)
+{
+  load_options opts;
+  opts.m_sibling_maps = true;
+  unsigned iterations = 5, warmup = 1;
+  std::string history, label = "run", dir;
+  double fail_over = -1;
+  bool cache = false;
+  bool probe = false;
+
+  for ( int i = 1; i < argc; ++i )
+  {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if ( arg == "--iterations" && has_value )
+      iterations = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+    else if ( arg == "--warmup" && has_value )
+      warmup = static_cast<unsigned>(std::max(0, atoi(argv[++i])));
+    else if ( arg == "--base" && has_value )
+      opts.m_base = static_cast<ea_t>(strtoul(argv[++i], nullptr, 16));
+    else if ( arg == "--history" && has_value )
+      history = argv[++i];
+    else if ( arg == "--label" && has_value )
+      label = argv[++i];
+    else if ( arg == "--fail-over" && has_value )
+      fail_over = atof(argv[++i]);
+    else if ( arg == "--cache" )
+      cache = true;
+    else if ( arg == "--probe" )
+      probe = true;
+    else if ( arg == "--verbose" )
+      opts.m_verbose = true;
+    else if ( arg == "--help" || arg == "-h" )
+    {
+      usage();
+      return 0;
+    }
+    else if ( arg[0] == '-' || !dir.empty() )
+    {
+      usage();
+      return 2;
+    }
+    else
+      dir = arg;
+  }
+
+  if ( !cache )
+    setenv(RELOC_CACHE_ENV, "1", 1);
+
+  std::vector<std::string> files;
+  if ( dir.empty() || !list_files(dir, probe ? "" : ".dol;.img;.rel;.szs", &files) || files.empty() )
+  {
+    usage();
+    return 2;
+  }
+  if ( probe )
+    return bench_probes(files, iterations, warmup) ? 0 : 1;
+
+  bool ok = true;
+  std::vector<phase_samples> samples;
+  std::map<std::string, size_t> sample_index;
+  for ( std::string const &file : files )
+  {
+    for ( unsigned i = 0; i < warmup + iterations; ++i )
+    {
+      load_result result;
+      load_any(opts, file, &result);
+      ok = ok && result.m_ok;
+      if ( i < warmup )
+        continue;
+
+      std::vector<std::string> paths = phase_paths(result);
+      for ( size_t p = 0; p < paths.size(); ++p )
+      {
+        std::string file_name = qbasename(file.c_str());
+        std::string key = file_name + ":" + paths[p];
+        auto it = sample_index.find(key);
+        if ( it == sample_index.end() )
+        {
+          it = sample_index.insert(std::make_pair(key, samples.size())).first;
+          samples.push_back(phase_samples{ key, file_name, paths[p], {}, 0 });
+        }
+        phase_samples &sample = samples[it->second];
+        sample.m_wall_ms.push_back(result.m_phases[p].m_wall_ms);
+        sample.m_peak_bytes = std::max(sample.m_peak_bytes, result.m_phases[p].m_peak_bytes);
+      }
+    }
+  }
+
+  std::map<std::string, double> previous;
+  if ( !history.empty() )
+    previous = read_history(history);
+
+  bool regressed = false;
+  printf("%-32s %-28s %10s %10s %10s %8s %10s\n", "file", "phase", "median ms", "min ms", "prev ms", "change", "peak KB");
+  for ( phase_samples const &sample : samples )
+  {
+    double mid = median(sample.m_wall_ms);
+    double low = *std::min_element(sample.m_wall_ms.begin(), sample.m_wall_ms.end());
+
+    auto it = previous.find(sample.m_key);
+    if ( it != previous.end() && it->second > 0 )
+    {
+      double change = 100.0 * (mid - it->second) / it->second;
+      printf("%-32s %-28s %10.3f %10.3f %10.3f %+7.1f%% %10.1f\n", sample.m_file.c_str(), sample.m_phase.c_str(), mid, low, it->second, change,
+        sample.m_peak_bytes / 1024.0);
+      regressed = regressed || (fail_over >= 0 && change > fail_over);
+    }
+    else
+    {
+      printf("%-32s %-28s %10.3f %10.3f %10s %8s %10.1f\n", sample.m_file.c_str(), sample.m_phase.c_str(), mid, low, "-", "-",
+        sample.m_peak_bytes / 1024.0);
+    }
+  }
+
+  if ( !history.empty() )
+  {
+    bool exists = qfileexist(history.c_str());
+    std::ofstream out(history, std::ios::app);
+    if ( !exists )
+      out << "label,time,file,phase,median_ms,min_ms,peak_kb\n";
+
+    long long now = static_cast<long long>(time(nullptr));
+    for ( phase_samples const &sample : samples )
+    {
+      double low = *std::min_element(sample.m_wall_ms.begin(), sample.m_wall_ms.end());
+      out << label << ',' << now << ',' << sample.m_file << ',' << sample.m_phase << ','
+          << median(sample.m_wall_ms) << ',' << low << ',' << sample.m_peak_bytes / 1024.0 << '\n';
+    }
+  }
+
+  if ( !ok )
+    fprintf(stderr, "wii_bench: some files failed to load\n");
+  return !ok ? 1 : regressed ? 3 : 0;
+}
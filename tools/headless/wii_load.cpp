@@ -0,0 +1,200 @@
+// Headless driver for the loaders: runs the same steps as load_file against
+// the in-process database stand-in and reports how long each phase took.
+//
+//   wii_load [options] [--dol <file>] [--apploader <file>] [--rel-dir <dir>] [--disc <image>] [--arc <archive>] [<file.rel>...]
+//
+// Every input is loaded into a fresh database. RELs use the directory they
+// are in for the sibling module index, like they would next to an IDB, the
+// RELs of a disc image use the other modules on the disc, and the RELs of
+// an archive the directory the archive is in.
+#include "headless.h"
+#include "../../loader/wii_disc.h"
+#include "../../rel/reloc_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+static void usage()
+{
+  fprintf(stderr,
+    "usage: wii_load [options] [--dol <file>] [--apploader <file>] [--rel-dir <dir>] [--disc <image>] [--arc <archive>] [<file.rel>...]\n"
+    "  --disc <image>   load the boot DOL and the RELs of a GameCube or Wii disc image\n"
+    "  --disc-rel <f>   only load this REL of the disc (repeatable)\n"
+    "  --key <file>     Wii common key file (default: common-key.bin next to the image)\n"
+    "  --arc <archive>  load every REL of a U8 archive (.arc, .szs), repeatable\n"
+    "  --base <hex>     base address answered to the REL loader (default: loader default)\n"
+    "  --rebase <hex>   rebase every REL to this address after loading it\n"
+    "  --map <file>     symbol map answered to the REL loader\n"
+    "  --sibling-maps   use <name>.map next to each REL when it exists\n"
+    "  --dry-run        plan the REL loads without touching the database\n"
+    "  --plan <dir>     dry run that writes every plan to <dir>/<file>.plan\n"
+    "  --repeat <n>     load every input n times\n"
+    "  --no-cache       resolve the REL relocations without the relocation cache\n"
+    "  --verbose        show the loader output\n");
+}
+
+static void print_results(std::vector<load_result> const &results)
+{
+  printf("%-40s %-10s %-16s %10s %10s %10s %8s %10s %8s\n", "file", "format", "phase", "wall ms", "cpu ms", "db calls", "io calls", "peak KB", "allocs");
+
+  double total_wall = 0, total_cpu = 0;
+  for ( load_result const &result : results )
+  {
+    std::string file = qbasename(result.m_file.c_str());
+    for ( phase_result const &phase : result.m_phases )
+    {
+      std::string name = std::string(phase.m_depth * 2, ' ') + phase.m_name;
+      if ( phase.m_counted )
+      {
+        printf("%-40s %-10s %-16s %10.3f %10.3f %10llu %8llu %10.1f %8llu\n", file.c_str(), result.m_format.c_str(), name.c_str(),
+          phase.m_wall_ms, phase.m_cpu_ms, static_cast<unsigned long long>(phase.m_db_calls), static_cast<unsigned long long>(phase.m_io_calls),
+          phase.m_peak_bytes / 1024.0, static_cast<unsigned long long>(phase.m_allocations));
+        total_wall += phase.m_wall_ms;
+        total_cpu += phase.m_cpu_ms;
+      }
+      else
+      {
+        printf("%-40s %-10s %-16s %10.3f %10.3f %10llu %8s %10.1f %8llu\n", file.c_str(), result.m_format.c_str(), name.c_str(),
+          phase.m_wall_ms, phase.m_cpu_ms, static_cast<unsigned long long>(phase.m_db_calls), "-", phase.m_peak_bytes / 1024.0,
+          static_cast<unsigned long long>(phase.m_allocations));
+      }
+    }
+    if ( !result.m_ok )
+      printf("%-40s %-10s %-16s\n", file.c_str(), result.m_format.c_str(), "FAILED");
+  }
+  printf("%-40s %-10s %-16s %10.3f %10.3f\n", "total", "", "", total_wall, total_cpu);
+}
+
+int main(int argc, char **argv)
+{
+  load_options opts;
+  std::string dol, apploader;
+  std::vector<std::string> rels, rel_dirs;
+  std::string disc;
+  std::vector<std::string> disc_rels;
+  std::vector<std::string> archives;
+  unsigned repeat = 1;
+
+  for ( int i = 1; i < argc; ++i )
+  {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if ( arg == "--dol" && has_value )
+      dol = argv[++i];
+    else if ( arg == "--apploader" && has_value )
+      apploader = argv[++i];
+    else if ( arg == "--rel-dir" && has_value )
+      rel_dirs.push_back(argv[++i]);
+    else if ( arg == "--disc" && has_value )
+      disc = argv[++i];
+    else if ( arg == "--disc-rel" && has_value )
+      disc_rels.push_back(argv[++i]);
+    else if ( arg == "--arc" && has_value )
+      archives.push_back(argv[++i]);
+    else if ( arg == "--key" && has_value )
+      setenv(WII_KEY_ENV, argv[++i], 1);
+    else if ( arg == "--no-cache" )
+      setenv(RELOC_CACHE_ENV, "1", 1);
+    else if ( arg == "--rebase" && has_value )
+      opts.m_rebase = static_cast<ea_t>(strtoul(argv[++i], nullptr, 16));
+    else if ( arg == "--map" && has_value )
+      opts.m_map = argv[++i];
+    else if ( arg == "--base" && has_value )
+      opts.m_base = static_cast<ea_t>(strtoul(argv[++i], nullptr, 16));
+    else if ( arg == "--sibling-maps" )
+      opts.m_sibling_maps = true;
+    else if ( arg == "--dry-run" )
+      opts.m_dry_run = true;
+    else if ( arg == "--plan" && has_value )
+    {
+      opts.m_dry_run = true;
+      opts.m_plan_dir = argv[++i];
+    }
+    else if ( arg == "--repeat" && has_value )
+      repeat = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+    else if ( arg == "--verbose" )
+      opts.m_verbose = true;
+    else if ( arg == "--help" || arg == "-h" )
+    {
+      usage();
+      return 0;
+    }
+    else if ( arg[0] == '-' )
+    {
+      usage();
+      return 2;
+    }
+    else
+      rels.push_back(arg);
+  }
+
+  for ( std::string const &dir : rel_dirs )
+  {
+    if ( !list_files(dir, ".rel;.rel.szs", &rels) )
+    {
+      fprintf(stderr, "wii_load: unable to read directory %s\n", dir.c_str());
+      return 1;
+    }
+  }
+
+  if ( !disc.empty() && disc_rels.empty() && !list_disc_files(disc, ".rel;.rel.szs", &disc_rels) )
+  {
+    fprintf(stderr, "wii_load: %s is not a readable disc image\n", disc.c_str());
+    return 1;
+  }
+
+  std::vector<std::pair<std::string, std::string> > archive_rels;
+  for ( std::string const &archive : archives )
+  {
+    std::vector<std::string> members;
+    if ( !list_archive_files(archive, ".rel;.rel.szs", &members) )
+    {
+      fprintf(stderr, "wii_load: %s is not a readable U8 archive\n", archive.c_str());
+      return 1;
+    }
+    for ( std::string const &member : members )
+      archive_rels.push_back(std::make_pair(archive, member));
+  }
+
+  if ( dol.empty() && apploader.empty() && rels.empty() && disc.empty() && archives.empty() )
+  {
+    usage();
+    return 2;
+  }
+
+  std::vector<load_result> results;
+  for ( unsigned pass = 0; pass < repeat; ++pass )
+  {
+    if ( !dol.empty() )
+      results.push_back(load_dol(opts, dol));
+    if ( !apploader.empty() )
+      results.push_back(load_apploader(opts, apploader));
+    for ( std::string const &rel : rels )
+      results.push_back(load_rel(opts, rel));
+    if ( !disc.empty() )
+    {
+      results.push_back(load_dol(opts, disc));
+      for ( std::string const &rel : disc_rels )
+      {
+        load_options disc_opts = opts;
+        disc_opts.m_disc_file = rel;
+        results.push_back(load_rel(disc_opts, disc));
+      }
+    }
+    for ( auto const &member : archive_rels )
+    {
+      load_options archive_opts = opts;
+      archive_opts.m_disc_file = member.second;
+      results.push_back(load_rel(archive_opts, member.first));
+    }
+  }
+
+  print_results(results);
+
+  bool ok = std::all_of(results.begin(), results.end(), [](load_result const &result) { return result.m_ok; });
+  return ok ? 0 : 1;
+}
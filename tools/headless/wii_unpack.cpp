@@ -0,0 +1,223 @@
+// Decoder throughput for Yaz0 and Yay0 files (see wii_corpus --compress).
+//
+//   wii_unpack [options] <file.szs>...
+//
+// Every file is decoded with the loaders' decoder and with a bit by bit
+// reference decoder written straight from the format description. The
+// outputs must be identical; the best time of each is reported in MB/s of
+// decompressed data.
+#include "../../loader/compression.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void usage()
+{
+  fprintf(stderr,
+    "usage: wii_unpack [options] <file.szs>...\n"
+    "  --iterations <n>   timed decodes per file and decoder (default 10)\n");
+}
+
+static uint32_t read_be32(uint8_t const *p)
+{
+  return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// One operation per flag bit, one byte per copy step
+static size_t reference_yaz0(uint8_t const *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+  size_t in = 0, out = 0;
+  uint32_t flags = 0, bits = 0;
+  while ( out < dst_size )
+  {
+    if ( bits == 0 )
+    {
+      if ( in >= src_size )
+        break;
+      flags = src[in++];
+      bits = 8;
+    }
+    --bits;
+    if ( (flags >> bits) & 1 )
+    {
+      if ( in >= src_size )
+        break;
+      dst[out++] = src[in++];
+      continue;
+    }
+    if ( in + 2 > src_size )
+      break;
+    size_t distance = (((src[in] & 0x0F) << 8) | src[in + 1]) + 1;
+    size_t length = src[in] >> 4;
+    in += 2;
+    if ( length == 0 )
+    {
+      if ( in >= src_size )
+        break;
+      length = src[in++] + 0x12;
+    }
+    else
+      length += 2;
+    if ( distance > out )
+      break;
+    for ( ; length != 0 && out < dst_size; --length, ++out )
+      dst[out] = dst[out - distance];
+  }
+  return out;
+}
+
+static size_t reference_yay0(uint8_t const *data, size_t size, uint8_t *dst, size_t dst_size)
+{
+  size_t flag = COMPRESSION_HEADER_SIZE;
+  size_t link = read_be32(data + 8);
+  size_t chunk = read_be32(data + 12);
+  if ( link > size || chunk > size )
+    return 0;
+  size_t out = 0;
+  uint32_t flags = 0, bits = 0;
+  while ( out < dst_size )
+  {
+    if ( bits == 0 )
+    {
+      if ( flag + 4 > size )
+        break;
+      flags = read_be32(data + flag);
+      flag += 4;
+      bits = 32;
+    }
+    --bits;
+    if ( (flags >> bits) & 1 )
+    {
+      if ( chunk >= size )
+        break;
+      dst[out++] = data[chunk++];
+      continue;
+    }
+    if ( link + 2 > size )
+      break;
+    size_t distance = (((data[link] & 0x0F) << 8) | data[link + 1]) + 1;
+    size_t length = data[link] >> 4;
+    link += 2;
+    if ( length == 0 )
+    {
+      if ( chunk >= size )
+        break;
+      length = data[chunk++] + 0x12;
+    }
+    else
+      length += 2;
+    if ( distance > out )
+      break;
+    for ( ; length != 0 && out < dst_size; --length, ++out )
+      dst[out] = dst[out - distance];
+  }
+  return out;
+}
+
+static size_t reference_decode(std::vector<uint8_t> const &file, uint8_t *dst, size_t dst_size)
+{
+  if ( compression_detect(file.data(), file.size()) == COMPRESSION_YAZ0 )
+    return reference_yaz0(file.data() + COMPRESSION_HEADER_SIZE, file.size() - COMPRESSION_HEADER_SIZE, dst, dst_size);
+  return reference_yay0(file.data(), file.size(), dst, dst_size);
+}
+
+static bool read_file(std::string const &path, std::vector<uint8_t> *data)
+{
+  FILE *fp = fopen(path.c_str(), "rb");
+  if ( fp == nullptr )
+    return false;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  data->resize(size > 0 ? static_cast<size_t>(size) : 0);
+  bool ok = size > 0 && fread(data->data(), 1, data->size(), fp) == data->size();
+  fclose(fp);
+  return ok;
+}
+
+// Best wall time in seconds of a number of decodes
+template <typename Decode>
+static double best_time(unsigned iterations, Decode decode)
+{
+  double best = 0;
+  for ( unsigned i = 0; i < iterations; ++i )
+  {
+    auto start = std::chrono::steady_clock::now();
+    decode();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if ( i == 0 || seconds < best )
+      best = seconds;
+  }
+  return best;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned iterations = 10;
+  std::vector<std::string> files;
+  for ( int i = 1; i < argc; ++i )
+  {
+    std::string arg = argv[i];
+    if ( arg == "--iterations" && i + 1 < argc )
+      iterations = std::max(1, atoi(argv[++i]));
+    else if ( arg[0] == '-' )
+    {
+      usage();
+      return arg == "--help" || arg == "-h" ? 0 : 2;
+    }
+    else
+      files.push_back(arg);
+  }
+  if ( files.empty() )
+  {
+    usage();
+    return 2;
+  }
+
+  int status = 0;
+  printf("%-24s %-5s %10s %10s %10s %10s %7s\n", "file", "fmt", "packed", "unpacked", "table MB/s", "ref MB/s", "speedup");
+  for ( std::string const &path : files )
+  {
+    std::vector<uint8_t> file;
+    uint32_t unpacked_size = 0;
+    compression_format format = COMPRESSION_NONE;
+    if ( read_file(path, &file) )
+      format = compression_detect(file.data(), file.size(), &unpacked_size);
+    if ( format == COMPRESSION_NONE )
+    {
+      fprintf(stderr, "wii_unpack: %s is not a Yaz0 or Yay0 file\n", path.c_str());
+      status = 1;
+      continue;
+    }
+
+    std::vector<uint8_t> table(unpacked_size), reference(unpacked_size);
+    size_t table_size = 0, reference_size = 0;
+    double table_time = best_time(iterations, [&]()
+    {
+      table_size = decompress(file.data(), file.size(), table.data(), table.size());
+    });
+    double reference_time = best_time(iterations, [&]()
+    {
+      reference_size = reference_decode(file, reference.data(), reference.size());
+    });
+
+    if ( table_size != unpacked_size || reference_size != unpacked_size || table != reference )
+    {
+      fprintf(stderr, "wii_unpack: %s decodes differently (%zu and %zu of %u bytes)\n",
+        path.c_str(), table_size, reference_size, unpacked_size);
+      status = 1;
+      continue;
+    }
+
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    double mb = unpacked_size / (1024.0 * 1024.0);
+    printf("%-24s %-5s %10zu %10u %10.1f %10.1f %6.2fx\n", name.c_str(), compression_name(format), file.size(),
+      unpacked_size, mb / table_time, mb / reference_time, reference_time / table_time);
+  }
+  return status;
+}